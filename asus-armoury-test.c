@@ -0,0 +1,1439 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * KUnit tests for the Universal Armoury driver
+ *
+ * Included at the end of asus-armoury.c when CONFIG_UNIVERSAL_ARMOURY_KUNIT_TEST
+ * is set, so the static functions are in reach. Devices are assembled
+ * directly instead of being bound through ACPI, and every firmware call is
+ * redirected to a fake that answers the methods of a vendor descriptor from
+ * a small register file. No hardware or ACPI tables are needed.
+ *
+ * Copyright (C) 2025
+ */
+
+#include <kunit/test.h>
+#include <kunit/static_stub.h>
+#include <linux/completion.h>
+#include <linux/delay.h>
+#include <linux/kthread.h>
+#include <linux/sort.h>
+#include <linux/spinlock.h>
+
+/* Firmware behind the fake methods, one per test in test->priv */
+struct armoury_fake_fw {
+    const struct armoury_vendor_desc *desc;
+    spinlock_t lock;
+    int regs[ARMOURY_STATE_COUNT];
+    u32 thermal_policy;
+    struct armoury_fan_curve fans[ARMOURY_FAN_COUNT];
+    u32 power[ARMOURY_POWER_COUNT];
+    unsigned long absent;       /* BIT(id): the state's methods are not in the namespace */
+    unsigned long pairs;        /* BIT(i): universal_armoury_cap_pairs[i] is in the namespace */
+    const char *fail_method;    /* method failing with fail_err, NULL for none */
+    int fail_err;
+    bool bulk;                  /* the vendor offers armoury_fake_ops */
+    bool no_bulk;               /* its bulk read reports missing support */
+    bool no_fan_curves;         /* GBMD lacks the fan curve selectors */
+    unsigned long no_power;     /* BIT(id): GBMD lacks that power limit */
+    u32 last_set;               /* selector of the last SBMD call */
+    unsigned int delay_us;      /* time spent in AML per call */
+    atomic_t calls;
+
+    /* Module parameters, restored after each test */
+    unsigned int saved_cache_ttl_ms;
+    unsigned int saved_coalesce_ms;
+    bool saved_async_writes;
+    char *saved_capcache;
+};
+
+/* The state a method reads or writes, from the vendor or the known pairs */
+static int armoury_fake_state(const struct armoury_fake_fw *fw, const char *name,
+                              bool *set)
+{
+    const struct armoury_cap_pair *pair;
+    int i;
+
+    for (i = 0; i < ARMOURY_STATE_COUNT; i++) {
+        *set = fw->desc->set_methods[i] && !strcmp(fw->desc->set_methods[i], name);
+        if (*set || (fw->desc->get_methods[i] && !strcmp(fw->desc->get_methods[i], name)))
+            return i;
+    }
+
+    for (i = 0; i < ARMOURY_NR_CAP_PAIRS; i++) {
+        pair = &universal_armoury_cap_pairs[i];
+        if (pair->id < 0)
+            continue;
+        *set = !strcmp(pair->set, name);
+        if (*set || !strcmp(pair->get, name))
+            return pair->id;
+    }
+
+    return -ENOENT;
+}
+
+/* Whether the namespace walk would have found @name under the device */
+static bool armoury_fake_present(const struct armoury_fake_fw *fw, const char *name)
+{
+    bool set;
+    int id = armoury_fake_state(fw, name, &set);
+
+    return id < 0 || !(fw->absent & BIT(id));
+}
+
+/* The power limit @setting selects, or -ENOENT */
+static int armoury_fake_power(const struct armoury_fake_fw *fw, u32 setting)
+{
+    int i;
+
+    for (i = 0; i < ARMOURY_POWER_COUNT; i++) {
+        if (asus_armoury_power.settings[i] == setting)
+            return fw->no_power & BIT(i) ? -ENOENT : i;
+    }
+
+    return -ENOENT;
+}
+
+/* GBMD; caller holds fw->lock */
+static u32 armoury_fake_bios_get(const struct armoury_fake_fw *fw, u32 setting)
+{
+    u32 status = ASUS_BIOS_DSTS_PRESENCE;
+    int id = armoury_fake_power(fw, setting);
+
+    if (id >= 0)
+        return status | fw->power[id];
+
+    switch (setting) {
+    case ASUS_BIOS_THERMAL_POLICY:
+        return status | fw->thermal_policy;
+    default:
+        return 0;
+    }
+}
+
+/* The fan whose curve @setting selects, or -ENOENT */
+static int armoury_fake_fan(u32 setting)
+{
+    int i;
+
+    for (i = 0; i < ARMOURY_FAN_COUNT; i++) {
+        if (asus_armoury_fan_curves.settings[i] == setting)
+            return i;
+    }
+
+    return -ENOENT;
+}
+
+/* SBMD; caller holds fw->lock */
+static int armoury_fake_bios_set(struct armoury_fake_fw *fw, const u32 *args, u32 nargs)
+{
+    struct armoury_fan_curve *curve;
+    int fan, i;
+
+    fw->last_set = args[0];
+    if (nargs == 2 && args[0] == ASUS_BIOS_THERMAL_POLICY) {
+        fw->thermal_policy = args[1];
+        return 0;
+    }
+
+    i = nargs == 2 ? armoury_fake_power(fw, args[0]) : -ENOENT;
+    if (i >= 0) {
+        fw->power[i] = args[1];
+        return 0;
+    }
+
+    fan = nargs == 1 + ARMOURY_FAN_CURVE_POINTS / 2 ? armoury_fake_fan(args[0]) : -ENOENT;
+    if (fan < 0 || fw->no_fan_curves)
+        return -EIO;
+
+    curve = &fw->fans[fan];
+    for (i = 0; i < ARMOURY_FAN_CURVE_POINTS; i++) {
+        curve->temp[i] = args[1 + i / 4] >> (8 * (i % 4));
+        curve->duty[i] = args[1 + (ARMOURY_FAN_CURVE_POINTS + i) / 4] >> (8 * (i % 4));
+    }
+    return 0;
+}
+
+/* Stands in for universal_armoury_acpi_evaluate_args() */
+static int armoury_fake_evaluate_args(struct universal_armoury *armoury,
+                                      struct armoury_method *method,
+                                      const u32 *args, u32 nargs, u32 *result)
+{
+    struct armoury_fake_fw *fw = kunit_get_current_test()->priv;
+    u32 value = 0;
+    bool set;
+    int id, ret = 0;
+
+    if (!method->handle)
+        return -ENODEV;
+
+    lockdep_assert_held(&armoury->lock);
+    atomic_inc(&fw->calls);
+    if (fw->delay_us)
+        udelay(fw->delay_us);
+    if (fw->fail_method && !strcmp(fw->fail_method, method->name))
+        return fw->fail_err;
+
+    spin_lock(&fw->lock);
+    if (!strcmp(method->name, ASUS_ACPI_GET_BIOS_SETTINGS)) {
+        value = armoury_fake_bios_get(fw, nargs ? args[0] : 0);
+    } else if (!strcmp(method->name, ASUS_ACPI_SET_BIOS_SETTINGS)) {
+        ret = armoury_fake_bios_set(fw, args, nargs);
+    } else {
+        id = armoury_fake_state(fw, method->name, &set);
+        if (id < 0 || !nargs)
+            ret = -EIO;
+        else if (set)
+            fw->regs[id] = args[0];
+        else
+            value = fw->regs[id];
+    }
+    spin_unlock(&fw->lock);
+
+    if (!ret && result)
+        *result = value;
+    return ret;
+}
+
+/* Stands in for universal_armoury_acpi_evaluate_buf(), only GBMD has buffers */
+static int armoury_fake_evaluate_buf(struct universal_armoury *armoury,
+                                     struct armoury_method *method,
+                                     const u32 *args, u32 nargs, u8 *buf, u32 len)
+{
+    struct armoury_fake_fw *fw = kunit_get_current_test()->priv;
+    int fan;
+
+    if (!method->handle)
+        return -ENODEV;
+
+    lockdep_assert_held(&armoury->lock);
+    atomic_inc(&fw->calls);
+    if (fw->fail_method && !strcmp(fw->fail_method, method->name))
+        return fw->fail_err;
+
+    fan = nargs == 1 ? armoury_fake_fan(args[0]) : -ENOENT;
+    if (strcmp(method->name, ASUS_ACPI_GET_BIOS_SETTINGS) || fan < 0 ||
+        fw->no_fan_curves || len > sizeof(fw->fans[fan]))
+        return -ENODEV;
+
+    spin_lock(&fw->lock);
+    memcpy(buf, &fw->fans[fan], len);
+    spin_unlock(&fw->lock);
+
+    return 0;
+}
+
+/* Vendor bulk reader over the fake registers, one firmware call */
+static int armoury_fake_read_all(struct universal_armoury *armoury,
+                                 struct armoury_state_snapshot *snap)
+{
+    struct armoury_fake_fw *fw = kunit_get_current_test()->priv;
+    int i;
+
+    lockdep_assert_held(&armoury->lock);
+    atomic_inc(&fw->calls);
+    if (fw->no_bulk)
+        return -ENODEV;
+
+    spin_lock(&fw->lock);
+    for (i = 0; i < ARMOURY_STATE_COUNT; i++)
+        snap->values[i] = fw->regs[i];
+    spin_unlock(&fw->lock);
+    snap->valid = GENMASK(ARMOURY_STATE_COUNT - 1, 0);
+
+    return 0;
+}
+
+static const struct armoury_vendor_ops armoury_fake_ops = {
+    .read_all = armoury_fake_read_all,
+};
+
+static int armoury_fake_reg(struct armoury_fake_fw *fw, enum armoury_state_id id)
+{
+    int value;
+
+    spin_lock(&fw->lock);
+    value = fw->regs[id];
+    spin_unlock(&fw->lock);
+
+    return value;
+}
+
+/*
+ * Assemble a device the way universal_armoury_add() does, with the namespace
+ * walk replaced by the methods the fake firmware offers. Leaves it unprobed.
+ */
+static struct universal_armoury *armoury_test_create(struct kunit *test)
+{
+    struct armoury_fake_fw *fw = test->priv;
+    struct armoury_method *methods[ARMOURY_MAX_METHODS];
+    const struct armoury_cap_pair *pair;
+    struct armoury_vendor_desc *desc;
+    struct universal_armoury *armoury;
+    struct acpi_device *adev;
+    int i, n;
+
+    adev = kunit_kzalloc(test, sizeof(*adev), GFP_KERNEL);
+    armoury = kunit_kzalloc(test, sizeof(*armoury), GFP_KERNEL);
+    desc = kunit_kzalloc(test, sizeof(*desc), GFP_KERNEL);
+    KUNIT_ASSERT_NOT_NULL(test, adev);
+    KUNIT_ASSERT_NOT_NULL(test, armoury);
+    KUNIT_ASSERT_NOT_NULL(test, desc);
+
+    /* No platform_profile class device for a node that was never bound */
+    *desc = *fw->desc;
+    desc->profile = NULL;
+    if (fw->bulk)
+        desc->ops = &armoury_fake_ops;
+
+    armoury->acpi_dev = adev;
+    adev->driver_data = armoury;
+    mutex_init(&armoury->lock);
+    seqcount_mutex_init(&armoury->cache_seq, &armoury->lock);
+    INIT_LIST_HEAD(&armoury->switch_inflight);
+    INIT_LIST_HEAD(&armoury->switch_reqs);
+    INIT_WORK(&armoury->switch_work, universal_armoury_switch_work);
+    INIT_WORK(&armoury->resume_work, universal_armoury_resume_work);
+    for (i = 0; i < ARMOURY_STATE_COUNT; i++) {
+        armoury->pending[i].armoury = armoury;
+        armoury->pending[i].id = i;
+        INIT_DELAYED_WORK(&armoury->pending[i].work, universal_armoury_coalesce_work);
+    }
+    armoury->gov_source = ARMOURY_GOV_UNKNOWN;
+    armoury->desc = desc;
+    armoury->vendor = desc->vendor;
+    set_vendor_acpi_methods(armoury);
+
+    /* Any non-NULL handle will do, the fake goes by method name */
+    n = armoury_method_list(armoury, methods);
+    for (i = 0; i < n; i++) {
+        if (methods[i]->name && armoury_fake_present(fw, methods[i]->name))
+            methods[i]->handle = methods[i];
+    }
+    for (i = 0; i < ARMOURY_NR_CAP_PAIRS; i++) {
+        pair = &universal_armoury_cap_pairs[i];
+        if (!(fw->pairs & BIT(i)))
+            continue;
+        armoury->caps[i].get_handle = (acpi_handle)pair->get;
+        armoury->caps[i].set_handle = (acpi_handle)pair->set;
+        armoury->caps[i].get_args = 1;
+        armoury->caps[i].set_args = 1;
+    }
+
+    universal_armoury_detect_features(armoury);
+
+    return armoury;
+}
+
+/* A device with the first firmware read behind it */
+static struct universal_armoury *armoury_test_bind(struct kunit *test)
+{
+    struct universal_armoury *armoury = armoury_test_create(test);
+
+    universal_armoury_probe_features(armoury);
+    KUNIT_ASSERT_TRUE(test, armoury->probed);
+
+    return armoury;
+}
+
+static struct device_attribute * const armoury_test_attrs[ARMOURY_STATE_COUNT] = {
+    [ARMOURY_STATE_GPU_MUX] = &dev_attr_gpu_mux,
+    [ARMOURY_STATE_DGPU_DISABLE] = &dev_attr_dgpu_disable,
+    [ARMOURY_STATE_EGPU_ENABLE] = &dev_attr_egpu_enable,
+};
+
+/* sysfs show, returning the value read or a negative errno */
+static int armoury_test_show(struct kunit *test, struct universal_armoury *armoury,
+                             enum armoury_state_id id)
+{
+    struct device *dev = &armoury->acpi_dev->dev;
+    char *buf = kunit_kzalloc(test, PAGE_SIZE, GFP_KERNEL);
+    ssize_t len;
+    int value;
+
+    KUNIT_ASSERT_NOT_NULL(test, buf);
+    len = armoury_test_attrs[id]->show(dev, armoury_test_attrs[id], buf);
+    if (len < 0)
+        return len;
+
+    KUNIT_EXPECT_EQ(test, kstrtoint(buf, 10, &value), 0);
+    return value;
+}
+
+static ssize_t armoury_test_store(struct universal_armoury *armoury,
+                                  enum armoury_state_id id, const char *buf)
+{
+    struct device *dev = &armoury->acpi_dev->dev;
+
+    return armoury_test_attrs[id]->store(dev, armoury_test_attrs[id], buf, strlen(buf));
+}
+
+static int armoury_test_pair(const char *get)
+{
+    int i;
+
+    for (i = 0; i < ARMOURY_NR_CAP_PAIRS; i++) {
+        if (!strcmp(universal_armoury_cap_pairs[i].get, get))
+            return i;
+    }
+
+    return -1;
+}
+
+/* Every enum laptop_vendor, through the descriptors the DMI table uses */
+static const struct armoury_vendor_desc * const armoury_test_vendors[] = {
+    &armoury_vendor_unknown,
+    &armoury_vendor_asus,
+    &armoury_vendor_msi,
+    &armoury_vendor_dell,
+    &armoury_vendor_lenovo,
+    &armoury_vendor_hp,
+    &armoury_vendor_acer,
+    &armoury_vendor_generic,
+};
+
+static void armoury_test_vendor_name(const struct armoury_vendor_desc * const *desc,
+                                     char *name)
+{
+    strscpy(name, (*desc)->name, KUNIT_PARAM_DESC_SIZE);
+}
+
+KUNIT_ARRAY_PARAM(armoury_test_vendor, armoury_test_vendors, armoury_test_vendor_name);
+
+static void armoury_test_use_vendor(struct kunit *test)
+{
+    const struct armoury_vendor_desc * const *desc = test->param_value;
+    struct armoury_fake_fw *fw = test->priv;
+
+    fw->desc = *desc;
+}
+
+/* Every state the vendor describes is probed, one getter call each */
+static void armoury_test_probe_vendor(struct kunit *test)
+{
+    struct armoury_fake_fw *fw = test->priv;
+    struct universal_armoury *armoury;
+    int i;
+
+    armoury_test_use_vendor(test);
+    armoury = armoury_test_bind(test);
+
+    for (i = 0; i < ARMOURY_STATE_COUNT; i++)
+        KUNIT_EXPECT_EQ_MSG(test, armoury_state_supported(armoury, i),
+                            !!(fw->desc->features & BIT(i)), "%s",
+                            armoury_state_attr_names[i]);
+
+    KUNIT_EXPECT_EQ(test, armoury->fan_curves,
+                    fw->desc->fan_curves ? GENMASK(ARMOURY_FAN_COUNT - 1, 0) : 0);
+    KUNIT_EXPECT_EQ(test, armoury->power_limits,
+                    fw->desc->power ? GENMASK(ARMOURY_POWER_COUNT - 1, 0) : 0);
+    KUNIT_EXPECT_EQ(test, atomic_read(&fw->calls),
+                    hweight_long(fw->desc->features) +
+                    (fw->desc->fan_curves ? ARMOURY_FAN_COUNT : 0) +
+                    (fw->desc->power ? ARMOURY_POWER_COUNT : 0));
+}
+
+/* Show reports firmware values, store reaches the vendor setter */
+static void armoury_test_show_store_vendor(struct kunit *test)
+{
+    struct armoury_fake_fw *fw = test->priv;
+    struct universal_armoury *armoury;
+    int i;
+
+    armoury_test_use_vendor(test);
+    for (i = 0; i < ARMOURY_STATE_COUNT; i++)
+        fw->regs[i] = i & 1;
+    armoury = armoury_test_bind(test);
+
+    for (i = 0; i < ARMOURY_STATE_COUNT; i++) {
+        if (!(fw->desc->features & BIT(i))) {
+            KUNIT_EXPECT_EQ(test, armoury_test_show(test, armoury, i), -ENODEV);
+            KUNIT_EXPECT_EQ(test, armoury_test_store(armoury, i, "1"), -ENODEV);
+            continue;
+        }
+        KUNIT_EXPECT_EQ(test, armoury_test_show(test, armoury, i), i & 1);
+        KUNIT_EXPECT_EQ(test, armoury_test_store(armoury, i, "1\n"), 2);
+        KUNIT_EXPECT_EQ(test, armoury_fake_reg(fw, i), 1);
+        KUNIT_EXPECT_EQ(test, armoury_test_show(test, armoury, i), 1);
+    }
+}
+
+/* A getter that fails on the first read takes its state down with it */
+static void armoury_test_probe_drops_failing_getter(struct kunit *test)
+{
+    struct armoury_fake_fw *fw = test->priv;
+    struct universal_armoury *armoury;
+
+    fw->desc = &armoury_vendor_msi;
+    fw->fail_method = MSI_ACPI_GET_GPU_MUX_STATE;
+    fw->fail_err = -EIO;
+    armoury = armoury_test_bind(test);
+
+    KUNIT_EXPECT_FALSE(test, armoury->gpu_mux_supported);
+    KUNIT_EXPECT_TRUE(test, armoury->dgpu_disable_supported);
+    KUNIT_EXPECT_EQ(test, armoury_test_show(test, armoury, ARMOURY_STATE_GPU_MUX), -ENODEV);
+}
+
+/* Methods missing from the namespace are never evaluated */
+static void armoury_test_probe_absent_method(struct kunit *test)
+{
+    struct armoury_fake_fw *fw = test->priv;
+    struct universal_armoury *armoury;
+
+    fw->desc = &armoury_vendor_dell;
+    fw->absent = BIT(ARMOURY_STATE_DGPU_DISABLE);
+    armoury = armoury_test_bind(test);
+
+    KUNIT_EXPECT_TRUE(test, armoury->gpu_mux_supported);
+    KUNIT_EXPECT_FALSE(test, armoury->dgpu_disable_supported);
+    KUNIT_EXPECT_EQ(test, atomic_read(&fw->calls), 1);
+}
+
+/* Without any vendor method, known pairs from the namespace walk are used */
+static void armoury_test_probe_fallback_pairs(struct kunit *test)
+{
+    struct armoury_fake_fw *fw = test->priv;
+    struct universal_armoury *armoury;
+    int pair = armoury_test_pair(DELL_ACPI_GET_GPU_MUX_STATE);
+
+    KUNIT_ASSERT_GE(test, pair, 0);
+    fw->desc = &armoury_vendor_hp;
+    fw->absent = BIT(ARMOURY_STATE_GPU_MUX) | BIT(ARMOURY_STATE_DGPU_DISABLE);
+    fw->pairs = BIT(pair);
+    fw->regs[ARMOURY_STATE_GPU_MUX] = 1;
+    armoury = armoury_test_bind(test);
+
+    KUNIT_EXPECT_TRUE(test, armoury->gpu_mux_supported);
+    KUNIT_EXPECT_FALSE(test, armoury->dgpu_disable_supported);
+    KUNIT_EXPECT_STREQ(test, armoury->get_gpu_mux_method.name, DELL_ACPI_GET_GPU_MUX_STATE);
+    KUNIT_EXPECT_STREQ(test, armoury->set_gpu_mux_method.name, DELL_ACPI_SET_GPU_MUX_STATE);
+    KUNIT_EXPECT_EQ(test, armoury_test_show(test, armoury, ARMOURY_STATE_GPU_MUX), 1);
+    KUNIT_EXPECT_EQ(test, armoury_test_store(armoury, ARMOURY_STATE_GPU_MUX, "0"), 1);
+    KUNIT_EXPECT_EQ(test, armoury_fake_reg(fw, ARMOURY_STATE_GPU_MUX), 0);
+}
+
+/* A vendor bulk read stands in for every getter */
+static void armoury_test_bulk_read(struct kunit *test)
+{
+    struct armoury_fake_fw *fw = test->priv;
+    struct universal_armoury *armoury;
+
+    fw->bulk = true;
+    fw->regs[ARMOURY_STATE_DGPU_DISABLE] = 1;
+    armoury = armoury_test_bind(test);
+
+    KUNIT_EXPECT_FALSE(test, armoury->bulk_read_broken);
+    KUNIT_EXPECT_EQ(test, atomic_read(&fw->calls),
+                    1 + ARMOURY_FAN_COUNT + ARMOURY_POWER_COUNT);
+    KUNIT_EXPECT_EQ(test, armoury_test_show(test, armoury, ARMOURY_STATE_DGPU_DISABLE), 1);
+}
+
+/* A bulk reader without the selector falls back to per-method reads for good */
+static void armoury_test_bulk_read_fallback(struct kunit *test)
+{
+    struct armoury_fake_fw *fw = test->priv;
+    struct universal_armoury *armoury;
+
+    fw->bulk = true;
+    fw->no_bulk = true;
+    fw->regs[ARMOURY_STATE_EGPU_ENABLE] = 1;
+    armoury = armoury_test_bind(test);
+
+    KUNIT_EXPECT_TRUE(test, armoury->bulk_read_broken);
+    KUNIT_EXPECT_EQ(test, atomic_read(&fw->calls),
+                    1 + ARMOURY_STATE_COUNT + ARMOURY_FAN_COUNT + ARMOURY_POWER_COUNT);
+    KUNIT_EXPECT_EQ(test, armoury_test_show(test, armoury, ARMOURY_STATE_EGPU_ENABLE), 1);
+}
+
+/* Reads within cache_ttl_ms are served without firmware */
+static void armoury_test_show_cache_ttl(struct kunit *test)
+{
+    struct armoury_fake_fw *fw = test->priv;
+    struct universal_armoury *armoury;
+    int calls;
+
+    fw->desc = &armoury_vendor_msi;
+    armoury = armoury_test_bind(test);
+    calls = atomic_read(&fw->calls);
+
+    KUNIT_EXPECT_EQ(test, armoury_test_show(test, armoury, ARMOURY_STATE_GPU_MUX), 0);
+    KUNIT_EXPECT_EQ(test, atomic_read(&fw->calls), calls);
+
+    /* Firmware changed behind the driver's back, e.g. by a hotkey */
+    fw->regs[ARMOURY_STATE_GPU_MUX] = 1;
+    cache_ttl_ms = 0;
+    KUNIT_EXPECT_EQ(test, armoury_test_show(test, armoury, ARMOURY_STATE_GPU_MUX), 1);
+    KUNIT_EXPECT_EQ(test, armoury_test_show(test, armoury, ARMOURY_STATE_GPU_MUX), 1);
+    KUNIT_EXPECT_EQ(test, atomic_read(&fw->calls), calls + 2);
+}
+
+/* Malformed and out of range values are rejected before any firmware call */
+static void armoury_test_store_validation(struct kunit *test)
+{
+    static const char * const bad[] = { "2", "-1", "abc", "1x", "", "99999999999" };
+    struct armoury_fake_fw *fw = test->priv;
+    struct universal_armoury *armoury;
+    int i, calls;
+
+    armoury = armoury_test_bind(test);
+    calls = atomic_read(&fw->calls);
+
+    for (i = 0; i < ARRAY_SIZE(bad); i++)
+        KUNIT_EXPECT_LT_MSG(test, armoury_test_store(armoury, ARMOURY_STATE_GPU_MUX, bad[i]),
+                            0, "\"%s\"", bad[i]);
+    KUNIT_EXPECT_EQ(test, atomic_read(&fw->calls), calls);
+    KUNIT_EXPECT_EQ(test, armoury_fake_reg(fw, ARMOURY_STATE_GPU_MUX), 0);
+
+    KUNIT_EXPECT_EQ(test, armoury_test_store(armoury, ARMOURY_STATE_GPU_MUX, "1\n"), 2);
+    KUNIT_EXPECT_EQ(test, armoury_fake_reg(fw, ARMOURY_STATE_GPU_MUX), 1);
+}
+
+/* Writing the value firmware holds is skipped while it is known */
+static void armoury_test_store_skips_known_value(struct kunit *test)
+{
+    struct armoury_fake_fw *fw = test->priv;
+    struct universal_armoury *armoury;
+    int calls;
+
+    armoury = armoury_test_bind(test);
+    calls = atomic_read(&fw->calls);
+
+    KUNIT_EXPECT_EQ(test, armoury_test_store(armoury, ARMOURY_STATE_DGPU_DISABLE, "1"), 1);
+    KUNIT_EXPECT_EQ(test, armoury_test_store(armoury, ARMOURY_STATE_DGPU_DISABLE, "1"), 1);
+    KUNIT_EXPECT_EQ(test, atomic_read(&fw->calls), calls + 1);
+    KUNIT_EXPECT_EQ(test, atomic_long_read(&armoury->writes_short_circuited), 1);
+
+    cache_ttl_ms = 0;
+    KUNIT_EXPECT_EQ(test, armoury_test_store(armoury, ARMOURY_STATE_DGPU_DISABLE, "1"), 1);
+    KUNIT_EXPECT_EQ(test, atomic_read(&fw->calls), calls + 2);
+}
+
+/* A failed setter is reported and the state is read from firmware again */
+static void armoury_test_store_setter_failure(struct kunit *test)
+{
+    struct armoury_fake_fw *fw = test->priv;
+    struct universal_armoury *armoury;
+    int calls;
+
+    fw->desc = &armoury_vendor_lenovo;
+    armoury = armoury_test_bind(test);
+    fw->fail_method = LENOVO_ACPI_SET_DGPU_DISABLE;
+    fw->fail_err = -EIO;
+
+    KUNIT_EXPECT_EQ(test, armoury_test_store(armoury, ARMOURY_STATE_DGPU_DISABLE, "1"), -EIO);
+    KUNIT_EXPECT_FALSE(test, armoury->cache[ARMOURY_STATE_DGPU_DISABLE].known);
+
+    calls = atomic_read(&fw->calls);
+    KUNIT_EXPECT_EQ(test, armoury_test_show(test, armoury, ARMOURY_STATE_DGPU_DISABLE), 0);
+    KUNIT_EXPECT_EQ(test, atomic_read(&fw->calls), calls + 1);
+}
+
+/* A coalescing window that closes late holds back switch_status */
+static void armoury_test_switch_out_of_order(struct kunit *test)
+{
+    struct universal_armoury *armoury;
+    struct device *dev;
+    char *buf = kunit_kzalloc(test, PAGE_SIZE, GFP_KERNEL);
+
+    KUNIT_ASSERT_NOT_NULL(test, buf);
+    armoury = armoury_test_bind(test);
+    dev = &armoury->acpi_dev->dev;
+    coalesce_ms = 60000;
+
+    KUNIT_EXPECT_EQ(test, armoury_test_store(armoury, ARMOURY_STATE_GPU_MUX, "1"), 1);
+    KUNIT_EXPECT_EQ(test, armoury_test_store(armoury, ARMOURY_STATE_DGPU_DISABLE, "1"), 1);
+    cancel_delayed_work_sync(&armoury->pending[ARMOURY_STATE_GPU_MUX].work);
+    cancel_delayed_work_sync(&armoury->pending[ARMOURY_STATE_DGPU_DISABLE].work);
+
+    /* The later write completes first */
+    universal_armoury_coalesce_work(&armoury->pending[ARMOURY_STATE_DGPU_DISABLE].work.work);
+    KUNIT_EXPECT_EQ(test, armoury->switch_gen_queued, 2);
+    KUNIT_EXPECT_EQ(test, armoury->switch_gen_done, 0);
+    dev_attr_switch_status.show(dev, &dev_attr_switch_status, buf);
+    KUNIT_EXPECT_STREQ(test, buf, "pending generation:2 completed:0 errno:0\n");
+
+    /* A write reopening the window keeps its earlier generation outstanding */
+    KUNIT_EXPECT_EQ(test, armoury_test_store(armoury, ARMOURY_STATE_GPU_MUX, "0"), 1);
+    cancel_delayed_work_sync(&armoury->pending[ARMOURY_STATE_GPU_MUX].work);
+    KUNIT_EXPECT_EQ(test, armoury->switch_gen_done, 0);
+
+    universal_armoury_coalesce_work(&armoury->pending[ARMOURY_STATE_GPU_MUX].work.work);
+    KUNIT_EXPECT_EQ(test, armoury->switch_gen_done, 3);
+    dev_attr_switch_status.show(dev, &dev_attr_switch_status, buf);
+    KUNIT_EXPECT_STREQ(test, buf, "done generation:3 completed:3 errno:0\n");
+}
+
+/* Holds the ordered workqueue so a queued item stays pending */
+struct armoury_test_blocker {
+    struct work_struct work;
+    struct completion release;
+};
+
+static void armoury_test_blocker_fn(struct work_struct *work)
+{
+    struct armoury_test_blocker *b = container_of(work, struct armoury_test_blocker, work);
+
+    wait_for_completion(&b->release);
+}
+
+/* Suspending again before the restore ran keeps the targets recorded first */
+static void armoury_test_resume_resuspend(struct kunit *test)
+{
+    struct armoury_fake_fw *fw = test->priv;
+    struct armoury_test_blocker *b = kunit_kzalloc(test, sizeof(*b), GFP_KERNEL);
+    struct universal_armoury *armoury;
+    struct device *dev;
+
+    KUNIT_ASSERT_NOT_NULL(test, b);
+    armoury = armoury_test_bind(test);
+    dev = &armoury->acpi_dev->dev;
+    KUNIT_EXPECT_EQ(test, armoury_test_store(armoury, ARMOURY_STATE_DGPU_DISABLE, "1"), 1);
+
+    INIT_WORK(&b->work, armoury_test_blocker_fn);
+    init_completion(&b->release);
+    queue_work(universal_armoury_wq, &b->work);
+
+    KUNIT_EXPECT_EQ(test, universal_armoury_suspend(dev), 0);
+    KUNIT_EXPECT_EQ(test, universal_armoury_resume(dev), 0);
+    /* Firmware reverted while asleep, then the machine suspends again */
+    spin_lock(&fw->lock);
+    fw->regs[ARMOURY_STATE_DGPU_DISABLE] = 0;
+    spin_unlock(&fw->lock);
+    KUNIT_EXPECT_EQ(test, universal_armoury_suspend(dev), 0);
+    KUNIT_EXPECT_TRUE(test, armoury->resume_desired_mask & BIT(ARMOURY_STATE_DGPU_DISABLE));
+
+    /* The fake firmware only answers on this thread, so run the restore here */
+    KUNIT_EXPECT_EQ(test, universal_armoury_resume(dev), 0);
+    KUNIT_EXPECT_TRUE(test, cancel_work_sync(&armoury->resume_work));
+    complete(&b->release);
+    flush_work(&b->work);
+
+    universal_armoury_resume_work(&armoury->resume_work);
+    KUNIT_EXPECT_EQ(test, armoury_fake_reg(fw, ARMOURY_STATE_DGPU_DISABLE), 1);
+    KUNIT_EXPECT_EQ(test, armoury->restores, 1);
+}
+
+static const struct armoury_fan_curve armoury_test_fan_curve = {
+    .temp = { 30, 40, 50, 60, 70, 80, 90, 100 },
+    .duty = { 0, 10, 20, 35, 50, 65, 80, 100 },
+};
+
+/* sysfs store of a whole curve */
+static ssize_t armoury_test_store_curve(struct universal_armoury *armoury,
+                                        struct device_attribute *attr, const char *buf)
+{
+    return attr->store(&armoury->acpi_dev->dev, attr, buf, strlen(buf));
+}
+
+/* A curve is shown as written and uploaded in a single firmware call */
+static void armoury_test_fan_curve_round_trip(struct kunit *test)
+{
+    static const char curve[] = "35:5 45:15 55:25 65:40 75:55 85:70 95:85 105:100\n";
+    struct armoury_fake_fw *fw = test->priv;
+    struct universal_armoury *armoury;
+    char *buf = kunit_kzalloc(test, PAGE_SIZE, GFP_KERNEL);
+    int calls;
+
+    KUNIT_ASSERT_NOT_NULL(test, buf);
+    armoury = armoury_test_bind(test);
+    KUNIT_ASSERT_EQ(test, armoury->fan_curves, GENMASK(ARMOURY_FAN_COUNT - 1, 0));
+
+    calls = atomic_read(&fw->calls);
+    KUNIT_EXPECT_EQ(test, armoury_test_store_curve(armoury, &dev_attr_gpu_fan_curve, curve),
+                    (ssize_t)strlen(curve));
+    KUNIT_EXPECT_EQ(test, atomic_read(&fw->calls), calls + 1);
+    KUNIT_EXPECT_EQ(test, fw->fans[ARMOURY_FAN_GPU].temp[7], 105);
+    KUNIT_EXPECT_EQ(test, fw->fans[ARMOURY_FAN_GPU].duty[3], 40);
+    KUNIT_EXPECT_MEMEQ(test, &fw->fans[ARMOURY_FAN_CPU], &armoury_test_fan_curve,
+                       sizeof(armoury_test_fan_curve));
+
+    KUNIT_EXPECT_GT(test, dev_attr_gpu_fan_curve.show(&armoury->acpi_dev->dev,
+                                                      &dev_attr_gpu_fan_curve, buf), 0);
+    KUNIT_EXPECT_STREQ(test, buf, curve);
+}
+
+/* Malformed, unordered and out of range curves never reach firmware */
+static void armoury_test_fan_curve_validation(struct kunit *test)
+{
+    static const char * const bad[] = {
+        "",
+        "30:0 40:10 50:20 60:35 70:50 80:65 90:80",
+        "30:0 40:10 50:20 60:35 70:50 80:65 90:80 100:100 110:100",
+        "30:0 40:10 50:20 60:35 70:50 80:65 90:80 100:100x",
+        "30:0 40:10 50:20 50:35 70:50 80:65 90:80 100:100",
+        "30:0 40:10 50:20 60:15 70:50 80:65 90:80 100:100",
+        "30:0 40:10 50:20 60:35 70:50 80:65 90:80 100:101",
+        "30:0 40:10 50:20 60:35 70:50 80:65 90:80 111:100",
+        "30 40 50 60 70 80 90 100",
+    };
+    struct armoury_fake_fw *fw = test->priv;
+    struct universal_armoury *armoury;
+    int i, calls;
+
+    armoury = armoury_test_bind(test);
+    calls = atomic_read(&fw->calls);
+
+    for (i = 0; i < ARRAY_SIZE(bad); i++)
+        KUNIT_EXPECT_LT_MSG(test, armoury_test_store_curve(armoury, &dev_attr_cpu_fan_curve,
+                                                           bad[i]), 0, "\"%s\"", bad[i]);
+    KUNIT_EXPECT_EQ(test, atomic_read(&fw->calls), calls);
+    KUNIT_EXPECT_MEMEQ(test, &fw->fans[ARMOURY_FAN_CPU], &armoury_test_fan_curve,
+                       sizeof(armoury_test_fan_curve));
+}
+
+/* Reset puts back the curves firmware had at probe, one call per fan */
+static void armoury_test_fan_curve_reset(struct kunit *test)
+{
+    static const char curve[] = "20:0 30:0 40:0 50:0 60:30 70:60 80:90 90:100";
+    struct armoury_fake_fw *fw = test->priv;
+    struct universal_armoury *armoury;
+    int i, calls;
+
+    armoury = armoury_test_bind(test);
+    KUNIT_EXPECT_GT(test, armoury_test_store_curve(armoury, &dev_attr_cpu_fan_curve, curve), 0);
+    KUNIT_EXPECT_GT(test, armoury_test_store_curve(armoury, &dev_attr_gpu_fan_curve, curve), 0);
+
+    calls = atomic_read(&fw->calls);
+    KUNIT_EXPECT_EQ(test, armoury_test_store_curve(armoury, &dev_attr_fan_curve_reset, "1"), 1);
+    KUNIT_EXPECT_EQ(test, atomic_read(&fw->calls), calls + ARMOURY_FAN_COUNT);
+    for (i = 0; i < ARMOURY_FAN_COUNT; i++)
+        KUNIT_EXPECT_MEMEQ(test, &fw->fans[i], &armoury_test_fan_curve,
+                           sizeof(armoury_test_fan_curve));
+}
+
+/* Vendors or BIOSes without curves keep the attributes inert */
+static void armoury_test_fan_curve_unsupported(struct kunit *test)
+{
+    static const char curve[] = "30:0 40:10 50:20 60:35 70:50 80:65 90:80 100:100";
+    struct armoury_fake_fw *fw = test->priv;
+    struct universal_armoury *armoury;
+    char *buf = kunit_kzalloc(test, PAGE_SIZE, GFP_KERNEL);
+
+    KUNIT_ASSERT_NOT_NULL(test, buf);
+    fw->no_fan_curves = true;
+    armoury = armoury_test_bind(test);
+
+    KUNIT_EXPECT_EQ(test, armoury->fan_curves, 0);
+    KUNIT_EXPECT_EQ(test, dev_attr_cpu_fan_curve.show(&armoury->acpi_dev->dev,
+                                                      &dev_attr_cpu_fan_curve, buf), -ENODEV);
+    KUNIT_EXPECT_EQ(test, armoury_test_store_curve(armoury, &dev_attr_cpu_fan_curve, curve),
+                    -ENODEV);
+    KUNIT_EXPECT_EQ(test, armoury_test_store_curve(armoury, &dev_attr_fan_curve_reset, "1"),
+                    -ENODEV);
+}
+
+/* Name the device the way capability cache records do */
+static void armoury_test_identify(struct universal_armoury *armoury)
+{
+    strscpy(armoury->vendor_name, "ASUSTeK", sizeof(armoury->vendor_name));
+    strscpy(armoury->product_name, "GA402RJ", sizeof(armoury->product_name));
+    strscpy(armoury->bios_version, "318", sizeof(armoury->bios_version));
+    armoury->acpi_dev->dev.kobj.name = "ATK4001:00";
+}
+
+/* A cache hit skips every probe read, fan curves and power limits included */
+static void armoury_test_capcache_hit(struct kunit *test)
+{
+    static const char * const curves[] = {
+        "20:0 30:5 40:10 50:20 60:30 70:40 80:60 90:90",
+        "20:0 30:5 40:10 50:20 60:30 70:40 80:60 90:95",
+    };
+    struct armoury_fake_fw *fw = test->priv;
+    struct universal_armoury *armoury;
+    struct device *dev;
+    int i, calls;
+
+    /* gpu_mux, the CPU fan curve and FPPT */
+    static_assert((BIT(ARMOURY_STATE_GPU_MUX) |
+                   BIT(ARMOURY_CAPCACHE_FAN_SHIFT + ARMOURY_FAN_CPU) |
+                   BIT(ARMOURY_CAPCACHE_POWER_SHIFT + ARMOURY_POWER_FPPT)) == 0x4101);
+    static_assert(ARMOURY_CAPCACHE_BIOS == 2);
+    capcache = "ASUSTeK|GA402RJ|318|ATK4001:00|0x4101|2";
+
+    armoury = armoury_test_create(test);
+    armoury_test_identify(armoury);
+    dev = &armoury->acpi_dev->dev;
+    universal_armoury_probe_features(armoury);
+
+    KUNIT_EXPECT_EQ(test, atomic_read(&fw->calls), 0);
+    KUNIT_EXPECT_TRUE(test, armoury->gpu_mux_supported);
+    KUNIT_EXPECT_FALSE(test, armoury->dgpu_disable_supported);
+    KUNIT_EXPECT_EQ(test, armoury->fan_curves, BIT(ARMOURY_FAN_CPU));
+    KUNIT_EXPECT_EQ(test, armoury->power_limits, BIT(ARMOURY_POWER_FPPT));
+
+    /* Nothing uploaded yet, so the reset has nothing to put back */
+    KUNIT_EXPECT_EQ(test, dev_attr_fan_curve_reset.store(dev, &dev_attr_fan_curve_reset,
+                                                         "1", 1), 1);
+    KUNIT_EXPECT_EQ(test, atomic_read(&fw->calls), 0);
+
+    /* The boot curve is read once, before the first upload */
+    calls = atomic_read(&fw->calls);
+    for (i = 0; i < ARRAY_SIZE(curves); i++)
+        KUNIT_EXPECT_EQ(test, armoury_test_store_curve(armoury, &dev_attr_cpu_fan_curve,
+                                                       curves[i]), strlen(curves[i]));
+    KUNIT_EXPECT_EQ(test, atomic_read(&fw->calls), calls + 3);
+    KUNIT_EXPECT_EQ(test, dev_attr_fan_curve_reset.store(dev, &dev_attr_fan_curve_reset,
+                                                         "1", 1), 1);
+    KUNIT_EXPECT_MEMEQ(test, &fw->fans[ARMOURY_FAN_CPU], &armoury_test_fan_curve,
+                       sizeof(armoury_test_fan_curve));
+}
+
+/* Records without fan curve and power limit bits still probe those */
+static void armoury_test_capcache_old_record(struct kunit *test)
+{
+    struct armoury_fake_fw *fw = test->priv;
+    struct universal_armoury *armoury;
+
+    capcache = "ASUSTeK|GA402RJ|318|ATK4001:00|0x1|0";
+    armoury = armoury_test_create(test);
+    armoury_test_identify(armoury);
+    universal_armoury_probe_features(armoury);
+
+    KUNIT_EXPECT_TRUE(test, armoury->gpu_mux_supported);
+    KUNIT_EXPECT_EQ(test, armoury->fan_curves, GENMASK(ARMOURY_FAN_COUNT - 1, 0));
+    KUNIT_EXPECT_EQ(test, armoury->power_limits, GENMASK(ARMOURY_POWER_COUNT - 1, 0));
+    KUNIT_EXPECT_EQ(test, atomic_read(&fw->calls), ARMOURY_FAN_COUNT + ARMOURY_POWER_COUNT);
+}
+
+/* Limits read and written in watts, bounded by the vendor range */
+static void armoury_test_power_limit(struct kunit *test)
+{
+    struct armoury_fake_fw *fw = test->priv;
+    struct universal_armoury *armoury;
+    struct device *dev;
+    char *buf = kunit_kzalloc(test, PAGE_SIZE, GFP_KERNEL);
+    int calls;
+
+    KUNIT_ASSERT_NOT_NULL(test, buf);
+    fw->power[ARMOURY_POWER_PL1_SPL] = 45;
+    armoury = armoury_test_bind(test);
+    dev = &armoury->acpi_dev->dev;
+
+    KUNIT_EXPECT_GT(test, dev_attr_ppt_pl1_spl.show(dev, &dev_attr_ppt_pl1_spl, buf), 0);
+    KUNIT_EXPECT_STREQ(test, buf, "45\n");
+    KUNIT_EXPECT_GT(test, dev_attr_ppt_pl1_spl_max.show(dev, &dev_attr_ppt_pl1_spl_max, buf), 0);
+    KUNIT_EXPECT_STREQ(test, buf, "135\n");
+
+    KUNIT_EXPECT_EQ(test, dev_attr_ppt_pl1_spl.store(dev, &dev_attr_ppt_pl1_spl, "60\n", 3), 3);
+    KUNIT_EXPECT_EQ(test, fw->power[ARMOURY_POWER_PL1_SPL], 60);
+
+    calls = atomic_read(&fw->calls);
+    KUNIT_EXPECT_EQ(test, dev_attr_ppt_pl1_spl.store(dev, &dev_attr_ppt_pl1_spl, "4", 1),
+                    -EINVAL);
+    KUNIT_EXPECT_EQ(test, dev_attr_ppt_pl1_spl.store(dev, &dev_attr_ppt_pl1_spl, "136", 3),
+                    -EINVAL);
+    KUNIT_EXPECT_EQ(test, dev_attr_nv_dynamic_boost.store(dev, &dev_attr_nv_dynamic_boost,
+                                                          "30", 2), -EINVAL);
+    KUNIT_EXPECT_LT_MSG(test, dev_attr_ppt_pl1_spl.store(dev, &dev_attr_ppt_pl1_spl, "-5", 2),
+                        0, "negative");
+    KUNIT_EXPECT_EQ(test, atomic_read(&fw->calls), calls);
+    KUNIT_EXPECT_EQ(test, fw->power[ARMOURY_POWER_PL1_SPL], 60);
+}
+
+/* Each limit reaches the asus-wmi devid it is named after */
+static void armoury_test_power_selectors(struct kunit *test)
+{
+    static const struct {
+        struct device_attribute *attr;
+        u32 devid;
+    } cases[] = {
+        { &dev_attr_ppt_pl1_spl, 0x001200A3 },
+        { &dev_attr_ppt_pl2_sppt, 0x001200A0 },
+        { &dev_attr_ppt_fppt, 0x001200C1 },
+        { &dev_attr_nv_dynamic_boost, 0x001200C0 },
+    };
+    struct armoury_fake_fw *fw = test->priv;
+    struct universal_armoury *armoury;
+    struct device *dev;
+    int i;
+
+    armoury = armoury_test_bind(test);
+    dev = &armoury->acpi_dev->dev;
+
+    for (i = 0; i < ARRAY_SIZE(cases); i++) {
+        fw->last_set = 0;
+        KUNIT_EXPECT_EQ(test, cases[i].attr->store(dev, cases[i].attr, "20", 2), 2);
+        KUNIT_EXPECT_EQ_MSG(test, fw->last_set, cases[i].devid, "%s",
+                            cases[i].attr->attr.name);
+    }
+}
+
+static bool armoury_test_visible(struct universal_armoury *armoury,
+                                 struct device_attribute *attr)
+{
+    return universal_armoury_attr_group.is_visible(&armoury->acpi_dev->dev.kobj,
+                                                   &attr->attr, 0);
+}
+
+/* Controls are offered while they may exist, and hidden once firmware says no */
+static void armoury_test_visibility(struct kunit *test)
+{
+    struct armoury_fake_fw *fw = test->priv;
+    struct universal_armoury *armoury;
+
+    fw->no_fan_curves = true;
+    fw->no_power = BIT(ARMOURY_POWER_FPPT);
+    fw->fail_method = ASUS_ACPI_GET_EGPU_ENABLE;
+    fw->fail_err = -EIO;
+    fw->no_bulk = true;
+    armoury = armoury_test_create(test);
+
+    KUNIT_EXPECT_TRUE(test, armoury_test_visible(armoury, &dev_attr_egpu_enable));
+    KUNIT_EXPECT_TRUE(test, armoury_test_visible(armoury, &dev_attr_cpu_fan_curve));
+    KUNIT_EXPECT_TRUE(test, armoury_test_visible(armoury, &dev_attr_fan_curve_reset));
+    KUNIT_EXPECT_TRUE(test, armoury_test_visible(armoury, &dev_attr_ppt_fppt_max));
+
+    universal_armoury_probe_features(armoury);
+
+    KUNIT_EXPECT_TRUE(test, armoury_test_visible(armoury, &dev_attr_gpu_mux));
+    KUNIT_EXPECT_FALSE(test, armoury_test_visible(armoury, &dev_attr_egpu_enable));
+    KUNIT_EXPECT_FALSE(test, armoury_test_visible(armoury, &dev_attr_cpu_fan_curve));
+    KUNIT_EXPECT_FALSE(test, armoury_test_visible(armoury, &dev_attr_fan_curve_reset));
+    KUNIT_EXPECT_TRUE(test, armoury_test_visible(armoury, &dev_attr_ppt_pl1_spl));
+    KUNIT_EXPECT_TRUE(test, armoury_test_visible(armoury, &dev_attr_nv_dynamic_boost_min));
+    KUNIT_EXPECT_FALSE(test, armoury_test_visible(armoury, &dev_attr_ppt_fppt));
+    KUNIT_EXPECT_FALSE(test, armoury_test_visible(armoury, &dev_attr_ppt_fppt_max));
+    KUNIT_EXPECT_TRUE(test, armoury_test_visible(armoury, &dev_attr_supported_features));
+}
+
+/* Vendors without BIOS settings methods never show their controls */
+static void armoury_test_visibility_vendor(struct kunit *test)
+{
+    struct armoury_fake_fw *fw = test->priv;
+    struct universal_armoury *armoury;
+
+    fw->desc = &armoury_vendor_msi;
+    armoury = armoury_test_create(test);
+
+    KUNIT_EXPECT_TRUE(test, armoury_test_visible(armoury, &dev_attr_gpu_mux));
+    KUNIT_EXPECT_FALSE(test, armoury_test_visible(armoury, &dev_attr_egpu_enable));
+    KUNIT_EXPECT_FALSE(test, armoury_test_visible(armoury, &dev_attr_gpu_fan_curve));
+    KUNIT_EXPECT_FALSE(test, armoury_test_visible(armoury, &dev_attr_ppt_pl2_sppt));
+    KUNIT_EXPECT_EQ(test, dev_attr_ppt_pl2_sppt.store(&armoury->acpi_dev->dev,
+                                                      &dev_attr_ppt_pl2_sppt, "50", 2),
+                    -ENODEV);
+}
+
+#ifdef ARMOURY_GOVERNOR
+/* Default policy: dGPU off on battery, the previous value back on AC */
+static void armoury_test_governor_round_trip(struct kunit *test)
+{
+    struct armoury_fake_fw *fw = test->priv;
+    struct universal_armoury *armoury;
+    int calls;
+
+    armoury = armoury_test_bind(test);
+    KUNIT_EXPECT_EQ(test, armoury->gov_policy, BIT(ARMOURY_STATE_DGPU_DISABLE));
+
+    /* The source found at registration is not a transition */
+    universal_armoury_governor_apply(armoury, ARMOURY_GOV_AC);
+    KUNIT_EXPECT_EQ(test, armoury->gov_transitions, 0);
+    KUNIT_EXPECT_EQ(test, armoury->gov_writes, 0);
+
+    universal_armoury_governor_apply(armoury, ARMOURY_GOV_BATTERY);
+    KUNIT_EXPECT_EQ(test, armoury_fake_reg(fw, ARMOURY_STATE_DGPU_DISABLE), 1);
+
+    /* Repeated events for the same source do nothing */
+    calls = atomic_read(&fw->calls);
+    universal_armoury_governor_apply(armoury, ARMOURY_GOV_BATTERY);
+    KUNIT_EXPECT_EQ(test, atomic_read(&fw->calls), calls);
+
+    universal_armoury_governor_apply(armoury, ARMOURY_GOV_AC);
+    KUNIT_EXPECT_EQ(test, armoury_fake_reg(fw, ARMOURY_STATE_DGPU_DISABLE), 0);
+    KUNIT_EXPECT_EQ(test, armoury->gov_transitions, 2);
+    KUNIT_EXPECT_EQ(test, armoury->gov_writes, 2);
+    KUNIT_EXPECT_EQ(test, armoury->gov_failures, 0);
+    KUNIT_EXPECT_EQ(test, armoury->gov_saved_mask, 0);
+}
+
+/* A state switched by hand on battery is left alone on AC */
+static void armoury_test_governor_manual_change(struct kunit *test)
+{
+    struct armoury_fake_fw *fw = test->priv;
+    struct universal_armoury *armoury;
+
+    armoury = armoury_test_bind(test);
+    universal_armoury_governor_apply(armoury, ARMOURY_GOV_AC);
+    universal_armoury_governor_apply(armoury, ARMOURY_GOV_BATTERY);
+    KUNIT_EXPECT_EQ(test, armoury_fake_reg(fw, ARMOURY_STATE_DGPU_DISABLE), 1);
+
+    KUNIT_EXPECT_EQ(test, armoury_test_store(armoury, ARMOURY_STATE_DGPU_DISABLE, "0"), 1);
+    KUNIT_EXPECT_EQ(test, armoury_test_store(armoury, ARMOURY_STATE_DGPU_DISABLE, "1"), 1);
+    KUNIT_EXPECT_EQ(test, armoury_test_store(armoury, ARMOURY_STATE_DGPU_DISABLE, "0"), 1);
+
+    universal_armoury_governor_apply(armoury, ARMOURY_GOV_AC);
+    KUNIT_EXPECT_EQ(test, armoury_fake_reg(fw, ARMOURY_STATE_DGPU_DISABLE), 0);
+    KUNIT_EXPECT_EQ(test, armoury->gov_writes, 1);
+
+    /* Also when the hand-picked value is the one the governor would restore */
+    universal_armoury_governor_apply(armoury, ARMOURY_GOV_BATTERY);
+    KUNIT_EXPECT_EQ(test, armoury_test_store(armoury, ARMOURY_STATE_DGPU_DISABLE, "0"), 1);
+    universal_armoury_governor_apply(armoury, ARMOURY_GOV_AC);
+    KUNIT_EXPECT_EQ(test, armoury_fake_reg(fw, ARMOURY_STATE_DGPU_DISABLE), 0);
+    KUNIT_EXPECT_EQ(test, armoury->gov_writes, 2);
+}
+
+/* The override lock holds back switching until it is lifted */
+static void armoury_test_governor_lock(struct kunit *test)
+{
+    struct armoury_fake_fw *fw = test->priv;
+    struct universal_armoury *armoury;
+    struct device *dev;
+
+    armoury = armoury_test_bind(test);
+    dev = &armoury->acpi_dev->dev;
+    universal_armoury_governor_apply(armoury, ARMOURY_GOV_AC);
+
+    KUNIT_EXPECT_EQ(test, dev_attr_governor_lock.store(dev, &dev_attr_governor_lock, "2", 1),
+                    -EINVAL);
+    KUNIT_EXPECT_EQ(test, dev_attr_governor_lock.store(dev, &dev_attr_governor_lock, "1\n", 2),
+                    2);
+    universal_armoury_governor_apply(armoury, ARMOURY_GOV_BATTERY);
+    KUNIT_EXPECT_EQ(test, armoury_fake_reg(fw, ARMOURY_STATE_DGPU_DISABLE), 0);
+    KUNIT_EXPECT_EQ(test, armoury->gov_skipped, 1);
+    KUNIT_EXPECT_EQ(test, armoury->gov_writes, 0);
+
+    KUNIT_EXPECT_EQ(test, dev_attr_governor_lock.store(dev, &dev_attr_governor_lock, "0", 1),
+                    1);
+    universal_armoury_governor_apply(armoury, ARMOURY_GOV_BATTERY);
+    KUNIT_EXPECT_EQ(test, armoury_fake_reg(fw, ARMOURY_STATE_DGPU_DISABLE), 1);
+    KUNIT_EXPECT_EQ(test, armoury->gov_transitions, 1);
+}
+
+/* Policies name supported states with in-range values */
+static void armoury_test_governor_policy(struct kunit *test)
+{
+    static const char * const bad[] = {
+        "foo:1", "dgpu_disable:2", "dgpu_disable", "dgpu_disable:x", "egpu_enable:1", "",
+    };
+    struct armoury_fake_fw *fw = test->priv;
+    struct universal_armoury *armoury;
+    struct device *dev;
+    char *buf = kunit_kzalloc(test, PAGE_SIZE, GFP_KERNEL);
+    const char *good = "gpu_mux:1  dgpu_disable:1\n";
+    int i;
+
+    KUNIT_ASSERT_NOT_NULL(test, buf);
+    fw->absent = BIT(ARMOURY_STATE_EGPU_ENABLE);
+    armoury = armoury_test_bind(test);
+    dev = &armoury->acpi_dev->dev;
+
+    KUNIT_EXPECT_EQ(test, dev_attr_governor_policy.store(dev, &dev_attr_governor_policy,
+                                                         good, strlen(good)), strlen(good));
+    KUNIT_EXPECT_GT(test, dev_attr_governor_policy.show(dev, &dev_attr_governor_policy, buf), 0);
+    KUNIT_EXPECT_STREQ(test, buf, "gpu_mux:1 dgpu_disable:1\n");
+
+    for (i = 0; i < ARRAY_SIZE(bad); i++)
+        KUNIT_EXPECT_EQ_MSG(test, dev_attr_governor_policy.store(dev, &dev_attr_governor_policy,
+                                                                 bad[i], strlen(bad[i])),
+                            -EINVAL, "\"%s\"", bad[i]);
+    KUNIT_EXPECT_EQ(test, armoury->gov_policy,
+                    BIT(ARMOURY_STATE_GPU_MUX) | BIT(ARMOURY_STATE_DGPU_DISABLE));
+
+    KUNIT_EXPECT_EQ(test, dev_attr_governor_policy.store(dev, &dev_attr_governor_policy,
+                                                         "none\n", 5), 5);
+    KUNIT_EXPECT_GT(test, dev_attr_governor_policy.show(dev, &dev_attr_governor_policy, buf), 0);
+    KUNIT_EXPECT_STREQ(test, buf, "none\n");
+
+    universal_armoury_governor_apply(armoury, ARMOURY_GOV_AC);
+    universal_armoury_governor_apply(armoury, ARMOURY_GOV_BATTERY);
+    KUNIT_EXPECT_EQ(test, armoury->gov_writes, 0);
+}
+
+/* The dGPU stays on while the MUX routes the panel through it */
+static void armoury_test_governor_mux_dgpu(struct kunit *test)
+{
+    struct armoury_fake_fw *fw = test->priv;
+    struct universal_armoury *armoury;
+
+    fw->regs[ARMOURY_STATE_GPU_MUX] = 1;
+    armoury = armoury_test_bind(test);
+    universal_armoury_governor_apply(armoury, ARMOURY_GOV_AC);
+    universal_armoury_governor_apply(armoury, ARMOURY_GOV_BATTERY);
+
+    KUNIT_EXPECT_EQ(test, armoury_fake_reg(fw, ARMOURY_STATE_DGPU_DISABLE), 0);
+    KUNIT_EXPECT_EQ(test, armoury->gov_mux_blocked, 1);
+    KUNIT_EXPECT_EQ(test, armoury->gov_writes, 0);
+    KUNIT_EXPECT_EQ(test, armoury->gov_failures, 0);
+    KUNIT_EXPECT_EQ(test, armoury->gov_saved_mask, 0);
+
+    /* Back on the iGPU the next battery switch goes ahead */
+    universal_armoury_governor_apply(armoury, ARMOURY_GOV_AC);
+    KUNIT_EXPECT_EQ(test, armoury_test_store(armoury, ARMOURY_STATE_GPU_MUX, "0"), 1);
+    universal_armoury_governor_apply(armoury, ARMOURY_GOV_BATTERY);
+    KUNIT_EXPECT_EQ(test, armoury_fake_reg(fw, ARMOURY_STATE_DGPU_DISABLE), 1);
+}
+#endif
+
+#ifdef ARMOURY_PLATFORM_PROFILE
+/* The thermal policy maps onto platform_profile choices both ways */
+static void armoury_test_profile_read(struct kunit *test)
+{
+    struct armoury_fake_fw *fw = test->priv;
+    struct universal_armoury *armoury;
+    int profile = -1, ret;
+
+    armoury = armoury_test_bind(test);
+    /* armoury_test_create() hides the profile from probe, read it directly */
+    armoury->desc = &armoury_vendor_asus;
+    fw->thermal_policy = ASUS_THERMAL_POLICY_SILENT;
+
+    mutex_lock(&armoury->lock);
+    ret = universal_armoury_profile_read(armoury, &profile);
+    mutex_unlock(&armoury->lock);
+    KUNIT_EXPECT_EQ(test, ret, 0);
+    KUNIT_EXPECT_EQ(test, profile, ARMOURY_PROFILE_LOW_POWER);
+
+    fw->thermal_policy = 0x7f;
+    mutex_lock(&armoury->lock);
+    ret = universal_armoury_profile_read(armoury, &profile);
+    mutex_unlock(&armoury->lock);
+    KUNIT_EXPECT_EQ(test, ret, -EPROTO);
+}
+#endif
+
+static int armoury_test_init(struct kunit *test)
+{
+    struct armoury_fake_fw *fw;
+    int i;
+
+    fw = kunit_kzalloc(test, sizeof(*fw), GFP_KERNEL);
+    if (!fw)
+        return -ENOMEM;
+
+    spin_lock_init(&fw->lock);
+    fw->desc = &armoury_vendor_asus;
+    for (i = 0; i < ARMOURY_FAN_COUNT; i++)
+        fw->fans[i] = armoury_test_fan_curve;
+    test->priv = fw;
+
+    fw->saved_cache_ttl_ms = cache_ttl_ms;
+    fw->saved_coalesce_ms = coalesce_ms;
+    fw->saved_async_writes = async_writes;
+    fw->saved_capcache = capcache;
+    cache_ttl_ms = 60000;
+    coalesce_ms = 0;
+    async_writes = false;
+    /* A record set without a match keeps the firmware loader out of it */
+    capcache = "#";
+
+    kunit_activate_static_stub(test, universal_armoury_acpi_evaluate_args,
+                               armoury_fake_evaluate_args);
+    kunit_activate_static_stub(test, universal_armoury_acpi_evaluate_buf,
+                               armoury_fake_evaluate_buf);
+    return 0;
+}
+
+static void armoury_test_exit(struct kunit *test)
+{
+    struct armoury_fake_fw *fw = test->priv;
+
+    cache_ttl_ms = fw->saved_cache_ttl_ms;
+    coalesce_ms = fw->saved_coalesce_ms;
+    async_writes = fw->saved_async_writes;
+    capcache = fw->saved_capcache;
+}
+
+static struct kunit_case armoury_test_cases[] = {
+    KUNIT_CASE_PARAM(armoury_test_probe_vendor, armoury_test_vendor_gen_params),
+    KUNIT_CASE_PARAM(armoury_test_show_store_vendor, armoury_test_vendor_gen_params),
+    KUNIT_CASE(armoury_test_probe_drops_failing_getter),
+    KUNIT_CASE(armoury_test_probe_absent_method),
+    KUNIT_CASE(armoury_test_probe_fallback_pairs),
+    KUNIT_CASE(armoury_test_bulk_read),
+    KUNIT_CASE(armoury_test_bulk_read_fallback),
+    KUNIT_CASE(armoury_test_show_cache_ttl),
+    KUNIT_CASE(armoury_test_store_validation),
+    KUNIT_CASE(armoury_test_store_skips_known_value),
+    KUNIT_CASE(armoury_test_store_setter_failure),
+    KUNIT_CASE(armoury_test_switch_out_of_order),
+    KUNIT_CASE(armoury_test_resume_resuspend),
+    KUNIT_CASE(armoury_test_fan_curve_round_trip),
+    KUNIT_CASE(armoury_test_fan_curve_validation),
+    KUNIT_CASE(armoury_test_fan_curve_reset),
+    KUNIT_CASE(armoury_test_fan_curve_unsupported),
+    KUNIT_CASE(armoury_test_capcache_hit),
+    KUNIT_CASE(armoury_test_capcache_old_record),
+    KUNIT_CASE(armoury_test_power_limit),
+    KUNIT_CASE(armoury_test_power_selectors),
+    KUNIT_CASE(armoury_test_visibility),
+    KUNIT_CASE(armoury_test_visibility_vendor),
+#ifdef ARMOURY_GOVERNOR
+    KUNIT_CASE(armoury_test_governor_round_trip),
+    KUNIT_CASE(armoury_test_governor_manual_change),
+    KUNIT_CASE(armoury_test_governor_lock),
+    KUNIT_CASE(armoury_test_governor_policy),
+    KUNIT_CASE(armoury_test_governor_mux_dgpu),
+#endif
+#ifdef ARMOURY_PLATFORM_PROFILE
+    KUNIT_CASE(armoury_test_profile_read),
+#endif
+    {}
+};
+
+static struct kunit_suite armoury_test_suite = {
+    .name = "universal-armoury",
+    .init = armoury_test_init,
+    .exit = armoury_test_exit,
+    .test_cases = armoury_test_cases,
+};
+
+/*
+ * Stress: readers and writers hammer the show/store paths of one device
+ * from separate threads while firmware calls take a few microseconds, and
+ * per-call latency percentiles are reported. Readers keep going until the
+ * writers are done, so every write invalidates a state someone is reading.
+ */
+#define ARMOURY_STRESS_READERS         4
+#define ARMOURY_STRESS_WRITERS         2
+#define ARMOURY_STRESS_OPS             2000     /* per writer, and samples kept per reader */
+#define ARMOURY_STRESS_FW_DELAY_US     5
+
+struct armoury_stress_thread {
+    struct kunit *test;
+    struct universal_armoury *armoury;
+    struct completion *start;
+    atomic_t *writers_left;
+    struct completion done;
+    enum armoury_state_id id;
+    bool writer;
+    char *buf;
+    u64 *lat_ns;                /* last ARMOURY_STRESS_OPS samples */
+    unsigned long ops;
+    int errors;
+    int bad_values;
+};
+
+static int armoury_stress_fn(void *data)
+{
+    struct armoury_stress_thread *t = data;
+    struct device *dev = &t->armoury->acpi_dev->dev;
+    struct device_attribute *attr = armoury_test_attrs[t->id];
+    unsigned long i;
+    ssize_t ret;
+    u64 start;
+
+    /* Firmware calls from this thread go to the test's fake as well */
+    current->kunit_test = t->test;
+    wait_for_completion(t->start);
+
+    for (i = 0; i < ARMOURY_STRESS_OPS || (!t->writer && atomic_read(t->writers_left)); i++) {
+        start = ktime_get_ns();
+        if (t->writer)
+            ret = attr->store(dev, attr, i & 1 ? "1" : "0", 1);
+        else
+            ret = attr->show(dev, attr, t->buf);
+        t->lat_ns[i % ARMOURY_STRESS_OPS] = ktime_get_ns() - start;
+
+        if (ret < 0)
+            t->errors++;
+        else if (!t->writer && strcmp(t->buf, "0\n") && strcmp(t->buf, "1\n"))
+            t->bad_values++;
+    }
+    t->ops = i;
+    if (t->writer)
+        atomic_dec(t->writers_left);
+
+    current->kunit_test = NULL;
+    kthread_complete_and_exit(&t->done, 0);
+}
+
+static int armoury_stress_cmp(const void *a, const void *b)
+{
+    u64 x = *(const u64 *)a, y = *(const u64 *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+/* Sort @n samples in place and report p50/p90/p99/p99.9/max */
+static void armoury_stress_report(struct kunit *test, const char *what,
+                                  u64 *samples, size_t n)
+{
+    sort(samples, n, sizeof(*samples), armoury_stress_cmp, NULL);
+    kunit_info(test, "%s: %zu calls, p50 %llu ns p90 %llu ns p99 %llu ns p99.9 %llu ns max %llu ns\n",
+               what, n, samples[(n - 1) * 500 / 1000], samples[(n - 1) * 900 / 1000],
+               samples[(n - 1) * 990 / 1000], samples[(n - 1) * 999 / 1000],
+               samples[n - 1]);
+}
+
+static void armoury_test_stress(struct kunit *test)
+{
+    const int nr_threads = ARMOURY_STRESS_READERS + ARMOURY_STRESS_WRITERS;
+    struct armoury_fake_fw *fw = test->priv;
+    struct armoury_stress_thread *threads, *t;
+    struct universal_armoury *armoury;
+    struct task_struct *task;
+    DECLARE_COMPLETION_ONSTACK(start);
+    atomic_t writers_left = ATOMIC_INIT(ARMOURY_STRESS_WRITERS);
+    unsigned long reads = 0;
+    u64 *lat;
+    int i, started;
+
+    fw->delay_us = ARMOURY_STRESS_FW_DELAY_US;
+    armoury = armoury_test_bind(test);
+
+    threads = kunit_kcalloc(test, nr_threads, sizeof(*threads), GFP_KERNEL);
+    lat = kunit_kcalloc(test, nr_threads * ARMOURY_STRESS_OPS, sizeof(*lat), GFP_KERNEL);
+    KUNIT_ASSERT_NOT_NULL(test, threads);
+    KUNIT_ASSERT_NOT_NULL(test, lat);
+
+    /* Writers first, so samples of each kind end up contiguous */
+    for (i = 0; i < nr_threads; i++) {
+        t = &threads[i];
+        t->test = test;
+        t->armoury = armoury;
+        t->start = &start;
+        t->writers_left = &writers_left;
+        init_completion(&t->done);
+        t->writer = i < ARMOURY_STRESS_WRITERS;
+        t->id = t->writer ? i : i % ARMOURY_STATE_COUNT;
+        t->lat_ns = &lat[i * ARMOURY_STRESS_OPS];
+        t->buf = kunit_kzalloc(test, PAGE_SIZE, GFP_KERNEL);
+        KUNIT_ASSERT_NOT_NULL(test, t->buf);
+    }
+
+    for (started = 0; started < nr_threads; started++) {
+        task = kthread_run(armoury_stress_fn, &threads[started], "armoury-stress/%d",
+                           started);
+        if (IS_ERR(task))
+            break;
+    }
+
+    /* Threads already running must be done with our stack before asserting */
+    complete_all(&start);
+    for (i = 0; i < started; i++)
+        wait_for_completion(&threads[i].done);
+    KUNIT_ASSERT_EQ(test, started, nr_threads);
+
+    for (i = 0; i < nr_threads; i++) {
+        KUNIT_EXPECT_EQ_MSG(test, threads[i].errors, 0, "thread %d", i);
+        KUNIT_EXPECT_EQ_MSG(test, threads[i].bad_values, 0, "thread %d", i);
+        if (!threads[i].writer)
+            reads += threads[i].ops;
+    }
+
+    armoury_stress_report(test, "store", lat, ARMOURY_STRESS_WRITERS * ARMOURY_STRESS_OPS);
+    armoury_stress_report(test, "show", &lat[ARMOURY_STRESS_WRITERS * ARMOURY_STRESS_OPS],
+                          ARMOURY_STRESS_READERS * ARMOURY_STRESS_OPS);
+    kunit_info(test, "%lu reads, cache hits %ld misses %ld, %d firmware calls\n",
+               reads, atomic_long_read(&armoury->cache_hits),
+               atomic_long_read(&armoury->cache_misses), atomic_read(&fw->calls));
+
+    /* Once quiet, the cache agrees with firmware */
+    cache_ttl_ms = 0;
+    for (i = 0; i < ARMOURY_STATE_COUNT; i++)
+        KUNIT_EXPECT_EQ(test, armoury_test_show(test, armoury, i), armoury_fake_reg(fw, i));
+}
+
+static struct kunit_case armoury_stress_cases[] = {
+    KUNIT_CASE_SLOW(armoury_test_stress),
+    {}
+};
+
+static struct kunit_suite armoury_stress_suite = {
+    .name = "universal-armoury-stress",
+    .init = armoury_test_init,
+    .exit = armoury_test_exit,
+    .test_cases = armoury_stress_cases,
+};
+
+kunit_test_suites(&armoury_test_suite, &armoury_stress_suite);
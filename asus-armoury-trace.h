@@ -0,0 +1,158 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Tracepoints for the Universal Laptop Armoury driver
+ *
+ * Copyright (C) 2025
+ */
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM universal_armoury
+
+#if !defined(_ASUS_ARMOURY_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _ASUS_ARMOURY_TRACE_H
+
+#include <linux/acpi.h>
+#include <linux/tracepoint.h>
+
+/* Method paths are 4 character ACPI name segments, attributes are short */
+#define ARMOURY_TRACE_METHOD_LEN       8
+#define ARMOURY_TRACE_ATTR_LEN         24
+
+/* First integer argument of a method call, 0 if there is none */
+#define ARMOURY_TRACE_ARG(input)                                        \
+    ((input) && (input)->count &&                                       \
+     (input)->pointer[0].type == ACPI_TYPE_INTEGER ?                    \
+     (input)->pointer[0].integer.value : 0)
+
+TRACE_EVENT(armoury_acpi_eval_enter,
+
+    TP_PROTO(const char *method, const struct acpi_object_list *input),
+
+    TP_ARGS(method, input),
+
+    TP_STRUCT__entry(
+        __array(char, method, ARMOURY_TRACE_METHOD_LEN)
+        __field(u64, arg)
+    ),
+
+    TP_fast_assign(
+        strscpy(__entry->method, method, ARMOURY_TRACE_METHOD_LEN);
+        __entry->arg = ARMOURY_TRACE_ARG(input);
+    ),
+
+    TP_printk("method=%s arg=0x%llx", __entry->method, __entry->arg)
+);
+
+TRACE_EVENT(armoury_acpi_eval_exit,
+
+    TP_PROTO(const char *method, const struct acpi_object_list *input,
+             const union acpi_object *result, acpi_status status, int ret,
+             u64 duration_ns),
+
+    TP_ARGS(method, input, result, status, ret, duration_ns),
+
+    TP_STRUCT__entry(
+        __array(char, method, ARMOURY_TRACE_METHOD_LEN)
+        __field(u64, arg)
+        __field(u64, result)
+        __field(u32, result_type)
+        __field(u32, status)
+        __field(int, ret)
+        __field(u64, duration_ns)
+    ),
+
+    TP_fast_assign(
+        strscpy(__entry->method, method, ARMOURY_TRACE_METHOD_LEN);
+        __entry->arg = ARMOURY_TRACE_ARG(input);
+        __entry->result = result && result->type == ACPI_TYPE_INTEGER ?
+                          result->integer.value : 0;
+        __entry->result_type = result ? result->type : 0;
+        __entry->status = status;
+        __entry->ret = ret;
+        __entry->duration_ns = duration_ns;
+    ),
+
+    TP_printk("method=%s arg=0x%llx result=0x%llx type=%u status=0x%x ret=%d duration_ns=%llu",
+              __entry->method, __entry->arg, __entry->result,
+              __entry->result_type, __entry->status, __entry->ret,
+              __entry->duration_ns)
+);
+
+TRACE_EVENT(armoury_attr_show_enter,
+
+    TP_PROTO(const char *attr),
+
+    TP_ARGS(attr),
+
+    TP_STRUCT__entry(
+        __array(char, attr, ARMOURY_TRACE_ATTR_LEN)
+    ),
+
+    TP_fast_assign(
+        strscpy(__entry->attr, attr, ARMOURY_TRACE_ATTR_LEN);
+    ),
+
+    TP_printk("attr=%s", __entry->attr)
+);
+
+TRACE_EVENT(armoury_attr_store_enter,
+
+    TP_PROTO(const char *attr, int value),
+
+    TP_ARGS(attr, value),
+
+    TP_STRUCT__entry(
+        __array(char, attr, ARMOURY_TRACE_ATTR_LEN)
+        __field(int, value)
+    ),
+
+    TP_fast_assign(
+        strscpy(__entry->attr, attr, ARMOURY_TRACE_ATTR_LEN);
+        __entry->value = value;
+    ),
+
+    TP_printk("attr=%s value=%d", __entry->attr, __entry->value)
+);
+
+DECLARE_EVENT_CLASS(armoury_attr_exit,
+
+    TP_PROTO(const char *attr, int value, int ret, u64 duration_ns),
+
+    TP_ARGS(attr, value, ret, duration_ns),
+
+    TP_STRUCT__entry(
+        __array(char, attr, ARMOURY_TRACE_ATTR_LEN)
+        __field(int, value)
+        __field(int, ret)
+        __field(u64, duration_ns)
+    ),
+
+    TP_fast_assign(
+        strscpy(__entry->attr, attr, ARMOURY_TRACE_ATTR_LEN);
+        __entry->value = value;
+        __entry->ret = ret;
+        __entry->duration_ns = duration_ns;
+    ),
+
+    TP_printk("attr=%s value=%d ret=%d duration_ns=%llu",
+              __entry->attr, __entry->value, __entry->ret, __entry->duration_ns)
+);
+
+DEFINE_EVENT(armoury_attr_exit, armoury_attr_show_exit,
+    TP_PROTO(const char *attr, int value, int ret, u64 duration_ns),
+    TP_ARGS(attr, value, ret, duration_ns)
+);
+
+DEFINE_EVENT(armoury_attr_exit, armoury_attr_store_exit,
+    TP_PROTO(const char *attr, int value, int ret, u64 duration_ns),
+    TP_ARGS(attr, value, ret, duration_ns)
+);
+
+#endif /* _ASUS_ARMOURY_TRACE_H */
+
+/* This part must be outside protection */
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE asus-armoury-trace
+#include <trace/define_trace.h>
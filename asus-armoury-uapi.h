@@ -0,0 +1,114 @@
+/* SPDX-License-Identifier: GPL-2.0 WITH Linux-syscall-note */
+/*
+ * Universal Laptop Armoury userspace ABI
+ *
+ * /dev/armoury takes the ioctls below. Structures only grow by adding new
+ * ioctl numbers; ARMOURY_IOC_VERSION reports the ABI revision the driver
+ * implements.
+ */
+
+#ifndef _UAPI_UNIVERSAL_ARMOURY_H
+#define _UAPI_UNIVERSAL_ARMOURY_H
+
+#include <linux/ioctl.h>
+#include <linux/types.h>
+
+#define ARMOURY_ABI_VERSION            1
+
+/* State indices for values[], updated_ns[] and the bit masks */
+#define ARMOURY_SNAP_GPU_MUX           0
+#define ARMOURY_SNAP_DGPU_DISABLE      1
+#define ARMOURY_SNAP_EGPU_ENABLE       2
+#define ARMOURY_SNAP_NR_STATES         3
+/* Room reserved in the structures for future states */
+#define ARMOURY_SNAP_MAX_STATES        8
+
+struct armoury_version {
+    __u32 abi_version;          /* ARMOURY_ABI_VERSION */
+    __u32 nr_states;            /* states implemented by the driver */
+    __u32 nr_devices;           /* bound devices; see their "instance" attribute */
+    __u32 reserved;
+};
+
+/*
+ * armoury_snapshot.flags: read firmware instead of trusting the cache. Needs
+ * the device open for writing or CAP_SYS_ADMIN.
+ */
+#define ARMOURY_SNAPSHOT_FRESH         (1U << 0)
+
+struct armoury_snapshot {
+    __u32 index;                /* in: device instance */
+    __u32 flags;                /* in: ARMOURY_SNAPSHOT_* */
+    __u32 supported;            /* out: bit per state the device provides */
+    __u32 valid;                /* out: bit per state with a value below */
+    __u64 generation;           /* out: bumped on every state change */
+    __u64 timestamp_ns;         /* out: CLOCK_MONOTONIC of the snapshot */
+    __u64 updated_ns[ARMOURY_SNAP_MAX_STATES]; /* out: last firmware read/write */
+    __s32 values[ARMOURY_SNAP_MAX_STATES];
+    char vendor_name[32];
+    char product_name[64];
+};
+
+/*
+ * Apply the states selected by mask together. Either all of them are
+ * committed or the driver restores the ones already written and fails.
+ */
+struct armoury_set {
+    __u32 index;                /* in: device instance */
+    __u32 flags;                /* in: must be 0 */
+    __u32 mask;                 /* in: bit per state to apply */
+    __u32 applied;              /* out: bits that needed a firmware call */
+    __s32 values[ARMOURY_SNAP_MAX_STATES];
+    __u64 generation;           /* out: generation after the update */
+};
+
+#define ARMOURY_IOC_MAGIC              0xA3
+
+#define ARMOURY_IOC_VERSION     _IOR(ARMOURY_IOC_MAGIC, 0x00, struct armoury_version)
+#define ARMOURY_IOC_SNAPSHOT    _IOWR(ARMOURY_IOC_MAGIC, 0x01, struct armoury_snapshot)
+#define ARMOURY_IOC_SET         _IOWR(ARMOURY_IOC_MAGIC, 0x02, struct armoury_set)
+
+/*
+ * Generic netlink family. Events are multicast on the "events" group; the
+ * family has no commands of its own.
+ */
+#define ARMOURY_GENL_NAME              "armoury"
+#define ARMOURY_GENL_VERSION           1
+#define ARMOURY_GENL_MCGRP_EVENTS      "events"
+
+enum armoury_genl_cmd {
+    ARMOURY_CMD_UNSPEC,
+    ARMOURY_CMD_STATE_CHANGE,   /* a state took a new value */
+    ARMOURY_CMD_SWITCH_DONE,    /* an asynchronous or coalesced write finished */
+    ARMOURY_CMD_PROBE,          /* a device was probed */
+    __ARMOURY_CMD_MAX,
+};
+#define ARMOURY_CMD_MAX                (__ARMOURY_CMD_MAX - 1)
+
+enum armoury_genl_attr {
+    ARMOURY_ATTR_UNSPEC,
+    ARMOURY_ATTR_PAD,
+    ARMOURY_ATTR_INDEX,         /* u32: device instance */
+    ARMOURY_ATTR_SOURCE,        /* u32: enum armoury_event_source */
+    ARMOURY_ATTR_LATENCY_NS,    /* u64: firmware call, switch or probe time */
+    ARMOURY_ATTR_STATE,         /* u32: ARMOURY_SNAP_* */
+    ARMOURY_ATTR_OLD_VALUE,     /* s32: absent if the old value was unknown */
+    ARMOURY_ATTR_NEW_VALUE,     /* s32 */
+    ARMOURY_ATTR_GENERATION,    /* u64: state generation after the change */
+    ARMOURY_ATTR_SWITCH_GEN,    /* u64: switch_status generation */
+    ARMOURY_ATTR_ERRNO,         /* s32: 0 or negative errno */
+    ARMOURY_ATTR_SUPPORTED,     /* u32: bit per supported state */
+    __ARMOURY_ATTR_MAX,
+};
+#define ARMOURY_ATTR_MAX               (__ARMOURY_ATTR_MAX - 1)
+
+enum armoury_event_source {
+    ARMOURY_SRC_FIRMWARE,       /* notify event or a read found a new value */
+    ARMOURY_SRC_USER,           /* synchronous sysfs or ioctl write */
+    ARMOURY_SRC_RESUME,         /* state restored after resume */
+    ARMOURY_SRC_PROBE,          /* initial read at probe */
+    ARMOURY_SRC_ASYNC,          /* queued or coalesced write */
+    ARMOURY_SRC_GOVERNOR,       /* switched by the AC/battery governor */
+};
+
+#endif /* _UAPI_UNIVERSAL_ARMOURY_H */
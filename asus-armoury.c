@@ -15,8 +15,38 @@
 #include <linux/kernel.h>
 #include <linux/init.h>
 #include <linux/acpi.h>
+#include <linux/bitops.h>
+#include <linux/capability.h>
+#include <linux/completion.h>
+#include <linux/debugfs.h>
 #include <linux/dmi.h>
+#include <linux/firmware.h>
+#include <linux/fs.h>
+#include <linux/idr.h>
+#include <linux/jiffies.h>
+#include <linux/kref.h>
+#include <linux/list.h>
+#include <linux/math64.h>
+#include <linux/miscdevice.h>
+#include <linux/mutex.h>
+#include <linux/notifier.h>
+#include <linux/pci.h>
+#include <linux/pm.h>
+#include <linux/pm_runtime.h>
+#include <linux/seq_file.h>
+#include <linux/seqlock.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+#include <linux/timekeeping.h>
+#include <linux/uaccess.h>
 #include <linux/version.h>
+#include <linux/workqueue.h>
+#include <net/genetlink.h>
+
+#include "asus-armoury-uapi.h"
+
+#define CREATE_TRACE_POINTS
+#include "asus-armoury-trace.h"
 
 /* Ensure compatibility with older kernels */
 #if LINUX_VERSION_CODE < KERNEL_VERSION(5, 4, 0)
@@ -28,9 +58,63 @@
 #define strscpy(dest, src, size) strlcpy(dest, src, size)
 #endif
 
+/* platform_profile class devices with ops and drvdata appeared in 6.14 */
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 14, 0) && IS_REACHABLE(CONFIG_ACPI_PLATFORM_PROFILE)
+#include <linux/platform_profile.h>
+#define ARMOURY_PLATFORM_PROFILE
+#endif
+
+/* The GPU governor follows AC/battery changes through power_supply */
+#if IS_REACHABLE(CONFIG_POWER_SUPPLY)
+#include <linux/power_supply.h>
+#define ARMOURY_GOVERNOR
+#endif
+
+/* The KUnit suite swaps the firmware call for a fake, see asus-armoury-test.c */
+#if IS_ENABLED(CONFIG_UNIVERSAL_ARMOURY_KUNIT_TEST)
+#include <kunit/static_stub.h>
+#elif !defined(KUNIT_STATIC_STUB_REDIRECT)
+#define KUNIT_STATIC_STUB_REDIRECT(real_fn_name, args...) do { } while (0)
+#endif
+
 #define DRIVER_NAME "universal-armoury"
 #define DRIVER_VERSION "2.0.0"
 
+/* State cache freshness window, 0 disables caching */
+static unsigned int cache_ttl_ms = 2000;
+module_param(cache_ttl_ms, uint, 0644);
+MODULE_PARM_DESC(cache_ttl_ms, "Freshness window for cached GPU states in milliseconds (0 = always query firmware)");
+
+/* Queue slow firmware setters instead of running them in the writer */
+static bool async_writes;
+module_param(async_writes, bool, 0644);
+MODULE_PARM_DESC(async_writes, "Apply gpu_mux/dgpu_disable/egpu_enable writes asynchronously, report via switch_status");
+
+/* Move the first firmware reads out of the bind path */
+static bool deferred_probe = true;
+module_param(deferred_probe, bool, 0444);
+MODULE_PARM_DESC(deferred_probe, "Probe features from a work item or on first use instead of during bind");
+
+/* Capabilities validated on a previous boot, skips the probe reads */
+#define ARMOURY_CAPCACHE_FW "universal-armoury/capcache.txt"
+static char *capcache;
+module_param(capcache, charp, 0444);
+MODULE_PARM_DESC(capcache, "Capability cache records as exported in debugfs capcache, separated by ';' (default: firmware file " ARMOURY_CAPCACHE_FW ")");
+
+/* Collapse bursts of writes to the same state into one firmware call */
+static unsigned int coalesce_ms;
+module_param(coalesce_ms, uint, 0644);
+MODULE_PARM_DESC(coalesce_ms, "Window in milliseconds in which repeated writes collapse to the last value (0 = off)");
+
+/* Switch GPU states on AC/battery changes without a userspace daemon */
+static bool gpu_governor;
+MODULE_PARM_DESC(gpu_governor, "Apply governor_policy on battery and restore the replaced states on AC");
+
+/* Hysteresis: a flapping plug is acted on only once it settles */
+static unsigned int governor_delay_ms = 3000;
+module_param(governor_delay_ms, uint, 0644);
+MODULE_PARM_DESC(governor_delay_ms, "Time in milliseconds the power source must stay unchanged before the governor acts");
+
 /* ACPI method names - ASUS */
 #define ASUS_ACPI_GET_BIOS_SETTINGS    "GBMD"
 #define ASUS_ACPI_SET_BIOS_SETTINGS    "SBMD"
@@ -43,6 +127,26 @@
 #define ASUS_ACPI_GET_GPU_STATE        "GPUS"
 #define ASUS_ACPI_SET_GPU_STATE        "SGPU"
 
+/* DSTS-style GBMD status: the setting exists */
+#define ASUS_BIOS_DSTS_PRESENCE        BIT(16)
+
+/* GBMD/SBMD selector of the throttle thermal policy */
+#define ASUS_BIOS_THERMAL_POLICY       0x00120075
+#define ASUS_BIOS_VALUE_MASK           GENMASK(7, 0)
+#define ASUS_THERMAL_POLICY_DEFAULT    0
+#define ASUS_THERMAL_POLICY_OVERBOOST  1
+#define ASUS_THERMAL_POLICY_SILENT     2
+
+/* GBMD/SBMD selectors of the custom fan curves */
+#define ASUS_BIOS_FAN_CURVE_CPU        0x00110024
+#define ASUS_BIOS_FAN_CURVE_GPU        0x00110025
+
+/* GBMD/SBMD selectors of the package power limits, in watts (asus-wmi devids) */
+#define ASUS_BIOS_PPT_PL1_SPL          0x001200A3
+#define ASUS_BIOS_PPT_PL2_SPPT         0x001200A0
+#define ASUS_BIOS_PPT_FPPT             0x001200C1
+#define ASUS_BIOS_NV_DYN_BOOST         0x001200C0
+
 /* ACPI method names - MSI */
 #define MSI_ACPI_GET_GPU_MUX_STATE     "GMUX"
 #define MSI_ACPI_SET_GPU_MUX_STATE     "SMUX"
@@ -99,124 +203,445 @@ static const struct acpi_device_id universal_armoury_device_ids[] = {
 };
 MODULE_DEVICE_TABLE(acpi, universal_armoury_device_ids);
 
-/* DMI matching for supported systems - Expanded */
-static const struct dmi_system_id universal_armoury_quirks[] = {
-    /* ASUS systems */
-    {
-        .matches = {
-            DMI_MATCH(DMI_SYS_VENDOR, "ASUSTeK COMPUTER INC."),
-        },
-    },
-    {
-        .matches = {
-            DMI_MATCH(DMI_SYS_VENDOR, "ASUS"),
-        },
-    },
-    /* MSI systems */
-    {
-        .matches = {
-            DMI_MATCH(DMI_SYS_VENDOR, "Micro-Star International Co., Ltd."),
-        },
-    },
-    {
-        .matches = {
-            DMI_MATCH(DMI_SYS_VENDOR, "MSI"),
-        },
-    },
-    /* Dell/Alienware systems */
-    {
-        .matches = {
-            DMI_MATCH(DMI_SYS_VENDOR, "Dell Inc."),
-        },
-    },
-    {
-        .matches = {
-            DMI_MATCH(DMI_SYS_VENDOR, "Alienware"),
-        },
+/* Laptop vendor types */
+enum laptop_vendor {
+    VENDOR_UNKNOWN = 0,
+    VENDOR_ASUS,
+    VENDOR_MSI,
+    VENDOR_DELL_ALIENWARE,
+    VENDOR_LENOVO,
+    VENDOR_HP,
+    VENDOR_ACER,
+    VENDOR_GENERIC
+};
+
+/* Cached GPU states */
+enum armoury_state_id {
+    ARMOURY_STATE_GPU_MUX = 0,
+    ARMOURY_STATE_DGPU_DISABLE,
+    ARMOURY_STATE_EGPU_ENABLE,
+    ARMOURY_STATE_COUNT
+};
+
+/* Vendor feature mask bits */
+#define ARMOURY_FEAT_GPU_MUX           BIT(ARMOURY_STATE_GPU_MUX)
+#define ARMOURY_FEAT_DGPU_DISABLE      BIT(ARMOURY_STATE_DGPU_DISABLE)
+#define ARMOURY_FEAT_EGPU_ENABLE       BIT(ARMOURY_STATE_EGPU_ENABLE)
+
+/* Performance modes, offered through platform_profile */
+enum armoury_profile {
+    ARMOURY_PROFILE_LOW_POWER = 0,
+    ARMOURY_PROFILE_BALANCED,
+    ARMOURY_PROFILE_PERFORMANCE,
+    ARMOURY_PROFILE_COUNT
+};
+
+/* Power source the GPU governor last acted on */
+enum armoury_gov_source {
+    ARMOURY_GOV_UNKNOWN = -1,
+    ARMOURY_GOV_BATTERY,
+    ARMOURY_GOV_AC,
+};
+
+/* Fans taking a custom curve */
+enum armoury_fan {
+    ARMOURY_FAN_CPU = 0,
+    ARMOURY_FAN_GPU,
+    ARMOURY_FAN_COUNT
+};
+
+#define ARMOURY_FAN_CURVE_POINTS       8
+#define ARMOURY_FAN_TEMP_MAX           110      /* degrees C */
+#define ARMOURY_FAN_DUTY_MAX           100      /* percent */
+
+/* Fan curve, as read from firmware: all temperatures, then all duties */
+struct armoury_fan_curve {
+    u8 temp[ARMOURY_FAN_CURVE_POINTS];          /* strictly increasing */
+    u8 duty[ARMOURY_FAN_CURVE_POINTS];          /* non-decreasing */
+};
+
+/* Fan curves reached through the BIOS settings methods */
+struct armoury_fan_curve_desc {
+    u32 settings[ARMOURY_FAN_COUNT];            /* selector per fan, 0 if none */
+};
+
+/* Package power limits and dGPU boost */
+enum armoury_power_id {
+    ARMOURY_POWER_PL1_SPL = 0,  /* sustained CPU package power */
+    ARMOURY_POWER_PL2_SPPT,     /* slow CPU package power */
+    ARMOURY_POWER_FPPT,         /* fast CPU package power */
+    ARMOURY_POWER_DYN_BOOST,    /* power shifted to the dGPU */
+    ARMOURY_POWER_COUNT
+};
+
+/* Thermal policy reached through the BIOS settings methods */
+struct armoury_profile_desc {
+    u32 setting;                /* selector passed to the get/set methods */
+    u32 presence;               /* status bit set when the setting exists */
+    u32 value_mask;             /* status bits holding the current value */
+    u32 values[ARMOURY_PROFILE_COUNT];
+};
+
+/* Accepted range for values written to a state */
+struct armoury_value_range {
+    int min;
+    int max;
+};
+
+/* Power limits reached through the BIOS settings methods */
+struct armoury_power_desc {
+    u32 settings[ARMOURY_POWER_COUNT];          /* selector per limit, 0 if none */
+    struct armoury_value_range ranges[ARMOURY_POWER_COUNT];     /* watts */
+    u32 presence;               /* status bit set when the setting exists */
+    u32 value_mask;             /* status bits holding the current value */
+};
+
+struct universal_armoury;
+
+/* All GPU states at once, as exchanged with bulk vendor hooks */
+struct armoury_state_snapshot {
+    int values[ARMOURY_STATE_COUNT];
+    unsigned long valid;        /* BIT(id) for each state present in values */
+};
+
+/*
+ * Optional vendor hooks. read_all fetches every state in one firmware round
+ * trip; when absent or failing, the per-method getters are used. Only for
+ * layouts confirmed on hardware: its answer feeds the write short-circuit
+ * and the resume restore. Called with armoury->lock held.
+ */
+struct armoury_vendor_ops {
+    int (*read_all)(struct universal_armoury *armoury,
+                    struct armoury_state_snapshot *snap);
+};
+
+/* Per-vendor description, attached to DMI matches as driver_data */
+struct armoury_vendor_desc {
+    enum laptop_vendor vendor;
+    const char *name;
+    unsigned long features;     /* ARMOURY_FEAT_* the firmware may provide */
+    const char *get_methods[ARMOURY_STATE_COUNT];
+    const char *set_methods[ARMOURY_STATE_COUNT];
+    struct armoury_value_range ranges[ARMOURY_STATE_COUNT];
+    /* BIOS settings methods, if the firmware has them */
+    const char *bios_get_method;
+    const char *bios_set_method;
+    const struct armoury_profile_desc *profile;
+    const struct armoury_fan_curve_desc *fan_curves;
+    const struct armoury_power_desc *power;
+    const struct armoury_vendor_ops *ops;
+};
+
+/* Every GPU state is a 0/1 switch on the vendors known so far */
+#define ARMOURY_SWITCH_RANGES                                           \
+    {                                                                   \
+        [ARMOURY_STATE_GPU_MUX] = { 0, 1 },                             \
+        [ARMOURY_STATE_DGPU_DISABLE] = { 0, 1 },                        \
+        [ARMOURY_STATE_EGPU_ENABLE] = { 0, 1 },                         \
+    }
+
+static const struct armoury_profile_desc asus_armoury_profile = {
+    .setting = ASUS_BIOS_THERMAL_POLICY,
+    .presence = ASUS_BIOS_DSTS_PRESENCE,
+    .value_mask = ASUS_BIOS_VALUE_MASK,
+    .values = {
+        [ARMOURY_PROFILE_LOW_POWER] = ASUS_THERMAL_POLICY_SILENT,
+        [ARMOURY_PROFILE_BALANCED] = ASUS_THERMAL_POLICY_DEFAULT,
+        [ARMOURY_PROFILE_PERFORMANCE] = ASUS_THERMAL_POLICY_OVERBOOST,
     },
-    /* Lenovo systems */
-    {
-        .matches = {
-            DMI_MATCH(DMI_SYS_VENDOR, "LENOVO"),
-        },
+};
+
+static const struct armoury_fan_curve_desc asus_armoury_fan_curves = {
+    .settings = {
+        [ARMOURY_FAN_CPU] = ASUS_BIOS_FAN_CURVE_CPU,
+        [ARMOURY_FAN_GPU] = ASUS_BIOS_FAN_CURVE_GPU,
     },
-    {
-        .matches = {
-            DMI_MATCH(DMI_SYS_VENDOR, "Lenovo"),
-        },
+};
+
+/* Widest limits across ROG and TUF models; firmware clamps to the SKU */
+static const struct armoury_power_desc asus_armoury_power = {
+    .settings = {
+        [ARMOURY_POWER_PL1_SPL] = ASUS_BIOS_PPT_PL1_SPL,
+        [ARMOURY_POWER_PL2_SPPT] = ASUS_BIOS_PPT_PL2_SPPT,
+        [ARMOURY_POWER_FPPT] = ASUS_BIOS_PPT_FPPT,
+        [ARMOURY_POWER_DYN_BOOST] = ASUS_BIOS_NV_DYN_BOOST,
     },
-    /* HP systems */
-    {
-        .matches = {
-            DMI_MATCH(DMI_SYS_VENDOR, "HP"),
-        },
+    .ranges = {
+        [ARMOURY_POWER_PL1_SPL] = { 5, 135 },
+        [ARMOURY_POWER_PL2_SPPT] = { 5, 175 },
+        [ARMOURY_POWER_FPPT] = { 5, 200 },
+        [ARMOURY_POWER_DYN_BOOST] = { 5, 25 },
     },
-    {
-        .matches = {
-            DMI_MATCH(DMI_SYS_VENDOR, "Hewlett-Packard"),
-        },
+    .presence = ASUS_BIOS_DSTS_PRESENCE,
+    .value_mask = ASUS_BIOS_VALUE_MASK,
+};
+
+static const struct armoury_vendor_desc armoury_vendor_asus = {
+    .vendor = VENDOR_ASUS,
+    .name = "ASUS",
+    .features = ARMOURY_FEAT_GPU_MUX | ARMOURY_FEAT_DGPU_DISABLE | ARMOURY_FEAT_EGPU_ENABLE,
+    .get_methods = {
+        [ARMOURY_STATE_GPU_MUX] = ASUS_ACPI_GET_GPU_MUX_STATE,
+        [ARMOURY_STATE_DGPU_DISABLE] = ASUS_ACPI_GET_DGPU_DISABLE,
+        [ARMOURY_STATE_EGPU_ENABLE] = ASUS_ACPI_GET_EGPU_ENABLE,
     },
-    /* Acer systems */
-    {
-        .matches = {
-            DMI_MATCH(DMI_SYS_VENDOR, "Acer"),
-        },
+    .set_methods = {
+        [ARMOURY_STATE_GPU_MUX] = ASUS_ACPI_SET_GPU_MUX_STATE,
+        [ARMOURY_STATE_DGPU_DISABLE] = ASUS_ACPI_SET_DGPU_DISABLE,
+        [ARMOURY_STATE_EGPU_ENABLE] = ASUS_ACPI_SET_EGPU_ENABLE,
     },
-    /* Generic gaming laptop indicators */
-    {
-        .matches = {
-            DMI_MATCH(DMI_PRODUCT_NAME, "ROG"),
-        },
+    .ranges = ARMOURY_SWITCH_RANGES,
+    .bios_get_method = ASUS_ACPI_GET_BIOS_SETTINGS,
+    .bios_set_method = ASUS_ACPI_SET_BIOS_SETTINGS,
+    .profile = &asus_armoury_profile,
+    .fan_curves = &asus_armoury_fan_curves,
+    .power = &asus_armoury_power,
+};
+
+/* eGPU control is not commonly supported outside ASUS */
+static const struct armoury_vendor_desc armoury_vendor_msi = {
+    .vendor = VENDOR_MSI,
+    .name = "MSI",
+    .features = ARMOURY_FEAT_GPU_MUX | ARMOURY_FEAT_DGPU_DISABLE,
+    .get_methods = {
+        [ARMOURY_STATE_GPU_MUX] = MSI_ACPI_GET_GPU_MUX_STATE,
+        [ARMOURY_STATE_DGPU_DISABLE] = MSI_ACPI_GET_DGPU_DISABLE,
     },
-    {
-        .matches = {
-            DMI_MATCH(DMI_PRODUCT_NAME, "TUF"),
-        },
+    .set_methods = {
+        [ARMOURY_STATE_GPU_MUX] = MSI_ACPI_SET_GPU_MUX_STATE,
+        [ARMOURY_STATE_DGPU_DISABLE] = MSI_ACPI_SET_DGPU_DISABLE,
     },
-    {
-        .matches = {
-            DMI_MATCH(DMI_PRODUCT_NAME, "Legion"),
-        },
+    .ranges = ARMOURY_SWITCH_RANGES,
+};
+
+static const struct armoury_vendor_desc armoury_vendor_dell = {
+    .vendor = VENDOR_DELL_ALIENWARE,
+    .name = "Dell/Alienware",
+    .features = ARMOURY_FEAT_GPU_MUX | ARMOURY_FEAT_DGPU_DISABLE,
+    .get_methods = {
+        [ARMOURY_STATE_GPU_MUX] = DELL_ACPI_GET_GPU_MUX_STATE,
+        [ARMOURY_STATE_DGPU_DISABLE] = DELL_ACPI_GET_DGPU_DISABLE,
     },
-    {
-        .matches = {
-            DMI_MATCH(DMI_PRODUCT_NAME, "Gaming"),
-        },
+    .set_methods = {
+        [ARMOURY_STATE_GPU_MUX] = DELL_ACPI_SET_GPU_MUX_STATE,
+        [ARMOURY_STATE_DGPU_DISABLE] = DELL_ACPI_SET_DGPU_DISABLE,
     },
-    {
-        .matches = {
-            DMI_MATCH(DMI_PRODUCT_NAME, "Predator"),
-        },
+    .ranges = ARMOURY_SWITCH_RANGES,
+};
+
+static const struct armoury_vendor_desc armoury_vendor_lenovo = {
+    .vendor = VENDOR_LENOVO,
+    .name = "Lenovo",
+    .features = ARMOURY_FEAT_GPU_MUX | ARMOURY_FEAT_DGPU_DISABLE,
+    .get_methods = {
+        [ARMOURY_STATE_GPU_MUX] = LENOVO_ACPI_GET_GPU_MUX_STATE,
+        [ARMOURY_STATE_DGPU_DISABLE] = LENOVO_ACPI_GET_DGPU_DISABLE,
     },
-    {
-        .matches = {
-            DMI_MATCH(DMI_PRODUCT_NAME, "Nitro"),
-        },
+    .set_methods = {
+        [ARMOURY_STATE_GPU_MUX] = LENOVO_ACPI_SET_GPU_MUX_STATE,
+        [ARMOURY_STATE_DGPU_DISABLE] = LENOVO_ACPI_SET_DGPU_DISABLE,
     },
+    .ranges = ARMOURY_SWITCH_RANGES,
+};
+
+/* HP, Acer and unidentified machines use the generic methods */
+#define ARMOURY_GENERIC_VENDOR(_vendor, _name)                          \
+    {                                                                   \
+        .vendor = _vendor,                                              \
+        .name = _name,                                                  \
+        .features = ARMOURY_FEAT_GPU_MUX | ARMOURY_FEAT_DGPU_DISABLE,   \
+        .get_methods = {                                                \
+            [ARMOURY_STATE_GPU_MUX] = GENERIC_ACPI_GET_MUX_STATE,       \
+            [ARMOURY_STATE_DGPU_DISABLE] = GENERIC_ACPI_GET_GPU_STATE,  \
+        },                                                              \
+        .set_methods = {                                                \
+            [ARMOURY_STATE_GPU_MUX] = GENERIC_ACPI_SET_MUX_STATE,       \
+            [ARMOURY_STATE_DGPU_DISABLE] = GENERIC_ACPI_SET_GPU_STATE,  \
+        },                                                              \
+        .ranges = ARMOURY_SWITCH_RANGES,                                \
+    }
+
+static const struct armoury_vendor_desc armoury_vendor_hp =
+    ARMOURY_GENERIC_VENDOR(VENDOR_HP, "HP");
+static const struct armoury_vendor_desc armoury_vendor_acer =
+    ARMOURY_GENERIC_VENDOR(VENDOR_ACER, "Acer");
+static const struct armoury_vendor_desc armoury_vendor_generic =
+    ARMOURY_GENERIC_VENDOR(VENDOR_GENERIC, "Generic Gaming Laptop");
+static const struct armoury_vendor_desc armoury_vendor_unknown =
+    ARMOURY_GENERIC_VENDOR(VENDOR_UNKNOWN, "Unknown");
+
+#define ARMOURY_DMI_VENDOR(_field, _match, _desc)                       \
+    {                                                                   \
+        .matches = {                                                    \
+            DMI_MATCH(_field, _match),                                  \
+        },                                                              \
+        .driver_data = (void *)&(_desc),                                \
+    }
+
+/*
+ * Supported systems, resolved with a single dmi_first_match(). DMI_MATCH is a
+ * substring match, so order matters: vendor strings first, then product names
+ * of gaming lines from otherwise unknown vendors.
+ */
+static const struct dmi_system_id universal_armoury_vendor_table[] = {
+    ARMOURY_DMI_VENDOR(DMI_SYS_VENDOR, "ASUS", armoury_vendor_asus),
+    ARMOURY_DMI_VENDOR(DMI_SYS_VENDOR, "MSI", armoury_vendor_msi),
+    ARMOURY_DMI_VENDOR(DMI_SYS_VENDOR, "Micro-Star", armoury_vendor_msi),
+    ARMOURY_DMI_VENDOR(DMI_SYS_VENDOR, "Dell", armoury_vendor_dell),
+    ARMOURY_DMI_VENDOR(DMI_SYS_VENDOR, "Alienware", armoury_vendor_dell),
+    ARMOURY_DMI_VENDOR(DMI_SYS_VENDOR, "LENOVO", armoury_vendor_lenovo),
+    ARMOURY_DMI_VENDOR(DMI_SYS_VENDOR, "Lenovo", armoury_vendor_lenovo),
+    ARMOURY_DMI_VENDOR(DMI_SYS_VENDOR, "HP", armoury_vendor_hp),
+    ARMOURY_DMI_VENDOR(DMI_SYS_VENDOR, "Hewlett-Packard", armoury_vendor_hp),
+    ARMOURY_DMI_VENDOR(DMI_SYS_VENDOR, "Acer", armoury_vendor_acer),
+    /* Generic gaming laptop indicators */
+    ARMOURY_DMI_VENDOR(DMI_PRODUCT_NAME, "ROG", armoury_vendor_generic),
+    ARMOURY_DMI_VENDOR(DMI_PRODUCT_NAME, "TUF", armoury_vendor_generic),
+    ARMOURY_DMI_VENDOR(DMI_PRODUCT_NAME, "Legion", armoury_vendor_generic),
+    ARMOURY_DMI_VENDOR(DMI_PRODUCT_NAME, "Gaming", armoury_vendor_generic),
+    ARMOURY_DMI_VENDOR(DMI_PRODUCT_NAME, "Predator", armoury_vendor_generic),
+    ARMOURY_DMI_VENDOR(DMI_PRODUCT_NAME, "Nitro", armoury_vendor_generic),
     {}
 };
 
-/* Laptop vendor types */
-enum laptop_vendor {
-    VENDOR_UNKNOWN = 0,
-    VENDOR_ASUS,
-    VENDOR_MSI,
-    VENDOR_DELL_ALIENWARE,
-    VENDOR_LENOVO,
-    VENDOR_HP,
-    VENDOR_ACER,
-    VENDOR_GENERIC
+/*
+ * Every getter/setter pair known across vendors. Devices are matched against
+ * this table by one namespace walk that never runs a method. id is the state
+ * a pair controls, or -1 for auxiliary methods.
+ */
+struct armoury_cap_pair {
+    const char *label;
+    int id;
+    const char *get;
+    const char *set;
+};
+
+static const struct armoury_cap_pair universal_armoury_cap_pairs[] = {
+    { "gpu_mux", ARMOURY_STATE_GPU_MUX,
+      ASUS_ACPI_GET_GPU_MUX_STATE, ASUS_ACPI_SET_GPU_MUX_STATE },
+    { "gpu_mux", ARMOURY_STATE_GPU_MUX,
+      GENERIC_ACPI_GET_MUX_STATE, GENERIC_ACPI_SET_MUX_STATE },
+    { "gpu_mux", ARMOURY_STATE_GPU_MUX,
+      DELL_ACPI_GET_GPU_MUX_STATE, DELL_ACPI_SET_GPU_MUX_STATE },
+    { "gpu_mux", ARMOURY_STATE_GPU_MUX,
+      LENOVO_ACPI_GET_GPU_MUX_STATE, LENOVO_ACPI_SET_GPU_MUX_STATE },
+    { "dgpu_disable", ARMOURY_STATE_DGPU_DISABLE,
+      ASUS_ACPI_GET_DGPU_DISABLE, ASUS_ACPI_SET_DGPU_DISABLE },
+    { "dgpu_disable", ARMOURY_STATE_DGPU_DISABLE,
+      MSI_ACPI_GET_DGPU_DISABLE, MSI_ACPI_SET_DGPU_DISABLE },
+    { "dgpu_disable", ARMOURY_STATE_DGPU_DISABLE,
+      DELL_ACPI_GET_DGPU_DISABLE, DELL_ACPI_SET_DGPU_DISABLE },
+    { "dgpu_disable", ARMOURY_STATE_DGPU_DISABLE,
+      LENOVO_ACPI_GET_DGPU_DISABLE, LENOVO_ACPI_SET_DGPU_DISABLE },
+    { "dgpu_disable", ARMOURY_STATE_DGPU_DISABLE,
+      GENERIC_ACPI_GET_GPU_STATE, GENERIC_ACPI_SET_GPU_STATE },
+    { "egpu_enable", ARMOURY_STATE_EGPU_ENABLE,
+      ASUS_ACPI_GET_EGPU_ENABLE, ASUS_ACPI_SET_EGPU_ENABLE },
+    { "gpu_state", -1, ASUS_ACPI_GET_GPU_STATE, ASUS_ACPI_SET_GPU_STATE },
+    { "bios_settings", -1, ASUS_ACPI_GET_BIOS_SETTINGS, ASUS_ACPI_SET_BIOS_SETTINGS },
+};
+
+#define ARMOURY_NR_CAP_PAIRS           ((int)ARRAY_SIZE(universal_armoury_cap_pairs))
+
+/* Presence and argument count of one pair under a device */
+struct armoury_capability {
+    acpi_handle get_handle;
+    acpi_handle set_handle;
+    u8 get_args;
+    u8 set_args;
+};
+
+/* Outstanding switch, linked on switch_inflight in generation order */
+struct armoury_switch_track {
+    struct list_head node;
+    u64 gen;                    /* oldest generation not yet completed */
 };
 
+/* Queued asynchronous setter call, on switch_reqs */
+struct armoury_switch_req {
+    struct list_head node;
+    struct armoury_switch_track track;
+    enum armoury_state_id id;
+    int value;
+    u64 gen;
+    u64 queued_ns;
+};
+
+struct armoury_state_cache {
+    unsigned long updated;      /* jiffies of the last firmware read or write */
+    u64 updated_ns;             /* same, as CLOCK_MONOTONIC for userspace */
+    bool valid;                 /* reads may be served from cache */
+    bool known;                 /* firmware holds the stored value */
+    bool seen;                  /* a value has been stored at least once */
+};
+
+/* Write waiting for the coalescing window to close */
+struct armoury_pending_write {
+    struct delayed_work work;
+    struct universal_armoury *armoury;
+    enum armoury_state_id id;
+    struct armoury_switch_track track;
+    int value;
+    u64 gen;
+    u64 first_gen;              /* generation that opened the window */
+    u64 queued_ns;              /* when the window opened */
+    bool pending;
+    bool tracked;               /* track is on switch_inflight */
+};
+
+/* Firmware call error classes tracked per method */
+enum armoury_err_class {
+    ARMOURY_ERR_IO = 0,         /* AML evaluation failed */
+    ARMOURY_ERR_PROTO,          /* unexpected result type or size */
+    ARMOURY_ERR_NODATA,         /* no result object */
+    ARMOURY_ERR_OTHER,
+    ARMOURY_ERR_COUNT
+};
+
+/* log2(ns) latency buckets, the last one is open-ended (>= ~1s) */
+#define ARMOURY_LAT_BUCKETS            32
+
+/* Per-method call statistics, protected by the device lock */
+struct armoury_method_stats {
+    u64 calls;
+    u64 errors[ARMOURY_ERR_COUNT];
+    u64 total_ns;
+    u64 min_ns;
+    u64 max_ns;
+    u64 hist[ARMOURY_LAT_BUCKETS];
+};
+
+/* Upper bound on per-vendor methods tracked by a device */
+#define ARMOURY_MAX_METHODS            16
+
+/* ACPI method name and its namespace handle (NULL if absent) */
+struct armoury_method {
+    const char *name;
+    acpi_handle handle;
+    struct armoury_method_stats stats;
+};
+
+/* Per-device ACPI result buffer: initial size and growth bound */
+#define ARMOURY_RESULT_BUF_SIZE        128
+#define ARMOURY_RESULT_BUF_MAX         4096
+
 struct universal_armoury {
     struct acpi_device *acpi_dev;
+    struct list_head node;      /* on universal_armoury_devices */
+    u32 index;                  /* instance number in the userspace ABIs */
+    struct kref users;          /* ioctls between lookup and put, and the list */
+    struct completion released; /* users dropped to zero */
     
     /* Vendor identification */
+    const struct armoury_vendor_desc *desc;
     enum laptop_vendor vendor;
     char vendor_name[32];
     char product_name[64];
+    char bios_version[32];
     
-    /* Feature support flags */
+    /* Feature support flags, final once probed is set */
+    bool probed;
+    struct work_struct probe_work;
     bool gpu_mux_supported;
     bool dgpu_disable_supported;
     bool egpu_supported;
@@ -226,517 +651,3640 @@ struct universal_armoury {
     int dgpu_disable_state;
     int egpu_state;
     
-    /* ACPI method names for this vendor */
-    const char *get_gpu_mux_method;
-    const char *set_gpu_mux_method;
-    const char *get_dgpu_disable_method;
-    const char *set_dgpu_disable_method;
-    const char *get_egpu_enable_method;
-    const char *set_egpu_enable_method;
+    /* ACPI methods for this vendor, resolved once at probe */
+    struct armoury_method get_gpu_mux_method;
+    struct armoury_method set_gpu_mux_method;
+    struct armoury_method get_dgpu_disable_method;
+    struct armoury_method set_dgpu_disable_method;
+    struct armoury_method get_egpu_enable_method;
+    struct armoury_method set_egpu_enable_method;
+    struct armoury_method bios_get_method;
+    struct armoury_method bios_set_method;
+    bool bulk_read_broken;      /* read_all reported missing support */
+
+    /* Known pairs found by the namespace walk, fixed after add */
+    struct armoury_capability caps[ARMOURY_NR_CAP_PAIRS];
+
+    /*
+     * State cache, protected by lock. Firmware calls are made with lock
+     * held. The state values, state_gen and the valid/updated fields are
+     * also written inside cache_seq so readers can sample them without
+     * the lock.
+     */
+    struct mutex lock;
+    seqcount_mutex_t cache_seq;
+    struct armoury_state_cache cache[ARMOURY_STATE_COUNT];
+    atomic_long_t cache_hits;
+    atomic_long_t cache_misses;
+    atomic_long_t dgpu_reads_avoided;
+    u64 state_gen;              /* bumped whenever a known value changes */
+
+    /* Reusable ACPI result buffer, protected by lock */
+    void *result_buf;
+    acpi_size result_buf_len;
+    atomic_long_t eval_calls;
+    atomic_long_t eval_allocs;
+    u64 last_eval_ns;           /* duration of the latest firmware call */
+
+    /* platform_profile device, set once firmware confirmed the policy */
+    struct device *ppdev;
+    int profile;                /* ARMOURY_PROFILE_* last read or written */
+
+    /* Fan curves, final once probed is set; defaults protected by lock */
+    unsigned long fan_curves;   /* BIT(fan) for each curve firmware reported */
+    unsigned long fan_default_saved;    /* BIT(fan) once fan_default[fan] was read */
+    struct armoury_fan_curve fan_default[ARMOURY_FAN_COUNT];
+
+    /* Power limits, final once probed is set */
+    unsigned long power_limits; /* BIT(limit) for each one firmware reported */
+
+    /* debugfs directory for this device */
+    struct dentry *debugfs_dir;
+
+    /* Asynchronous switch tracking, protected by lock */
+    u64 switch_gen_queued;
+    u64 switch_gen_done;        /* every generation up to this one completed */
+    struct list_head switch_inflight;
+    struct list_head switch_reqs;
+    struct work_struct switch_work;
+    int switch_err;
+
+    /* Write coalescing, protected by lock */
+    struct armoury_pending_write pending[ARMOURY_STATE_COUNT];
+    atomic_long_t writes_coalesced;
+    atomic_long_t writes_short_circuited;
+
+    /* Suspend/resume restore, protected by lock */
+    struct work_struct resume_work;
+    int resume_desired[ARMOURY_STATE_COUNT];
+    unsigned long resume_desired_mask;
+    u64 resume_start_ns;
+    u64 resumes;
+    u64 restores;               /* states written back after resume */
+    u64 restore_failures;
+    u64 last_resume_ns;         /* time spent in the resume callback */
+    u64 last_restore_ns;        /* resume callback entry to restore done */
+    unsigned long last_restore_calls;
+
+    /* GPU governor, protected by lock except the notifier counters */
+    struct notifier_block gov_nb;       /* notifier_call set while registered */
+    struct delayed_work gov_work;
+    unsigned long gov_policy;           /* BIT(id) for each state switched on battery */
+    int gov_target[ARMOURY_STATE_COUNT];        /* value on battery */
+    unsigned long gov_saved_mask;       /* BIT(id) for each state to restore on AC */
+    int gov_saved[ARMOURY_STATE_COUNT];         /* value replaced on battery */
+    int gov_applied[ARMOURY_STATE_COUNT];       /* value the governor wrote */
+    enum armoury_gov_source gov_source;
+    bool gov_locked;                    /* manual override, no automatic switching */
+    atomic_long_t gov_events;
+    atomic_long_t gov_debounced;        /* events that restarted the hysteresis wait */
+    u64 gov_transitions;
+    u64 gov_writes;
+    u64 gov_failures;
+    u64 gov_skipped;                    /* source changes ignored while locked */
+    u64 gov_mux_blocked;                /* dGPU left on because the MUX selects it */
+};
+
+/*
+ * Bound devices. The lock also keeps a device alive across /dev/armoury
+ * ioctls, remove() takes it before tearing anything down.
+ */
+static LIST_HEAD(universal_armoury_devices);
+static DEFINE_MUTEX(universal_armoury_devs_lock);
+static DEFINE_IDA(universal_armoury_ida);
+
+/* debugfs root, one subdirectory per bound device */
+static struct dentry *universal_armoury_debugfs_root;
+
+/* Ordered queue for asynchronous setter calls, shared by all devices */
+static struct workqueue_struct *universal_armoury_wq;
+
+/* Generic netlink family pushing events to subscribed agents */
+static const struct genl_multicast_group universal_armoury_genl_mcgrps[] = {
+    { .name = ARMOURY_GENL_MCGRP_EVENTS },
+};
+
+static struct genl_family universal_armoury_genl_family = {
+    .name = ARMOURY_GENL_NAME,
+    .version = ARMOURY_GENL_VERSION,
+    .maxattr = ARMOURY_ATTR_MAX,
+    .module = THIS_MODULE,
+    .mcgrps = universal_armoury_genl_mcgrps,
+    .n_mcgrps = ARRAY_SIZE(universal_armoury_genl_mcgrps),
+};
+
+/* Netlink event; only the fields relevant to cmd are sent */
+struct armoury_genl_event {
+    u8 cmd;
+    u32 source;                 /* enum armoury_event_source */
+    u64 latency_ns;
+    enum armoury_state_id id;
+    bool old_known;
+    int old_value;
+    int new_value;
+    u64 gen;
+    int err;
+    u32 supported;
+};
+
+/* Multicast an event on the "events" group, skipped without subscribers */
+static void universal_armoury_genl_event(struct universal_armoury *armoury,
+                                         const struct armoury_genl_event *ev)
+{
+    struct sk_buff *skb;
+    void *hdr;
+
+    if (!genl_has_listeners(&universal_armoury_genl_family, &init_net, 0))
+        return;
+
+    skb = genlmsg_new(NLMSG_GOODSIZE, GFP_KERNEL);
+    if (!skb)
+        return;
+
+    hdr = genlmsg_put(skb, 0, 0, &universal_armoury_genl_family, 0, ev->cmd);
+    if (!hdr)
+        goto fail;
+
+    if (nla_put_u32(skb, ARMOURY_ATTR_INDEX, armoury->index) ||
+        nla_put_u32(skb, ARMOURY_ATTR_SOURCE, ev->source) ||
+        nla_put_u64_64bit(skb, ARMOURY_ATTR_LATENCY_NS, ev->latency_ns, ARMOURY_ATTR_PAD))
+        goto fail;
+
+    switch (ev->cmd) {
+    case ARMOURY_CMD_STATE_CHANGE:
+        if (nla_put_u32(skb, ARMOURY_ATTR_STATE, ev->id) ||
+            (ev->old_known && nla_put_s32(skb, ARMOURY_ATTR_OLD_VALUE, ev->old_value)) ||
+            nla_put_s32(skb, ARMOURY_ATTR_NEW_VALUE, ev->new_value) ||
+            nla_put_u64_64bit(skb, ARMOURY_ATTR_GENERATION, ev->gen, ARMOURY_ATTR_PAD))
+            goto fail;
+        break;
+    case ARMOURY_CMD_SWITCH_DONE:
+        if (nla_put_u32(skb, ARMOURY_ATTR_STATE, ev->id) ||
+            nla_put_s32(skb, ARMOURY_ATTR_NEW_VALUE, ev->new_value) ||
+            nla_put_u64_64bit(skb, ARMOURY_ATTR_SWITCH_GEN, ev->gen, ARMOURY_ATTR_PAD) ||
+            nla_put_s32(skb, ARMOURY_ATTR_ERRNO, ev->err))
+            goto fail;
+        break;
+    case ARMOURY_CMD_PROBE:
+        if (nla_put_u32(skb, ARMOURY_ATTR_SUPPORTED, ev->supported))
+            goto fail;
+        break;
+    }
+
+    genlmsg_end(skb, hdr);
+    genlmsg_multicast(&universal_armoury_genl_family, skb, 0, 0, GFP_KERNEL);
+    return;
+
+fail:
+    nlmsg_free(skb);
+}
+
+/* Sysfs attribute backing each cached state, also used in log messages */
+static const char * const armoury_state_attr_names[ARMOURY_STATE_COUNT] = {
+    [ARMOURY_STATE_GPU_MUX] = "gpu_mux",
+    [ARMOURY_STATE_DGPU_DISABLE] = "dgpu_disable",
+    [ARMOURY_STATE_EGPU_ENABLE] = "egpu_enable",
 };
 
-static struct universal_armoury *universal_armoury_dev;
+/* Map a cached state to its storage and getter method */
+static int *armoury_state_ptr(struct universal_armoury *armoury,
+                              enum armoury_state_id id)
+{
+    switch (id) {
+    case ARMOURY_STATE_GPU_MUX:
+        return &armoury->gpu_mux_state;
+    case ARMOURY_STATE_DGPU_DISABLE:
+        return &armoury->dgpu_disable_state;
+    case ARMOURY_STATE_EGPU_ENABLE:
+        return &armoury->egpu_state;
+    default:
+        return NULL;
+    }
+}
+
+static bool *armoury_state_support_flag(struct universal_armoury *armoury,
+                                        enum armoury_state_id id)
+{
+    switch (id) {
+    case ARMOURY_STATE_GPU_MUX:
+        return &armoury->gpu_mux_supported;
+    case ARMOURY_STATE_DGPU_DISABLE:
+        return &armoury->dgpu_disable_supported;
+    case ARMOURY_STATE_EGPU_ENABLE:
+        return &armoury->egpu_supported;
+    default:
+        return NULL;
+    }
+}
+
+static bool armoury_state_supported(struct universal_armoury *armoury,
+                                    enum armoury_state_id id)
+{
+    bool *flag = armoury_state_support_flag(armoury, id);
+
+    return flag && *flag;
+}
+
+static struct armoury_method *armoury_state_get_method(struct universal_armoury *armoury,
+                                            enum armoury_state_id id)
+{
+    switch (id) {
+    case ARMOURY_STATE_GPU_MUX:
+        return &armoury->get_gpu_mux_method;
+    case ARMOURY_STATE_DGPU_DISABLE:
+        return &armoury->get_dgpu_disable_method;
+    case ARMOURY_STATE_EGPU_ENABLE:
+        return &armoury->get_egpu_enable_method;
+    default:
+        return NULL;
+    }
+}
+
+static struct armoury_method *armoury_state_set_method(struct universal_armoury *armoury,
+                                                       enum armoury_state_id id)
+{
+    switch (id) {
+    case ARMOURY_STATE_GPU_MUX:
+        return &armoury->set_gpu_mux_method;
+    case ARMOURY_STATE_DGPU_DISABLE:
+        return &armoury->set_dgpu_disable_method;
+    case ARMOURY_STATE_EGPU_ENABLE:
+        return &armoury->set_egpu_enable_method;
+    default:
+        return NULL;
+    }
+}
 
 /* Vendor detection function */
-static enum laptop_vendor detect_laptop_vendor(struct universal_armoury *dev)
+static const struct armoury_vendor_desc *detect_laptop_vendor(void)
+{
+    const struct dmi_system_id *match;
+
+    match = dmi_first_match(universal_armoury_vendor_table);
+    if (!match)
+        return NULL;
+
+    return match->driver_data;
+}
+
+static void read_laptop_names(struct universal_armoury *dev)
 {
     const char *vendor = dmi_get_system_info(DMI_SYS_VENDOR);
     const char *product = dmi_get_system_info(DMI_PRODUCT_NAME);
-    
+    const char *bios = dmi_get_system_info(DMI_BIOS_VERSION);
+
     if (vendor) {
         strscpy(dev->vendor_name, vendor, sizeof(dev->vendor_name));
     }
     if (product) {
         strscpy(dev->product_name, product, sizeof(dev->product_name));
     }
-    
-    if (vendor) {
-        if (strstr(vendor, "ASUS") || strstr(vendor, "ASUSTeK")) {
-            return VENDOR_ASUS;
-        } else if (strstr(vendor, "MSI") || strstr(vendor, "Micro-Star")) {
-            return VENDOR_MSI;
-        } else if (strstr(vendor, "Dell") || strstr(vendor, "Alienware")) {
-            return VENDOR_DELL_ALIENWARE;
-        } else if (strstr(vendor, "LENOVO") || strstr(vendor, "Lenovo")) {
-            return VENDOR_LENOVO;
-        } else if (strstr(vendor, "HP") || strstr(vendor, "Hewlett-Packard")) {
-            return VENDOR_HP;
-        } else if (strstr(vendor, "Acer")) {
-            return VENDOR_ACER;
-        }
-    }
-    
-    /* Check product name for gaming laptop indicators */
-    if (product) {
-        if (strstr(product, "ROG") || strstr(product, "TUF") ||
-            strstr(product, "Legion") || strstr(product, "Gaming") ||
-            strstr(product, "Predator") || strstr(product, "Nitro")) {
-            return VENDOR_GENERIC;
-        }
+    if (bios) {
+        strscpy(dev->bios_version, bios, sizeof(dev->bios_version));
     }
-    
-    return VENDOR_UNKNOWN;
 }
 
 /* Set vendor-specific ACPI method names */
 static void set_vendor_acpi_methods(struct universal_armoury *dev)
 {
-    switch (dev->vendor) {
-    case VENDOR_ASUS:
-        dev->get_gpu_mux_method = ASUS_ACPI_GET_GPU_MUX_STATE;
-        dev->set_gpu_mux_method = ASUS_ACPI_SET_GPU_MUX_STATE;
-        dev->get_dgpu_disable_method = ASUS_ACPI_GET_DGPU_DISABLE;
-        dev->set_dgpu_disable_method = ASUS_ACPI_SET_DGPU_DISABLE;
-        dev->get_egpu_enable_method = ASUS_ACPI_GET_EGPU_ENABLE;
-        dev->set_egpu_enable_method = ASUS_ACPI_SET_EGPU_ENABLE;
-        break;
-    case VENDOR_MSI:
-        dev->get_gpu_mux_method = MSI_ACPI_GET_GPU_MUX_STATE;
-        dev->set_gpu_mux_method = MSI_ACPI_SET_GPU_MUX_STATE;
-        dev->get_dgpu_disable_method = MSI_ACPI_GET_DGPU_DISABLE;
-        dev->set_dgpu_disable_method = MSI_ACPI_SET_DGPU_DISABLE;
-        dev->get_egpu_enable_method = NULL; /* Not commonly supported */
-        dev->set_egpu_enable_method = NULL;
-        break;
-    case VENDOR_DELL_ALIENWARE:
-        dev->get_gpu_mux_method = DELL_ACPI_GET_GPU_MUX_STATE;
-        dev->set_gpu_mux_method = DELL_ACPI_SET_GPU_MUX_STATE;
-        dev->get_dgpu_disable_method = DELL_ACPI_GET_DGPU_DISABLE;
-        dev->set_dgpu_disable_method = DELL_ACPI_SET_DGPU_DISABLE;
-        dev->get_egpu_enable_method = NULL;
-        dev->set_egpu_enable_method = NULL;
-        break;
-    case VENDOR_LENOVO:
-        dev->get_gpu_mux_method = LENOVO_ACPI_GET_GPU_MUX_STATE;
-        dev->set_gpu_mux_method = LENOVO_ACPI_SET_GPU_MUX_STATE;
-        dev->get_dgpu_disable_method = LENOVO_ACPI_GET_DGPU_DISABLE;
-        dev->set_dgpu_disable_method = LENOVO_ACPI_SET_DGPU_DISABLE;
-        dev->get_egpu_enable_method = NULL;
-        dev->set_egpu_enable_method = NULL;
-        break;
-    default:
-        /* Try generic methods */
-        dev->get_gpu_mux_method = GENERIC_ACPI_GET_MUX_STATE;
-        dev->set_gpu_mux_method = GENERIC_ACPI_SET_MUX_STATE;
-        dev->get_dgpu_disable_method = GENERIC_ACPI_GET_GPU_STATE;
-        dev->set_dgpu_disable_method = GENERIC_ACPI_SET_GPU_STATE;
-        dev->get_egpu_enable_method = NULL;
-        dev->set_egpu_enable_method = NULL;
-        break;
+    const struct armoury_vendor_desc *desc = dev->desc;
+    int i;
+
+    for (i = 0; i < ARMOURY_STATE_COUNT; i++) {
+        if (!(desc->features & BIT(i)))
+            continue;
+        armoury_state_get_method(dev, i)->name = desc->get_methods[i];
+        armoury_state_set_method(dev, i)->name = desc->set_methods[i];
     }
+
+    dev->bios_get_method.name = desc->bios_get_method;
+    dev->bios_set_method.name = desc->bios_set_method;
 }
 
-/* Helper function to execute ACPI methods */
-static int universal_armoury_acpi_evaluate_method(struct acpi_device *adev,
-                                                const char *method_name,
-                                                u32 arg, u32 *result)
+/* Collect the per-vendor methods of a device for resolving and reporting */
+static int armoury_method_list(struct universal_armoury *armoury,
+                               struct armoury_method **methods)
 {
-    struct acpi_object_list input;
-    union acpi_object in_obj;
-    struct acpi_buffer output = { ACPI_ALLOCATE_BUFFER, NULL };
-    union acpi_object *out_obj;
-    acpi_status status;
-    int ret = 0;
+    int n = 0;
 
-    /* Validate input parameters */
-    if (!adev || !method_name) {
-        return -EINVAL;
-    }
+    methods[n++] = &armoury->get_gpu_mux_method;
+    methods[n++] = &armoury->set_gpu_mux_method;
+    methods[n++] = &armoury->get_dgpu_disable_method;
+    methods[n++] = &armoury->set_dgpu_disable_method;
+    methods[n++] = &armoury->get_egpu_enable_method;
+    methods[n++] = &armoury->set_egpu_enable_method;
+    methods[n++] = &armoury->bios_get_method;
+    methods[n++] = &armoury->bios_set_method;
 
-    input.count = 1;
-    input.pointer = &in_obj;
-    in_obj.type = ACPI_TYPE_INTEGER;
-    in_obj.integer.value = arg;
-
-    status = acpi_evaluate_object(adev->handle, (char *)method_name,
-                                &input, &output);
-
-    if (ACPI_SUCCESS(status)) {
-        out_obj = output.pointer;
-        if (out_obj) {
-            if (out_obj->type == ACPI_TYPE_INTEGER && result) {
-                *result = (u32)out_obj->integer.value;
-            } else if (out_obj->type != ACPI_TYPE_INTEGER) {
-                dev_warn(&adev->dev, "ACPI method %s returned non-integer type: %d\n",
-                         method_name, out_obj->type);
-                ret = -EPROTO;
-            }
-            kfree(output.pointer);
-        } else {
-            dev_err(&adev->dev, "ACPI method %s returned NULL output\n", method_name);
-            ret = -ENODATA;
-        }
-    } else {
-        dev_err(&adev->dev, "ACPI method %s failed with status 0x%x\n",
-                method_name, status);
-        ret = -EIO;
+    return n;
+}
+
+/* Declared argument count of a method, read from the namespace node */
+static u8 armoury_method_arity(acpi_handle handle)
+{
+    struct acpi_device_info *info;
+    u8 args = 0;
+
+    if (ACPI_SUCCESS(acpi_get_object_info(handle, &info))) {
+        args = info->param_count;
+        kfree(info);
     }
 
-    return ret;
+    return args;
 }
 
-/* GPU MUX control */
-static ssize_t gpu_mux_show(struct device *dev,
-                          struct device_attribute *attr, char *buf)
+/*
+ * acpi_walk_namespace callback for each method directly under the device:
+ * record known pairs in the capability table and resolve the vendor methods
+ * by name, so hot paths never repeat the pathname lookup.
+ */
+static acpi_status universal_armoury_scan_method(acpi_handle handle, u32 level,
+                                                 void *context, void **retval)
 {
-    struct acpi_device *adev = to_acpi_device(dev);
-    struct universal_armoury *armoury = adev->driver_data;
-    u32 result;
-    int ret;
+    struct universal_armoury *armoury = context;
+    struct armoury_method *methods[ARMOURY_MAX_METHODS];
+    char name[ACPI_NAMESEG_SIZE + 1];
+    struct acpi_buffer buf = { sizeof(name), name };
+    const struct armoury_cap_pair *pair;
+    struct armoury_capability *cap;
+    int i, n, args = -1;
 
-    if (!armoury || !armoury->gpu_mux_supported || !armoury->get_gpu_mux_method)
-        return -ENODEV;
+    if (ACPI_FAILURE(acpi_get_name(handle, ACPI_SINGLE_NAME, &buf)))
+        return AE_OK;
 
-    ret = universal_armoury_acpi_evaluate_method(armoury->acpi_dev,
-                                               armoury->get_gpu_mux_method,
-                                               0, &result);
-    if (ret)
-        return ret;
+    for (i = 0; i < ARMOURY_NR_CAP_PAIRS; i++) {
+        pair = &universal_armoury_cap_pairs[i];
+        cap = &armoury->caps[i];
+        if (pair->get && !strcmp(pair->get, name)) {
+            if (args < 0)
+                args = armoury_method_arity(handle);
+            cap->get_handle = handle;
+            cap->get_args = args;
+        }
+        if (pair->set && !strcmp(pair->set, name)) {
+            if (args < 0)
+                args = armoury_method_arity(handle);
+            cap->set_handle = handle;
+            cap->set_args = args;
+        }
+    }
 
-    armoury->gpu_mux_state = result;
-    return scnprintf(buf, PAGE_SIZE, "%d\n", result);
+    n = armoury_method_list(armoury, methods);
+    for (i = 0; i < n; i++) {
+        if (methods[i]->name && !strcmp(methods[i]->name, name))
+            methods[i]->handle = handle;
+    }
+
+    return AE_OK;
 }
 
-static ssize_t gpu_mux_store(struct device *dev,
-                           struct device_attribute *attr,
-                           const char *buf, size_t count)
+/* One pass over the methods under the device; nothing is evaluated */
+static void universal_armoury_scan_methods(struct universal_armoury *armoury)
 {
-    struct acpi_device *adev = to_acpi_device(dev);
-    struct universal_armoury *armoury = adev->driver_data;
-    int value, ret;
+    acpi_status status;
 
-    if (!armoury || !armoury->gpu_mux_supported || !armoury->set_gpu_mux_method)
+    status = acpi_walk_namespace(ACPI_TYPE_METHOD, armoury->acpi_dev->handle, 1,
+                                 universal_armoury_scan_method, NULL, armoury, NULL);
+    if (ACPI_FAILURE(status))
+        dev_warn(&armoury->acpi_dev->dev, "ACPI namespace scan failed: %s\n",
+                 acpi_format_exception(status));
+}
+
+/* Account a failed evaluation by errno class */
+static void armoury_method_stats_error(struct armoury_method_stats *stats, int err)
+{
+    switch (err) {
+    case -EIO:
+        stats->errors[ARMOURY_ERR_IO]++;
+        break;
+    case -EPROTO:
+        stats->errors[ARMOURY_ERR_PROTO]++;
+        break;
+    case -ENODATA:
+        stats->errors[ARMOURY_ERR_NODATA]++;
+        break;
+    default:
+        stats->errors[ARMOURY_ERR_OTHER]++;
+        break;
+    }
+}
+
+static void armoury_method_stats_record(struct armoury_method_stats *stats,
+                                        u64 ns, int err)
+{
+    stats->calls++;
+    stats->total_ns += ns;
+    if (!stats->min_ns || ns < stats->min_ns)
+        stats->min_ns = ns;
+    if (ns > stats->max_ns)
+        stats->max_ns = ns;
+    stats->hist[min_t(unsigned int, fls64(ns), ARMOURY_LAT_BUCKETS - 1)]++;
+    if (err)
+        armoury_method_stats_error(stats, err);
+}
+
+/*
+ * Evaluate a method into the per-device result buffer. The returned object
+ * stays valid until armoury->lock is dropped. The buffer is sized at probe
+ * for integer and small package/buffer returns and only grows (up to
+ * ARMOURY_RESULT_BUF_MAX) when firmware returns something larger, so calls
+ * do not allocate in steady state. Growing means running the method again,
+ * which is only done when the caller marks it idempotent (getters).
+ */
+static int universal_armoury_acpi_evaluate(struct universal_armoury *armoury,
+                                           struct armoury_method *method,
+                                           struct acpi_object_list *input,
+                                           bool idempotent,
+                                           union acpi_object **out)
+{
+    union acpi_object *result = NULL;
+    struct acpi_device *adev;
+    struct acpi_buffer output;
+    acpi_status status = AE_OK;
+    u64 start, duration;
+    void *buf;
+    int ret = 0;
+
+    /* Validate input parameters */
+    if (!armoury || !method) {
+        return -EINVAL;
+    }
+
+    /* Absent methods are known from probe, no need to enter ACPICA */
+    if (!method->handle)
+        return -ENODEV;
+
+    lockdep_assert_held(&armoury->lock);
+    adev = armoury->acpi_dev;
+    atomic_long_inc(&armoury->eval_calls);
+    trace_armoury_acpi_eval_enter(method->name, input);
+    start = ktime_get_ns();
+
+    for (;;) {
+        output.length = armoury->result_buf_len;
+        output.pointer = armoury->result_buf;
+        status = acpi_evaluate_object(method->handle, NULL, input, &output);
+        if (status != AE_BUFFER_OVERFLOW || !idempotent)
+            break;
+
+        /* ACPICA reports the required size in output.length */
+        if (output.length > ARMOURY_RESULT_BUF_MAX) {
+            dev_warn(&adev->dev, "ACPI method %s result too large: %llu bytes\n",
+                     method->name, (unsigned long long)output.length);
+            ret = -E2BIG;
+            goto out;
+        }
+
+        buf = kmalloc(output.length, GFP_KERNEL);
+        if (!buf) {
+            ret = -ENOMEM;
+            goto out;
+        }
+        kfree(armoury->result_buf);
+        armoury->result_buf = buf;
+        armoury->result_buf_len = output.length;
+        atomic_long_inc(&armoury->eval_allocs);
+    }
+
+    if (status == AE_BUFFER_OVERFLOW) {
+        dev_warn(&adev->dev, "ACPI method %s returned an oversized object\n",
+                 method->name);
+        ret = -EPROTO;
+    } else if (ACPI_FAILURE(status)) {
+        dev_err(&adev->dev, "ACPI method %s failed with status 0x%x\n",
+                method->name, status);
+        ret = -EIO;
+    } else if (!output.length) {
+        dev_err(&adev->dev, "ACPI method %s returned NULL output\n", method->name);
+        ret = -ENODATA;
+    } else {
+        result = output.pointer;
+        *out = result;
+    }
+
+out:
+    duration = ktime_get_ns() - start;
+    armoury->last_eval_ns = duration;
+    armoury_method_stats_record(&method->stats, duration, ret);
+    trace_armoury_acpi_eval_exit(method->name, input, result, status, ret, duration);
+    return ret;
+}
+
+/* A fan curve upload passes the selector and four packed words */
+#define ARMOURY_MAX_ARGS               5
+
+/* Build the argument list of @nargs integers in @in_obj */
+static void armoury_acpi_int_args(struct acpi_object_list *input,
+                                  union acpi_object *in_obj,
+                                  const u32 *args, u32 nargs)
+{
+    u32 i;
+
+    input->count = nargs;
+    input->pointer = in_obj;
+    for (i = 0; i < nargs; i++) {
+        in_obj[i].type = ACPI_TYPE_INTEGER;
+        in_obj[i].integer.value = args[i];
+    }
+}
+
+/* Execute an ACPI method taking up to ARMOURY_MAX_ARGS integers, returning one */
+static int universal_armoury_acpi_evaluate_args(struct universal_armoury *armoury,
+                                                struct armoury_method *method,
+                                                const u32 *args, u32 nargs,
+                                                u32 *result)
+{
+    struct acpi_object_list input;
+    union acpi_object in_obj[ARMOURY_MAX_ARGS];
+    union acpi_object *out_obj;
+    int ret;
+
+    KUNIT_STATIC_STUB_REDIRECT(universal_armoury_acpi_evaluate_args,
+                               armoury, method, args, nargs, result);
+
+    if (nargs > ARMOURY_MAX_ARGS)
+        return -EINVAL;
+
+    armoury_acpi_int_args(&input, in_obj, args, nargs);
+
+    /* Getters (result wanted) are safe to run again, setters are not */
+    ret = universal_armoury_acpi_evaluate(armoury, method, &input,
+                                          result != NULL, &out_obj);
+    if (ret)
+        return ret;
+
+    if (out_obj->type != ACPI_TYPE_INTEGER) {
+        dev_warn(&armoury->acpi_dev->dev, "ACPI method %s returned non-integer type: %d\n",
+                 method->name, out_obj->type);
+        armoury_method_stats_error(&method->stats, -EPROTO);
+        return -EPROTO;
+    }
+
+    if (result)
+        *result = (u32)out_obj->integer.value;
+
+    return 0;
+}
+
+/* As universal_armoury_acpi_evaluate_args(), for getters returning a buffer */
+static int universal_armoury_acpi_evaluate_buf(struct universal_armoury *armoury,
+                                               struct armoury_method *method,
+                                               const u32 *args, u32 nargs,
+                                               u8 *buf, u32 len)
+{
+    struct acpi_object_list input;
+    union acpi_object in_obj[ARMOURY_MAX_ARGS];
+    union acpi_object *out_obj;
+    int ret;
+
+    KUNIT_STATIC_STUB_REDIRECT(universal_armoury_acpi_evaluate_buf,
+                               armoury, method, args, nargs, buf, len);
+
+    if (nargs > ARMOURY_MAX_ARGS)
+        return -EINVAL;
+
+    armoury_acpi_int_args(&input, in_obj, args, nargs);
+    ret = universal_armoury_acpi_evaluate(armoury, method, &input, true, &out_obj);
+    if (ret)
+        return ret;
+
+    /* Firmware without the setting answers with an integer status */
+    if (out_obj->type != ACPI_TYPE_BUFFER || out_obj->buffer.length < len) {
+        dev_dbg(&armoury->acpi_dev->dev, "ACPI method %s returned no %u byte buffer\n",
+                method->name, len);
+        return -ENODEV;
+    }
+
+    memcpy(buf, out_obj->buffer.pointer, len);
+    return 0;
+}
+
+/* Helper function to execute ACPI methods taking and returning one integer */
+static int universal_armoury_acpi_evaluate_method(struct universal_armoury *armoury,
+                                                struct armoury_method *method,
+                                                u32 arg, u32 *result)
+{
+    return universal_armoury_acpi_evaluate_args(armoury, method, &arg, 1, result);
+}
+
+/*
+ * Store a value firmware is known to hold and publish a state change event
+ * if it differs from the previous one. @valid lets reads be served from it.
+ * Caller holds armoury->lock.
+ */
+static void universal_armoury_cache_store(struct universal_armoury *armoury,
+                                          enum armoury_state_id id, int value,
+                                          bool valid,
+                                          enum armoury_event_source source)
+{
+    struct armoury_state_cache *entry = &armoury->cache[id];
+    int *state = armoury_state_ptr(armoury, id);
+    struct armoury_genl_event ev = {
+        .cmd = ARMOURY_CMD_STATE_CHANGE,
+        .source = source,
+        .latency_ns = armoury->last_eval_ns,
+        .id = id,
+        .old_known = entry->seen,
+        .old_value = *state,
+        .new_value = value,
+    };
+    bool changed = !entry->seen || *state != value;
+
+    write_seqcount_begin(&armoury->cache_seq);
+    *state = value;
+    entry->updated = jiffies;
+    entry->updated_ns = ktime_get_ns();
+    entry->valid = valid;
+    entry->known = true;
+    entry->seen = true;
+    if (changed)
+        ev.gen = ++armoury->state_gen;
+    write_seqcount_end(&armoury->cache_seq);
+
+    if (changed)
+        universal_armoury_genl_event(armoury, &ev);
+}
+
+/* Record a value read from firmware; caller holds armoury->lock */
+static void universal_armoury_cache_update(struct universal_armoury *armoury,
+                                           enum armoury_state_id id, int value,
+                                           enum armoury_event_source source)
+{
+    universal_armoury_cache_store(armoury, id, value, true, source);
+}
+
+/* Firmware may hold anything for @id now; caller holds armoury->lock */
+static void universal_armoury_cache_forget(struct universal_armoury *armoury,
+                                           enum armoury_state_id id)
+{
+    write_seqcount_begin(&armoury->cache_seq);
+    armoury->cache[id].valid = false;
+    armoury->cache[id].known = false;
+    write_seqcount_end(&armoury->cache_seq);
+}
+
+/* Drop cached states so the next read goes to firmware */
+static void universal_armoury_cache_invalidate(struct universal_armoury *armoury)
+{
+    int i;
+
+    mutex_lock(&armoury->lock);
+    for (i = 0; i < ARMOURY_STATE_COUNT; i++)
+        universal_armoury_cache_forget(armoury, i);
+    mutex_unlock(&armoury->lock);
+}
+
+/*
+ * True when firmware is known to already hold @value, so writing it again
+ * can be skipped. The stored value is trusted for cache_ttl_ms like cached
+ * reads.
+ */
+static bool armoury_state_matches(struct universal_armoury *armoury,
+                                  enum armoury_state_id id, int value)
+{
+    struct armoury_state_cache *entry = &armoury->cache[id];
+    unsigned int ttl = READ_ONCE(cache_ttl_ms);
+
+    lockdep_assert_held(&armoury->lock);
+
+    return ttl && entry->known && *armoury_state_ptr(armoury, id) == value &&
+           time_before(jiffies, entry->updated + msecs_to_jiffies(ttl));
+}
+
+/*
+ * States whose getter touches the dGPU's PCI config space. AML such as DGPU,
+ * GDIS or LDGP wakes a runtime-suspended dGPU, which costs power and
+ * hundreds of milliseconds.
+ */
+#define ARMOURY_DGPU_WAKE_STATES       BIT(ARMOURY_STATE_DGPU_DISABLE)
+
+/*
+ * An internal discrete GPU. NVIDIA parts always are. An AMD APU's iGPU also
+ * sits behind a bridge, so AMD parts count only with their own D3cold power
+ * resource. Thunderbolt-attached eGPUs are skipped.
+ */
+static bool armoury_pci_is_dgpu(struct pci_dev *pdev)
+{
+    if (pci_is_root_bus(pdev->bus) || pci_is_thunderbolt_attached(pdev))
+        return false;
+
+    switch (pdev->vendor) {
+    case PCI_VENDOR_ID_NVIDIA:
+        return true;
+    case PCI_VENDOR_ID_ATI:
+    case PCI_VENDOR_ID_AMD:
+        return pci_pr3_present(pdev);
+    default:
+        return false;
+    }
+}
+
+/*
+ * The discrete GPU, looked up afresh each time: dgpu_disable removes it from
+ * the bus and re-enabling adds a new pci_dev. Returns a referenced device or
+ * NULL.
+ */
+static struct pci_dev *universal_armoury_find_dgpu(void)
+{
+    struct pci_dev *pdev = NULL;
+
+    while ((pdev = pci_get_base_class(PCI_BASE_CLASS_DISPLAY, pdev))) {
+        if (armoury_pci_is_dgpu(pdev))
+            return pdev;
+    }
+
+    return NULL;
+}
+
+/*
+ * Getters to leave alone because their dGPU is runtime-suspended. Only called
+ * when the cache misses, so the bus walk stays off the cached read path.
+ */
+static unsigned long armoury_dgpu_wake_mask(struct universal_armoury *armoury)
+{
+    struct pci_dev *pdev;
+    bool asleep;
+
+    if (!armoury_state_supported(armoury, ARMOURY_STATE_DGPU_DISABLE))
+        return 0;
+
+    pdev = universal_armoury_find_dgpu();
+    if (!pdev)
+        return 0;
+    asleep = pm_runtime_suspended(&pdev->dev);
+    pci_dev_put(pdev);
+
+    return asleep ? ARMOURY_DGPU_WAKE_STATES : 0;
+}
+
+/*
+ * Re-read one state through its getter. Sets BIT(id) in *changed when the
+ * value differs from the last known one. Caller holds armoury->lock.
+ */
+static int universal_armoury_read_state(struct universal_armoury *armoury,
+                                        enum armoury_state_id id,
+                                        unsigned long *changed,
+                                        enum armoury_event_source source)
+{
+    u32 result;
+    int ret;
+
+    ret = universal_armoury_acpi_evaluate_method(armoury,
+                                               armoury_state_get_method(armoury, id),
+                                               0, &result);
+    if (!ret) {
+        if (*armoury_state_ptr(armoury, id) != (int)result)
+            *changed |= BIT(id);
+        universal_armoury_cache_update(armoury, id, result, source);
+    } else {
+        universal_armoury_cache_forget(armoury, id);
+    }
+
+    return ret;
+}
+
+/*
+ * Refresh states through the vendor bulk reader. *covered gets BIT(id) for
+ * every state the snapshot filled. A vendor reporting -ENODEV is not asked
+ * again. Caller holds armoury->lock.
+ */
+static int universal_armoury_bulk_refresh(struct universal_armoury *armoury,
+                                          unsigned long *covered,
+                                          unsigned long *changed,
+                                          enum armoury_event_source source)
+{
+    const struct armoury_vendor_ops *ops = armoury->desc->ops;
+    struct armoury_state_snapshot snap = { };
+    int i, ret;
+
+    *covered = 0;
+    if (!ops || !ops->read_all || armoury->bulk_read_broken)
+        return -EOPNOTSUPP;
+
+    ret = ops->read_all(armoury, &snap);
+    if (ret) {
+        if (ret == -ENODEV) {
+            dev_info(&armoury->acpi_dev->dev, "Bulk state read not available, using per-method reads\n");
+            armoury->bulk_read_broken = true;
+        }
+        return ret;
+    }
+
+    for (i = 0; i < ARMOURY_STATE_COUNT; i++) {
+        if (!(snap.valid & BIT(i)) || !armoury_state_supported(armoury, i))
+            continue;
+        if (*armoury_state_ptr(armoury, i) != snap.values[i])
+            *changed |= BIT(i);
+        universal_armoury_cache_update(armoury, i, snap.values[i], source);
+        *covered |= BIT(i);
+    }
+
+    return 0;
+}
+
+/*
+ * Refresh every supported state outside @skip from firmware regardless of
+ * cache age, in a single round trip when the vendor has a bulk reader and
+ * nothing is skipped. Caller holds armoury->lock.
+ */
+static void universal_armoury_refresh_mask(struct universal_armoury *armoury,
+                                           unsigned long skip,
+                                           unsigned long *changed,
+                                           enum armoury_event_source source)
+{
+    unsigned long covered = 0;
+    int i;
+
+    *changed = 0;
+    atomic_long_inc(&armoury->cache_misses);
+    /* The bulk reader may evaluate the skipped getters too */
+    if (!skip)
+        universal_armoury_bulk_refresh(armoury, &covered, changed, source);
+
+    for (i = 0; i < ARMOURY_STATE_COUNT; i++) {
+        if ((covered & BIT(i)) || (skip & BIT(i)) ||
+            !armoury_state_supported(armoury, i) ||
+            !armoury_state_get_method(armoury, i)->handle)
+            continue;
+        universal_armoury_read_state(armoury, i, changed, source);
+    }
+}
+
+/*
+ * As universal_armoury_refresh_mask(), leaving out getters that would wake a
+ * runtime-suspended dGPU. Returns the states that were left out.
+ */
+static unsigned long universal_armoury_refresh_all(struct universal_armoury *armoury,
+                                                   unsigned long *changed,
+                                                   enum armoury_event_source source)
+{
+    unsigned long skip = armoury_dgpu_wake_mask(armoury);
+
+    universal_armoury_refresh_mask(armoury, skip, changed, source);
+    return skip;
+}
+
+/* True while a cached read of @id may be served without firmware */
+static bool armoury_cache_fresh(struct universal_armoury *armoury,
+                                enum armoury_state_id id)
+{
+    struct armoury_state_cache *entry = &armoury->cache[id];
+    unsigned int ttl = READ_ONCE(cache_ttl_ms);
+
+    return ttl && entry->valid &&
+           time_before(jiffies, entry->updated + msecs_to_jiffies(ttl));
+}
+
+/*
+ * Sample a cached state without armoury->lock. Returns true if it may be
+ * served; *seen tells whether it ever held a value.
+ */
+static bool universal_armoury_cached_peek(struct universal_armoury *armoury,
+                                          enum armoury_state_id id, u32 *value,
+                                          bool *seen)
+{
+    unsigned int seq;
+    bool fresh;
+
+    do {
+        seq = read_seqcount_begin(&armoury->cache_seq);
+        fresh = armoury_cache_fresh(armoury, id);
+        *seen = armoury->cache[id].seen;
+        *value = *armoury_state_ptr(armoury, id);
+    } while (read_seqcount_retry(&armoury->cache_seq, seq));
+
+    return fresh;
+}
+
+/*
+ * Read a state, served from cache while it is within cache_ttl_ms. Hits do
+ * not take armoury->lock, so they never wait behind a firmware call. A miss
+ * refreshes every state at once when the vendor supports bulk reads, so
+ * reading the other attributes right after hits the cache. States whose
+ * getter would wake a sleeping dGPU keep their last value until it is up.
+ */
+static int universal_armoury_cached_get(struct universal_armoury *armoury,
+                                        enum armoury_state_id id, u32 *value)
+{
+    unsigned long covered, changed = 0, skip;
+    bool seen;
+    int ret = 0;
+
+    if (universal_armoury_cached_peek(armoury, id, value, &seen)) {
+        atomic_long_inc(&armoury->cache_hits);
+        return 0;
+    }
+
+    skip = armoury_dgpu_wake_mask(armoury);
+    if ((skip & BIT(id)) && seen) {
+        /* The dGPU is asleep, so the last value still holds */
+        atomic_long_inc(&armoury->dgpu_reads_avoided);
+        return 0;
+    }
+
+    mutex_lock(&armoury->lock);
+    /* Another reader may have refreshed it while we waited */
+    if (armoury_cache_fresh(armoury, id)) {
+        *value = *armoury_state_ptr(armoury, id);
+        mutex_unlock(&armoury->lock);
+        atomic_long_inc(&armoury->cache_hits);
+        return 0;
+    }
+
+    atomic_long_inc(&armoury->cache_misses);
+    if (skip ||
+        universal_armoury_bulk_refresh(armoury, &covered, &changed, ARMOURY_SRC_FIRMWARE) ||
+        !(covered & BIT(id)))
+        ret = universal_armoury_read_state(armoury, id, &changed, ARMOURY_SRC_FIRMWARE);
+    if (!ret)
+        *value = *armoury_state_ptr(armoury, id);
+    mutex_unlock(&armoury->lock);
+
+    return ret;
+}
+
+/* Run the firmware setter for a state; caller holds armoury->lock */
+static int __universal_armoury_set_state(struct universal_armoury *armoury,
+                                         enum armoury_state_id id, int value,
+                                         enum armoury_event_source source)
+{
+    int ret;
+
+    ret = universal_armoury_acpi_evaluate_method(armoury,
+                                               armoury_state_set_method(armoury, id),
+                                               value, NULL);
+    if (!ret) {
+        /* Re-read on the next show, but remember what was written */
+        universal_armoury_cache_store(armoury, id, value, false, source);
+    } else {
+        universal_armoury_cache_forget(armoury, id);
+    }
+
+    return ret;
+}
+
+/* Run the firmware setter for a state in the caller's context */
+static int universal_armoury_set_state(struct universal_armoury *armoury,
+                                       enum armoury_state_id id, int value,
+                                       enum armoury_event_source source)
+{
+    int ret;
+
+    mutex_lock(&armoury->lock);
+    ret = __universal_armoury_set_state(armoury, id, value, source);
+    mutex_unlock(&armoury->lock);
+
+    return ret;
+}
+
+/* Caller holds lock */
+static void armoury_switch_track_add(struct universal_armoury *armoury,
+                                     struct armoury_switch_track *track, u64 gen)
+{
+    struct armoury_switch_track *pos;
+
+    track->gen = gen;
+    /* Usually the newest, so walk back from the tail */
+    list_for_each_entry_reverse(pos, &armoury->switch_inflight, node) {
+        if (pos->gen < gen)
+            break;
+    }
+    list_add(&track->node, &pos->node);
+}
+
+/*
+ * Caller holds lock. Coalescing windows complete out of acceptance order, so
+ * the completed mark only advances up to the oldest switch still outstanding.
+ */
+static void armoury_switch_update_done(struct universal_armoury *armoury)
+{
+    struct armoury_switch_track *first;
+
+    first = list_first_entry_or_null(&armoury->switch_inflight,
+                                     struct armoury_switch_track, node);
+    armoury->switch_gen_done = first ? first->gen - 1 : armoury->switch_gen_queued;
+}
+
+/*
+ * Publish the result of a deferred switch through switch_status and netlink.
+ * @pw is the coalescing slot that completed, NULL for a queued switch.
+ */
+static void universal_armoury_switch_done(struct universal_armoury *armoury,
+                                          struct armoury_switch_track *track,
+                                          struct armoury_pending_write *pw,
+                                          enum armoury_state_id id, int value,
+                                          u64 gen, u64 queued_ns, int ret)
+{
+    struct armoury_genl_event ev = {
+        .cmd = ARMOURY_CMD_SWITCH_DONE,
+        .source = ARMOURY_SRC_ASYNC,
+        .latency_ns = ktime_get_ns() - queued_ns,
+        .id = id,
+        .new_value = value,
+        .gen = gen,
+        .err = ret,
+    };
+
+    if (ret)
+        dev_warn(&armoury->acpi_dev->dev, "Asynchronous switch %llu failed: %d\n",
+                 gen, ret);
+
+    mutex_lock(&armoury->lock);
+    list_del(&track->node);
+    if (pw) {
+        /* Writes accepted while the setter ran opened a new window */
+        pw->tracked = pw->pending;
+        if (pw->tracked)
+            armoury_switch_track_add(armoury, track, pw->first_gen);
+    }
+    armoury_switch_update_done(armoury);
+    armoury->switch_err = ret;
+    mutex_unlock(&armoury->lock);
+
+    sysfs_notify(&armoury->acpi_dev->dev.kobj, NULL, "switch_status");
+    universal_armoury_genl_event(armoury, &ev);
+}
+
+/* Run the device's queued setters in the order they were accepted */
+static void universal_armoury_switch_work(struct work_struct *work)
+{
+    struct universal_armoury *armoury = container_of(work, struct universal_armoury,
+                                                     switch_work);
+    struct armoury_switch_req *req;
+    int ret;
+
+    for (;;) {
+        mutex_lock(&armoury->lock);
+        req = list_first_entry_or_null(&armoury->switch_reqs,
+                                       struct armoury_switch_req, node);
+        if (req)
+            list_del(&req->node);
+        mutex_unlock(&armoury->lock);
+        if (!req)
+            break;
+
+        ret = universal_armoury_set_state(armoury, req->id, req->value, ARMOURY_SRC_ASYNC);
+        universal_armoury_switch_done(armoury, &req->track, NULL, req->id, req->value,
+                                      req->gen, req->queued_ns, ret);
+        kfree(req);
+    }
+}
+
+/*
+ * Hand a setter to the device's switch work and return at once. Generations
+ * are assigned under the lock together with queueing, so completions are
+ * reported in the order the writes were accepted, and flushing switch_work
+ * waits for all of them.
+ */
+static int universal_armoury_queue_switch(struct universal_armoury *armoury,
+                                          enum armoury_state_id id, int value)
+{
+    struct armoury_switch_req *req;
+
+    req = kzalloc(sizeof(*req), GFP_KERNEL);
+    if (!req)
+        return -ENOMEM;
+
+    req->id = id;
+    req->value = value;
+    req->queued_ns = ktime_get_ns();
+
+    mutex_lock(&armoury->lock);
+    req->gen = ++armoury->switch_gen_queued;
+    armoury_switch_track_add(armoury, &req->track, req->gen);
+    list_add_tail(&req->node, &armoury->switch_reqs);
+    queue_work(universal_armoury_wq, &armoury->switch_work);
+    mutex_unlock(&armoury->lock);
+
+    return 0;
+}
+
+/* Commit the last value written during a coalescing window */
+static void universal_armoury_coalesce_work(struct work_struct *work)
+{
+    struct armoury_pending_write *pw = container_of(to_delayed_work(work),
+                                                    struct armoury_pending_write, work);
+    struct universal_armoury *armoury = pw->armoury;
+    bool skip;
+    int value, ret = 0;
+    u64 gen, queued_ns;
+
+    mutex_lock(&armoury->lock);
+    value = pw->value;
+    gen = pw->gen;
+    queued_ns = pw->queued_ns;
+    pw->pending = false;
+    skip = armoury_state_matches(armoury, pw->id, value);
+    mutex_unlock(&armoury->lock);
+
+    if (skip)
+        atomic_long_inc(&armoury->writes_short_circuited);
+    else
+        ret = universal_armoury_set_state(armoury, pw->id, value, ARMOURY_SRC_ASYNC);
+
+    universal_armoury_switch_done(armoury, &pw->track, pw, pw->id, value, gen,
+                                  queued_ns, ret);
+}
+
+/*
+ * Store path. Writes of the value firmware already holds are dropped. With a
+ * coalescing window, writes are parked per state and only the last value
+ * reaches firmware once the window closes; the result is reported through
+ * switch_status like an asynchronous switch.
+ */
+static int universal_armoury_store_state(struct universal_armoury *armoury,
+                                         enum armoury_state_id id, int value)
+{
+    unsigned int window = READ_ONCE(coalesce_ms);
+    struct armoury_pending_write *pw = &armoury->pending[id];
+
+    mutex_lock(&armoury->lock);
+    if (window) {
+        pw->value = value;
+        pw->gen = ++armoury->switch_gen_queued;
+        if (pw->pending) {
+            atomic_long_inc(&armoury->writes_coalesced);
+        } else {
+            pw->queued_ns = ktime_get_ns();
+            pw->first_gen = pw->gen;
+        }
+        /* Stays tracked until a commit covering first_gen completes */
+        if (!pw->tracked) {
+            armoury_switch_track_add(armoury, &pw->track, pw->first_gen);
+            pw->tracked = true;
+        }
+        pw->pending = true;
+        mod_delayed_work(universal_armoury_wq, &pw->work, msecs_to_jiffies(window));
+        mutex_unlock(&armoury->lock);
+        return 0;
+    }
+
+    /* A pending or queued switch may still change the state */
+    if (!pw->pending && armoury->switch_gen_queued == armoury->switch_gen_done &&
+        armoury_state_matches(armoury, id, value)) {
+        mutex_unlock(&armoury->lock);
+        atomic_long_inc(&armoury->writes_short_circuited);
+        return 0;
+    }
+    mutex_unlock(&armoury->lock);
+
+    if (READ_ONCE(async_writes))
+        return universal_armoury_queue_switch(armoury, id, value);
+    return universal_armoury_set_state(armoury, id, value, ARMOURY_SRC_USER);
+}
+
+/*
+ * Pre-bind filter: true if @adev has a getter of @desc or any known getter.
+ * Only namespace lookups, no AML runs, so generic IDs such as PNP0C02 are
+ * cheap to reject.
+ */
+static bool universal_armoury_node_has_methods(struct acpi_device *adev,
+                                               const struct armoury_vendor_desc *desc)
+{
+    acpi_handle handle;
+    int i;
+
+    for (i = 0; i < ARMOURY_STATE_COUNT; i++) {
+        if ((desc->features & BIT(i)) && desc->get_methods[i] &&
+            ACPI_SUCCESS(acpi_get_handle(adev->handle, desc->get_methods[i], &handle)))
+            return true;
+    }
+
+    for (i = 0; i < ARMOURY_NR_CAP_PAIRS; i++) {
+        if (universal_armoury_cap_pairs[i].id >= 0 &&
+            ACPI_SUCCESS(acpi_get_handle(adev->handle, universal_armoury_cap_pairs[i].get,
+                                         &handle)))
+            return true;
+    }
+
+    return false;
+}
+
+/*
+ * Decide which states the device offers from method presence alone. No AML
+ * runs here; the first evaluation happens in universal_armoury_probe_features.
+ */
+static void universal_armoury_detect_features(struct universal_armoury *armoury)
+{
+    dev_info(&armoury->acpi_dev->dev, "Detected %s laptop: %s %s\n",
+             armoury->desc->name, armoury->vendor_name, armoury->product_name);
+
+    armoury->gpu_mux_supported = armoury->get_gpu_mux_method.handle;
+    armoury->dgpu_disable_supported = armoury->get_dgpu_disable_method.handle;
+    armoury->egpu_supported = armoury->get_egpu_enable_method.handle;
+
+    if (!armoury->gpu_mux_supported && !armoury->dgpu_disable_supported && !armoury->egpu_supported) {
+        /* Fall back to any known pair the namespace walk found */
+        const struct armoury_cap_pair *pair;
+        const struct armoury_capability *cap;
+        struct armoury_method *get, *set;
+        bool *supported;
+        int i;
+        
+        dev_warn(&armoury->acpi_dev->dev, "No supported features found. Trying alternative ACPI methods...\n");
+        
+        for (i = 0; i < ARMOURY_NR_CAP_PAIRS; i++) {
+            pair = &universal_armoury_cap_pairs[i];
+            cap = &armoury->caps[i];
+            /* Getters are passed one integer argument at most */
+            if (pair->id < 0 || !cap->get_handle || cap->get_args > 1)
+                continue;
+            supported = armoury_state_support_flag(armoury, pair->id);
+            if (*supported)
+                continue;
+
+            get = armoury_state_get_method(armoury, pair->id);
+            set = armoury_state_set_method(armoury, pair->id);
+            get->name = pair->get;
+            get->handle = cap->get_handle;
+            set->name = cap->set_handle && cap->set_args >= 1 ? pair->set : NULL;
+            set->handle = set->name ? cap->set_handle : NULL;
+            *supported = true;
+            dev_info(&armoury->acpi_dev->dev, "Found ACPI methods for %s: %s/%s\n",
+                     pair->label, pair->get, set->name ?: "-");
+        }
+    }
+}
+
+/*
+ * Capability cache: one record per bound device, as
+ *   sys_vendor|product_name|bios_version|device|supported|flags
+ * with supported a mask of validated states, fan curves and power limits.
+ * Records are separated by newlines or ';' and '#' starts a comment.
+ * debugfs capcache prints the records of the running system in this format.
+ */
+#define ARMOURY_CAPCACHE_FIELDS        6
+#define ARMOURY_CAPCACHE_NO_BULK       BIT(0)   /* vendor bulk read unavailable */
+#define ARMOURY_CAPCACHE_BIOS          BIT(1)   /* supported has the bits below */
+#define ARMOURY_CAPCACHE_FAN_SHIFT     8        /* BIT(8 + fan): fan curve */
+#define ARMOURY_CAPCACHE_POWER_SHIFT   12       /* BIT(12 + limit): power limit */
+#define ARMOURY_CAPCACHE_STATES        GENMASK(ARMOURY_STATE_COUNT - 1, 0)
+
+static_assert(ARMOURY_STATE_COUNT <= ARMOURY_CAPCACHE_FAN_SHIFT);
+static_assert(ARMOURY_CAPCACHE_FAN_SHIFT + ARMOURY_FAN_COUNT <= ARMOURY_CAPCACHE_POWER_SHIFT);
+
+/*
+ * Find the record for this device. Returns 0 and fills @mask/@flags on a
+ * match, -ESTALE if a record exists for another BIOS version, -ENOENT if
+ * there is none.
+ */
+static int armoury_capcache_find(struct universal_armoury *armoury,
+                                 const char *data, size_t len,
+                                 unsigned long *mask, unsigned int *flags)
+{
+    struct device *dev = &armoury->acpi_dev->dev;
+    char *field[ARMOURY_CAPCACHE_FIELDS];
+    char *copy, *cur, *line;
+    int i, ret = -ENOENT;
+
+    copy = kmemdup_nul(data, len, GFP_KERNEL);
+    if (!copy)
+        return -ENOMEM;
+
+    cur = copy;
+    while ((line = strsep(&cur, ";\n"))) {
+        line = strim(line);
+        if (!*line || *line == '#')
+            continue;
+
+        for (i = 0; i < ARMOURY_CAPCACHE_FIELDS && line; i++)
+            field[i] = strsep(&line, "|");
+        if (i < ARMOURY_CAPCACHE_FIELDS)
+            continue;
+
+        if (strcmp(field[0], armoury->vendor_name) ||
+            strcmp(field[1], armoury->product_name) ||
+            strcmp(field[3], dev_name(dev)))
+            continue;
+
+        if (strcmp(field[2], armoury->bios_version)) {
+            dev_info(dev, "Cached capabilities are for BIOS %s, running %s, revalidating\n",
+                     field[2], armoury->bios_version);
+            ret = -ESTALE;
+            continue;
+        }
+
+        if (kstrtoul(field[4], 0, mask) || kstrtouint(field[5], 0, flags)) {
+            dev_warn(dev, "Malformed capability cache record ignored\n");
+            continue;
+        }
+        ret = 0;
+        break;
+    }
+
+    kfree(copy);
+    return ret;
+}
+
+/* Look the device up in the capcache parameter or the firmware file */
+static int universal_armoury_capcache_load(struct universal_armoury *armoury,
+                                           unsigned long *mask, unsigned int *flags)
+{
+    const struct firmware *fw;
+    int ret;
+
+    if (capcache && *capcache)
+        return armoury_capcache_find(armoury, capcache, strlen(capcache), mask, flags);
+
+    ret = firmware_request_nowarn(&fw, ARMOURY_CAPCACHE_FW, &armoury->acpi_dev->dev);
+    if (ret)
+        return -ENOENT;
+
+    ret = armoury_capcache_find(armoury, (const char *)fw->data, fw->size, mask, flags);
+    release_firmware(fw);
+
+    return ret;
+}
+
+#ifdef ARMOURY_PLATFORM_PROFILE
+static const enum platform_profile_option armoury_profile_options[ARMOURY_PROFILE_COUNT] = {
+    [ARMOURY_PROFILE_LOW_POWER] = PLATFORM_PROFILE_LOW_POWER,
+    [ARMOURY_PROFILE_BALANCED] = PLATFORM_PROFILE_BALANCED,
+    [ARMOURY_PROFILE_PERFORMANCE] = PLATFORM_PROFILE_PERFORMANCE,
+};
+
+/* Read the thermal policy as ARMOURY_PROFILE_*; caller holds armoury->lock */
+static int universal_armoury_profile_read(struct universal_armoury *armoury,
+                                          int *profile)
+{
+    const struct armoury_profile_desc *pd = armoury->desc->profile;
+    u32 status;
+    int i, ret;
+
+    ret = universal_armoury_acpi_evaluate_method(armoury, &armoury->bios_get_method,
+                                               pd->setting, &status);
+    if (ret)
+        return ret;
+
+    if (!(status & pd->presence))
+        return -ENODEV;
+
+    for (i = 0; i < ARMOURY_PROFILE_COUNT; i++) {
+        if ((status & pd->value_mask) == pd->values[i]) {
+            *profile = i;
+            return 0;
+        }
+    }
+
+    return -EPROTO;
+}
+
+/* Called by platform_profile_register(), confirms the policy exists */
+static int armoury_profile_probe(void *drvdata, unsigned long *choices)
+{
+    struct universal_armoury *armoury = drvdata;
+    int i, profile, ret;
+
+    mutex_lock(&armoury->lock);
+    ret = universal_armoury_profile_read(armoury, &profile);
+    if (!ret)
+        WRITE_ONCE(armoury->profile, profile);
+    mutex_unlock(&armoury->lock);
+    if (ret)
+        return ret;
+
+    for (i = 0; i < ARMOURY_PROFILE_COUNT; i++)
+        set_bit(armoury_profile_options[i], choices);
+
+    return 0;
+}
+
+/* Served from the last value read or written, without a firmware call */
+static int armoury_profile_get(struct device *dev,
+                               enum platform_profile_option *profile)
+{
+    struct universal_armoury *armoury = dev_get_drvdata(dev);
+
+    *profile = armoury_profile_options[READ_ONCE(armoury->profile)];
+    return 0;
+}
+
+static int armoury_profile_set(struct device *dev,
+                               enum platform_profile_option option)
+{
+    struct universal_armoury *armoury = dev_get_drvdata(dev);
+    const struct armoury_profile_desc *pd = armoury->desc->profile;
+    u32 args[2];
+    int i, ret;
+
+    for (i = 0; i < ARMOURY_PROFILE_COUNT; i++) {
+        if (armoury_profile_options[i] == option)
+            break;
+    }
+    if (i == ARMOURY_PROFILE_COUNT)
+        return -EOPNOTSUPP;
+
+    args[0] = pd->setting;
+    args[1] = pd->values[i];
+
+    mutex_lock(&armoury->lock);
+    ret = universal_armoury_acpi_evaluate_args(armoury, &armoury->bios_set_method,
+                                               args, ARRAY_SIZE(args), NULL);
+    if (!ret)
+        WRITE_ONCE(armoury->profile, i);
+    mutex_unlock(&armoury->lock);
+
+    return ret;
+}
+
+static const struct platform_profile_ops armoury_profile_ops = {
+    .probe = armoury_profile_probe,
+    .profile_get = armoury_profile_get,
+    .profile_set = armoury_profile_set,
+};
+
+/*
+ * Offer the vendor thermal policy through platform_profile, if firmware has
+ * it. Called once probing finished. Not devm: the class device calls into
+ * result_buf, so remove() takes it down explicitly before freeing that.
+ */
+static void universal_armoury_profile_register(struct universal_armoury *armoury)
+{
+    struct device *dev = &armoury->acpi_dev->dev;
+    struct device *ppdev;
+
+    if (!armoury->desc->profile || !armoury->bios_get_method.handle ||
+        !armoury->bios_set_method.handle)
+        return;
+
+    ppdev = platform_profile_register(dev, DRIVER_NAME, armoury, &armoury_profile_ops);
+    if (IS_ERR(ppdev)) {
+        dev_info(dev, "Platform profile not available: %ld\n", PTR_ERR(ppdev));
+        return;
+    }
+
+    WRITE_ONCE(armoury->ppdev, ppdev);
+    dev_info(dev, "platform_profile control supported\n");
+}
+
+static void universal_armoury_profile_unregister(struct universal_armoury *armoury)
+{
+    struct device *ppdev = armoury->ppdev;
+
+    if (!ppdev)
+        return;
+
+    WRITE_ONCE(armoury->ppdev, NULL);
+    platform_profile_remove(ppdev);
+}
+
+/* Pick up a policy changed behind our back, e.g. by a hotkey */
+static void universal_armoury_profile_refresh(struct universal_armoury *armoury)
+{
+    struct device *ppdev = READ_ONCE(armoury->ppdev);
+    bool changed;
+    int profile;
+
+    if (!ppdev)
+        return;
+
+    mutex_lock(&armoury->lock);
+    changed = !universal_armoury_profile_read(armoury, &profile) &&
+              profile != armoury->profile;
+    if (changed)
+        WRITE_ONCE(armoury->profile, profile);
+    mutex_unlock(&armoury->lock);
+
+    if (changed)
+        platform_profile_notify(ppdev);
+}
+#else
+static inline void universal_armoury_profile_register(struct universal_armoury *armoury) { }
+static inline void universal_armoury_profile_unregister(struct universal_armoury *armoury) { }
+static inline void universal_armoury_profile_refresh(struct universal_armoury *armoury) { }
+#endif
+
+static const char * const armoury_fan_names[ARMOURY_FAN_COUNT] = {
+    [ARMOURY_FAN_CPU] = "cpu",
+    [ARMOURY_FAN_GPU] = "gpu",
+};
+
+static_assert(sizeof(struct armoury_fan_curve) == 2 * ARMOURY_FAN_CURVE_POINTS);
+
+/* Read the curve of @fan; caller holds armoury->lock */
+static int universal_armoury_fan_curve_read(struct universal_armoury *armoury,
+                                            enum armoury_fan fan,
+                                            struct armoury_fan_curve *curve)
+{
+    u32 setting = armoury->desc->fan_curves->settings[fan];
+
+    return universal_armoury_acpi_evaluate_buf(armoury, &armoury->bios_get_method,
+                                               &setting, 1, (u8 *)curve, sizeof(*curve));
+}
+
+/*
+ * Upload a whole curve in one call: the selector, then temperatures and
+ * duties packed four points per word, first point in the low byte.
+ * Caller holds armoury->lock.
+ */
+static int universal_armoury_fan_curve_write(struct universal_armoury *armoury,
+                                             enum armoury_fan fan,
+                                             const struct armoury_fan_curve *curve)
+{
+    u32 args[1 + ARMOURY_FAN_CURVE_POINTS / 2] = { 0 };
+    int i;
+
+    args[0] = armoury->desc->fan_curves->settings[fan];
+    for (i = 0; i < ARMOURY_FAN_CURVE_POINTS; i++) {
+        args[1 + i / 4] |= (u32)curve->temp[i] << (8 * (i % 4));
+        args[1 + (ARMOURY_FAN_CURVE_POINTS + i) / 4] |= (u32)curve->duty[i] << (8 * (i % 4));
+    }
+
+    return universal_armoury_acpi_evaluate_args(armoury, &armoury->bios_set_method,
+                                                args, ARRAY_SIZE(args), NULL);
+}
+
+/* Keep the curve firmware boots with, for fan_curve_reset; caller holds the lock */
+static void universal_armoury_fan_curve_probe(struct universal_armoury *armoury)
+{
+    const struct armoury_fan_curve_desc *fd = armoury->desc->fan_curves;
+    int i;
+
+    if (!fd || !armoury->bios_get_method.handle || !armoury->bios_set_method.handle)
+        return;
+
+    for (i = 0; i < ARMOURY_FAN_COUNT; i++) {
+        if (!fd->settings[i] ||
+            universal_armoury_fan_curve_read(armoury, i, &armoury->fan_default[i]))
+            continue;
+        armoury->fan_default_saved |= BIT(i);
+        armoury->fan_curves |= BIT(i);
+        dev_info(&armoury->acpi_dev->dev, "%s fan curve control supported\n",
+                 armoury_fan_names[i]);
+    }
+}
+
+/*
+ * Without a probe read (capability cache hit) the boot curve is read right
+ * before the first upload replaces it. Caller holds armoury->lock.
+ */
+static int armoury_fan_default_save(struct universal_armoury *armoury, enum armoury_fan fan)
+{
+    int ret;
+
+    if (armoury->fan_default_saved & BIT(fan))
+        return 0;
+
+    ret = universal_armoury_fan_curve_read(armoury, fan, &armoury->fan_default[fan]);
+    if (!ret)
+        armoury->fan_default_saved |= BIT(fan);
+    return ret;
+}
+
+/* Parse "temp:duty" for every point; temperatures rise, duties never fall */
+static int armoury_fan_curve_parse(const char *buf, struct armoury_fan_curve *curve)
+{
+    unsigned int temp, duty;
+    int i, n;
+
+    for (i = 0; i < ARMOURY_FAN_CURVE_POINTS; i++) {
+        if (sscanf(buf, " %u:%u%n", &temp, &duty, &n) != 2)
+            return -EINVAL;
+        buf += n;
+
+        if (temp > ARMOURY_FAN_TEMP_MAX || duty > ARMOURY_FAN_DUTY_MAX)
+            return -ERANGE;
+        if (i && (temp <= curve->temp[i - 1] || duty < curve->duty[i - 1]))
+            return -EINVAL;
+        curve->temp[i] = temp;
+        curve->duty[i] = duty;
+    }
+
+    return *skip_spaces(buf) ? -EINVAL : 0;
+}
+
+static const char * const armoury_power_names[ARMOURY_POWER_COUNT] = {
+    [ARMOURY_POWER_PL1_SPL] = "ppt_pl1_spl",
+    [ARMOURY_POWER_PL2_SPPT] = "ppt_pl2_sppt",
+    [ARMOURY_POWER_FPPT] = "ppt_fppt",
+    [ARMOURY_POWER_DYN_BOOST] = "nv_dynamic_boost",
+};
+
+/* Read a power limit in watts; caller holds armoury->lock */
+static int universal_armoury_power_read(struct universal_armoury *armoury,
+                                        enum armoury_power_id id, u32 *value)
+{
+    const struct armoury_power_desc *pd = armoury->desc->power;
+    u32 status;
+    int ret;
+
+    ret = universal_armoury_acpi_evaluate_method(armoury, &armoury->bios_get_method,
+                                               pd->settings[id], &status);
+    if (ret)
+        return ret;
+    if (!(status & pd->presence))
+        return -ENODEV;
+
+    *value = status & pd->value_mask;
+    return 0;
+}
+
+/* Caller holds armoury->lock and has checked the range */
+static int universal_armoury_power_write(struct universal_armoury *armoury,
+                                         enum armoury_power_id id, u32 value)
+{
+    u32 args[2] = { armoury->desc->power->settings[id], value };
+
+    return universal_armoury_acpi_evaluate_args(armoury, &armoury->bios_set_method,
+                                                args, ARRAY_SIZE(args), NULL);
+}
+
+/* Keep the limits firmware reports as present; caller holds armoury->lock */
+static void universal_armoury_power_probe(struct universal_armoury *armoury)
+{
+    const struct armoury_power_desc *pd = armoury->desc->power;
+    u32 value;
+    int i;
+
+    if (!pd || !armoury->bios_get_method.handle || !armoury->bios_set_method.handle)
+        return;
+
+    for (i = 0; i < ARMOURY_POWER_COUNT; i++) {
+        if (!pd->settings[i] || universal_armoury_power_read(armoury, i, &value))
+            continue;
+        armoury->power_limits |= BIT(i);
+        dev_info(&armoury->acpi_dev->dev, "%s control supported (%u W)\n",
+                 armoury_power_names[i], value);
+    }
+}
+
+/* Fan curve and power limit bits, in capability cache layout, the descriptor allows */
+static unsigned long armoury_capcache_bios_possible(struct universal_armoury *armoury)
+{
+    const struct armoury_fan_curve_desc *fd = armoury->desc->fan_curves;
+    const struct armoury_power_desc *pd = armoury->desc->power;
+    unsigned long mask = 0;
+    int i;
+
+    if (!armoury->bios_get_method.handle || !armoury->bios_set_method.handle)
+        return 0;
+
+    for (i = 0; fd && i < ARMOURY_FAN_COUNT; i++) {
+        if (fd->settings[i])
+            mask |= BIT(ARMOURY_CAPCACHE_FAN_SHIFT + i);
+    }
+    for (i = 0; pd && i < ARMOURY_POWER_COUNT; i++) {
+        if (pd->settings[i])
+            mask |= BIT(ARMOURY_CAPCACHE_POWER_SHIFT + i);
+    }
+
+    return mask;
+}
+
+/*
+ * First firmware read of every detected state, in one bulk call where the
+ * vendor allows. A state whose getter fails is dropped. Runs once, from the
+ * probe work item or from whichever user needs the device first, and
+ * publishes the final capabilities through supported_features and netlink.
+ * A capability cache record for this BIOS replaces the reads; states are
+ * then read on first use. Records from before fan curves and power limits
+ * were cached (no ARMOURY_CAPCACHE_BIOS) still probe those.
+ */
+static void universal_armoury_probe_features(struct universal_armoury *armoury)
+{
+    struct device *dev = &armoury->acpi_dev->dev;
+    struct armoury_genl_event ev = {
+        .cmd = ARMOURY_CMD_PROBE,
+        .source = ARMOURY_SRC_PROBE,
+    };
+    unsigned long changed, detected = 0, mask = 0, skipped = 0;
+    unsigned int flags = 0;
+    bool cached;
+    u64 start;
+    int i;
+
+    if (smp_load_acquire(&armoury->probed))
+        return;
+
+    start = ktime_get_ns();
+    cached = !universal_armoury_capcache_load(armoury, &mask, &flags);
+
+    mutex_lock(&armoury->lock);
+    if (armoury->probed) {
+        mutex_unlock(&armoury->lock);
+        return;
+    }
+
+    for (i = 0; i < ARMOURY_STATE_COUNT; i++) {
+        if (armoury_state_supported(armoury, i))
+            detected |= BIT(i);
+    }
+
+    /* A record naming methods this node lacks is out of date */
+    if (cached && ((mask & ARMOURY_CAPCACHE_STATES & ~detected) ||
+                   (mask & ~ARMOURY_CAPCACHE_STATES &
+                    ~armoury_capcache_bios_possible(armoury)))) {
+        dev_info(dev, "Cached capabilities do not match the firmware, revalidating\n");
+        cached = false;
+    }
+
+    if (cached) {
+        armoury->bulk_read_broken = flags & ARMOURY_CAPCACHE_NO_BULK;
+    } else {
+        skipped = universal_armoury_refresh_all(armoury, &changed, ARMOURY_SRC_PROBE);
+    }
+
+    for (i = 0; i < ARMOURY_STATE_COUNT; i++) {
+        if (!(detected & BIT(i)))
+            continue;
+        /* Getters not run to spare the dGPU are verified on first read */
+        if (cached ? !(mask & BIT(i)) :
+                     !armoury->cache[i].known && !(skipped & BIT(i))) {
+            dev_info(dev, "%s %s, disabling\n", armoury_state_attr_names[i],
+                     cached ? "not in capability cache" : "getter not responding");
+            *armoury_state_support_flag(armoury, i) = false;
+            continue;
+        }
+        dev_info(dev, "%s control supported\n", armoury_state_attr_names[i]);
+        ev.supported |= BIT(i);
+    }
+    if (cached && (flags & ARMOURY_CAPCACHE_BIOS)) {
+        armoury->fan_curves = (mask >> ARMOURY_CAPCACHE_FAN_SHIFT) &
+                              GENMASK(ARMOURY_FAN_COUNT - 1, 0);
+        armoury->power_limits = (mask >> ARMOURY_CAPCACHE_POWER_SHIFT) &
+                                GENMASK(ARMOURY_POWER_COUNT - 1, 0);
+    } else {
+        universal_armoury_fan_curve_probe(armoury);
+        universal_armoury_power_probe(armoury);
+    }
+
+    /* Default governor policy: dGPU off on battery */
+    if (armoury_state_supported(armoury, ARMOURY_STATE_DGPU_DISABLE)) {
+        armoury->gov_policy = BIT(ARMOURY_STATE_DGPU_DISABLE);
+        armoury->gov_target[ARMOURY_STATE_DGPU_DISABLE] = 1;
+    }
+    ev.latency_ns = ktime_get_ns() - start;
+    /* Pairs with the acquire in universal_armoury_ensure_probed() */
+    smp_store_release(&armoury->probed, true);
+    mutex_unlock(&armoury->lock);
+
+    dev_info(dev, "Features probed in %llu us%s\n", div_u64(ev.latency_ns, NSEC_PER_USEC),
+             cached ? " (from capability cache)" : "");
+    sysfs_notify(&dev->kobj, NULL, "supported_features");
+    universal_armoury_genl_event(armoury, &ev);
+    /* Its probe reads the policy, so it is not registered while binding */
+    universal_armoury_profile_register(armoury);
+}
+
+static void universal_armoury_update_visibility(struct universal_armoury *armoury);
+
+/* Also runs when a sysfs user probed first, to hide what probing ruled out */
+static void universal_armoury_probe_work(struct work_struct *work)
+{
+    struct universal_armoury *armoury = container_of(work, struct universal_armoury,
+                                                     probe_work);
+
+    universal_armoury_probe_features(armoury);
+    universal_armoury_update_visibility(armoury);
+}
+
+/* Finish probing in the caller if the work item has not run yet */
+static void universal_armoury_ensure_probed(struct universal_armoury *armoury)
+{
+    if (!smp_load_acquire(&armoury->probed))
+        universal_armoury_probe_features(armoury);
+}
+
+#ifdef ARMOURY_GOVERNOR
+/* Current value of a state for the governor; caller holds armoury->lock */
+static int armoury_governor_read(struct universal_armoury *armoury,
+                                 enum armoury_state_id id, int *value)
+{
+    unsigned long changed = 0;
+    int ret = 0;
+
+    if (!armoury_cache_fresh(armoury, id))
+        ret = universal_armoury_read_state(armoury, id, &changed, ARMOURY_SRC_FIRMWARE);
+    if (!ret)
+        *value = *armoury_state_ptr(armoury, id);
+
+    return ret;
+}
+
+/*
+ * The ACPI setters do not refuse to power off the dGPU while the MUX routes
+ * the panel through it, so the governor has to. 1 if blocked; caller holds
+ * the lock.
+ */
+static int armoury_governor_mux_blocks(struct universal_armoury *armoury,
+                                       enum armoury_state_id id)
+{
+    int mux, ret;
+
+    if (id != ARMOURY_STATE_DGPU_DISABLE || !armoury->gov_target[id] ||
+        !armoury_state_supported(armoury, ARMOURY_STATE_GPU_MUX))
+        return 0;
+
+    ret = armoury_governor_read(armoury, ARMOURY_STATE_GPU_MUX, &mux);
+    if (ret)
+        return ret;
+    if (mux != 1)
+        return 0;
+
+    armoury->gov_mux_blocked++;
+    return 1;
+}
+
+/* One state of a source change: 0 if written, 1 if left alone; caller holds the lock */
+static int armoury_governor_switch(struct universal_armoury *armoury,
+                                   enum armoury_state_id id, bool battery)
+{
+    int value, ret;
+
+    ret = armoury_governor_read(armoury, id, &value);
+    if (ret)
+        return ret;
+
+    if (battery) {
+        if (value == armoury->gov_target[id])
+            return 1;
+        ret = armoury_governor_mux_blocks(armoury, id);
+        if (ret)
+            return ret;
+        ret = __universal_armoury_set_state(armoury, id, armoury->gov_target[id],
+                                            ARMOURY_SRC_GOVERNOR);
+        if (ret)
+            return ret;
+        armoury->gov_saved[id] = value;
+        armoury->gov_applied[id] = armoury->gov_target[id];
+        armoury->gov_saved_mask |= BIT(id);
+        return 0;
+    }
+
+    /* Switched by hand while on battery, that choice stands */
+    if (value != armoury->gov_applied[id]) {
+        armoury->gov_saved_mask &= ~BIT(id);
+        return 1;
+    }
+    ret = __universal_armoury_set_state(armoury, id, armoury->gov_saved[id],
+                                        ARMOURY_SRC_GOVERNOR);
+    if (!ret)
+        armoury->gov_saved_mask &= ~BIT(id);
+    return ret;
+}
+
+/*
+ * Act on a power source change. Going to battery, the states in gov_policy
+ * are switched to their targets and the values they replaced remembered.
+ * Back on AC those values are written again, except where the state was
+ * switched by hand in between. Writes use the regular setter, one source
+ * change at a time from the ordered workqueue.
+ */
+static void universal_armoury_governor_apply(struct universal_armoury *armoury,
+                                             enum armoury_gov_source source)
+{
+    struct device *dev = &armoury->acpi_dev->dev;
+    bool battery = source == ARMOURY_GOV_BATTERY;
+    unsigned long todo, changed = 0;
+    int i, ret;
+
+    universal_armoury_ensure_probed(armoury);
+
+    mutex_lock(&armoury->lock);
+    if (source == armoury->gov_source)
+        goto out;
+    if (armoury->gov_locked) {
+        armoury->gov_skipped++;
+        goto out;
+    }
+    if (armoury->gov_source != ARMOURY_GOV_UNKNOWN)
+        armoury->gov_transitions++;
+    armoury->gov_source = source;
+
+    todo = battery ? armoury->gov_policy : armoury->gov_saved_mask;
+    for (i = 0; i < ARMOURY_STATE_COUNT; i++) {
+        if (!(todo & BIT(i)) || !armoury_state_supported(armoury, i))
+            continue;
+
+        ret = armoury_governor_switch(armoury, i, battery);
+        if (ret < 0) {
+            armoury->gov_failures++;
+            dev_warn(dev, "Governor could not switch %s on %s: %d\n",
+                     armoury_state_attr_names[i], battery ? "battery" : "AC", ret);
+        } else if (!ret) {
+            armoury->gov_writes++;
+            changed |= BIT(i);
+        }
+    }
+out:
+    mutex_unlock(&armoury->lock);
+
+    for (i = 0; i < ARMOURY_STATE_COUNT; i++) {
+        if (changed & BIT(i))
+            sysfs_notify(&dev->kobj, NULL, armoury_state_attr_names[i]);
+    }
+}
+
+static void universal_armoury_governor_work(struct work_struct *work)
+{
+    struct universal_armoury *armoury = container_of(to_delayed_work(work),
+                                                     struct universal_armoury, gov_work);
+    int supplied;
+
+    if (!READ_ONCE(gpu_governor))
+        return;
+
+    /* Negative without any power supply, e.g. on a desktop board */
+    supplied = power_supply_is_system_supplied();
+    if (supplied < 0)
+        return;
+
+    universal_armoury_governor_apply(armoury, supplied ? ARMOURY_GOV_AC : ARMOURY_GOV_BATTERY);
+}
+
+/* Atomic notifier: only (re)arm the hysteresis timer */
+static int universal_armoury_governor_notify(struct notifier_block *nb,
+                                             unsigned long event, void *data)
+{
+    struct universal_armoury *armoury = container_of(nb, struct universal_armoury, gov_nb);
+    struct power_supply *psy = data;
+
+    /* Battery capacity updates do not change the source */
+    if (event != PSY_EVENT_PROP_CHANGED || psy->desc->type == POWER_SUPPLY_TYPE_BATTERY ||
+        !READ_ONCE(gpu_governor))
+        return NOTIFY_DONE;
+
+    atomic_long_inc(&armoury->gov_events);
+    if (mod_delayed_work(universal_armoury_wq, &armoury->gov_work,
+                         msecs_to_jiffies(READ_ONCE(governor_delay_ms))))
+        atomic_long_inc(&armoury->gov_debounced);
+
+    return NOTIFY_OK;
+}
+
+static void universal_armoury_governor_register(struct universal_armoury *armoury)
+{
+    int ret;
+
+    armoury->gov_nb.notifier_call = universal_armoury_governor_notify;
+    ret = power_supply_reg_notifier(&armoury->gov_nb);
+    if (ret) {
+        dev_warn(&armoury->acpi_dev->dev, "GPU governor not available: %d\n", ret);
+        armoury->gov_nb.notifier_call = NULL;
+        return;
+    }
+
+    /* Settle on the source the machine started with */
+    if (READ_ONCE(gpu_governor))
+        mod_delayed_work(universal_armoury_wq, &armoury->gov_work, 0);
+}
+
+static void universal_armoury_governor_unregister(struct universal_armoury *armoury)
+{
+    if (armoury->gov_nb.notifier_call)
+        power_supply_unreg_notifier(&armoury->gov_nb);
+    cancel_delayed_work_sync(&armoury->gov_work);
+}
+
+/* Re-evaluate the source now, e.g. after the override was lifted */
+static void universal_armoury_governor_kick(struct universal_armoury *armoury)
+{
+    if (armoury->gov_nb.notifier_call && READ_ONCE(gpu_governor))
+        mod_delayed_work(universal_armoury_wq, &armoury->gov_work, 0);
+}
+
+/*
+ * Enabling the governor at runtime settles every device on the current
+ * source right away instead of at the next plug event. The source it last
+ * acted on may be out of date by then, so it is forgotten.
+ */
+static int gpu_governor_set(const char *val, const struct kernel_param *kp)
+{
+    struct universal_armoury *armoury;
+    bool was = READ_ONCE(gpu_governor);
+    int ret;
+
+    ret = param_set_bool(val, kp);
+    if (ret || was || !READ_ONCE(gpu_governor))
+        return ret;
+
+    mutex_lock(&universal_armoury_devs_lock);
+    list_for_each_entry(armoury, &universal_armoury_devices, node) {
+        mutex_lock(&armoury->lock);
+        armoury->gov_source = ARMOURY_GOV_UNKNOWN;
+        mutex_unlock(&armoury->lock);
+        universal_armoury_governor_kick(armoury);
+    }
+    mutex_unlock(&universal_armoury_devs_lock);
+
+    return 0;
+}
+
+static const struct kernel_param_ops gpu_governor_ops = {
+    .set = gpu_governor_set,
+    .get = param_get_bool,
+};
+module_param_cb(gpu_governor, &gpu_governor_ops, &gpu_governor, 0644);
+#else
+module_param(gpu_governor, bool, 0644);
+
+static void universal_armoury_governor_work(struct work_struct *work) { }
+static inline void universal_armoury_governor_register(struct universal_armoury *armoury) { }
+static inline void universal_armoury_governor_unregister(struct universal_armoury *armoury) { }
+static inline void universal_armoury_governor_kick(struct universal_armoury *armoury) { }
+#endif
+
+/* Common show path for the cached GPU states */
+static ssize_t armoury_state_show(struct device *dev, struct device_attribute *attr,
+                                  char *buf, enum armoury_state_id id)
+{
+    struct acpi_device *adev = to_acpi_device(dev);
+    struct universal_armoury *armoury = adev->driver_data;
+    u64 start = trace_armoury_attr_show_exit_enabled() ? ktime_get_ns() : 0;
+    u32 result = 0;
+    int ret;
+
+    trace_armoury_attr_show_enter(attr->attr.name);
+
+    if (armoury)
+        universal_armoury_ensure_probed(armoury);
+    if (!armoury || !armoury_state_supported(armoury, id) ||
+        !armoury_state_get_method(armoury, id)->handle)
+        ret = -ENODEV;
+    else
+        ret = universal_armoury_cached_get(armoury, id, &result);
+
+    trace_armoury_attr_show_exit(attr->attr.name, result, ret,
+                                 start ? ktime_get_ns() - start : 0);
+    if (ret)
+        return ret;
+
+    return scnprintf(buf, PAGE_SIZE, "%d\n", result);
+}
+
+/*
+ * Common store path: parse and range-check a value, then hand it on. Every
+ * call is bracketed by the enter/exit tracepoints; value is -1 in both when
+ * the input does not parse.
+ */
+static ssize_t armoury_state_store(struct device *dev, struct device_attribute *attr,
+                                   const char *buf, size_t count,
+                                   enum armoury_state_id id)
+{
+    struct acpi_device *adev = to_acpi_device(dev);
+    struct universal_armoury *armoury = adev->driver_data;
+    u64 start = trace_armoury_attr_store_exit_enabled() ? ktime_get_ns() : 0;
+    const struct armoury_value_range *range;
+    int value = -1, parsed = -EINVAL, ret;
+
+    if (buf && count)
+        parsed = kstrtoint(buf, 10, &value);
+    if (parsed)
+        value = -1;
+
+    trace_armoury_attr_store_enter(attr->attr.name, value);
+
+    if (armoury)
+        universal_armoury_ensure_probed(armoury);
+    if (!armoury || !armoury_state_supported(armoury, id) ||
+        !armoury_state_set_method(armoury, id)->handle) {
+        ret = -ENODEV;
+        goto out;
+    }
+
+    ret = parsed;
+    if (ret) {
+        dev_err(dev, "Invalid input for %s: %s\n", attr->attr.name, buf ? buf : "");
+        goto out;
+    }
+
+    range = &armoury->desc->ranges[id];
+    if (value < range->min || value > range->max) {
+        dev_err(dev, "%s value must be %d..%d, got: %d\n", attr->attr.name,
+                range->min, range->max, value);
+        ret = -EINVAL;
+    } else {
+        ret = universal_armoury_store_state(armoury, id, value);
+    }
+
+out:
+    trace_armoury_attr_store_exit(attr->attr.name, value, ret,
+                                  start ? ktime_get_ns() - start : 0);
+    if (ret)
+        return ret;
+
+    return count;
+}
+
+/* GPU MUX control */
+static ssize_t gpu_mux_show(struct device *dev,
+                          struct device_attribute *attr, char *buf)
+{
+    return armoury_state_show(dev, attr, buf, ARMOURY_STATE_GPU_MUX);
+}
+
+static ssize_t gpu_mux_store(struct device *dev,
+                           struct device_attribute *attr,
+                           const char *buf, size_t count)
+{
+    return armoury_state_store(dev, attr, buf, count, ARMOURY_STATE_GPU_MUX);
+}
+
+/* dGPU disable control */
+static ssize_t dgpu_disable_show(struct device *dev,
+                                struct device_attribute *attr, char *buf)
+{
+    return armoury_state_show(dev, attr, buf, ARMOURY_STATE_DGPU_DISABLE);
+}
+
+static ssize_t dgpu_disable_store(struct device *dev,
+                                 struct device_attribute *attr,
+                                 const char *buf, size_t count)
+{
+    return armoury_state_store(dev, attr, buf, count, ARMOURY_STATE_DGPU_DISABLE);
+}
+
+/* eGPU enable control */
+static ssize_t egpu_enable_show(struct device *dev,
+                               struct device_attribute *attr, char *buf)
+{
+    return armoury_state_show(dev, attr, buf, ARMOURY_STATE_EGPU_ENABLE);
+}
+
+static ssize_t egpu_enable_store(struct device *dev,
+                                struct device_attribute *attr,
+                                const char *buf, size_t count)
+{
+    return armoury_state_store(dev, attr, buf, count, ARMOURY_STATE_EGPU_ENABLE);
+}
+
+/* Device attributes */
+static DEVICE_ATTR_RW(gpu_mux);
+static DEVICE_ATTR_RW(dgpu_disable);
+static DEVICE_ATTR_RW(egpu_enable);
+
+/* Common show path for the fan curves, read from firmware every time */
+static ssize_t armoury_fan_curve_show(struct device *dev, char *buf, enum armoury_fan fan)
+{
+    struct acpi_device *adev = to_acpi_device(dev);
+    struct universal_armoury *armoury = adev->driver_data;
+    struct armoury_fan_curve curve;
+    ssize_t len = 0;
+    int i, ret;
+
+    if (!armoury)
+        return -ENODEV;
+    universal_armoury_ensure_probed(armoury);
+    if (!(armoury->fan_curves & BIT(fan)))
+        return -ENODEV;
+
+    mutex_lock(&armoury->lock);
+    ret = universal_armoury_fan_curve_read(armoury, fan, &curve);
+    mutex_unlock(&armoury->lock);
+    if (ret)
+        return ret;
+
+    for (i = 0; i < ARMOURY_FAN_CURVE_POINTS; i++)
+        len += scnprintf(buf + len, PAGE_SIZE - len, "%s%u:%u", i ? " " : "",
+                         curve.temp[i], curve.duty[i]);
+    len += scnprintf(buf + len, PAGE_SIZE - len, "\n");
+
+    return len;
+}
+
+/* The whole curve is validated first, then committed in one firmware call */
+static ssize_t armoury_fan_curve_store(struct device *dev, const char *buf,
+                                       size_t count, enum armoury_fan fan)
+{
+    struct acpi_device *adev = to_acpi_device(dev);
+    struct universal_armoury *armoury = adev->driver_data;
+    struct armoury_fan_curve curve;
+    int ret;
+
+    if (!armoury)
+        return -ENODEV;
+    universal_armoury_ensure_probed(armoury);
+    if (!(armoury->fan_curves & BIT(fan)))
+        return -ENODEV;
+
+    ret = armoury_fan_curve_parse(buf, &curve);
+    if (ret) {
+        dev_err(dev, "Invalid %s fan curve, expected %d rising temp:duty points\n",
+                armoury_fan_names[fan], ARMOURY_FAN_CURVE_POINTS);
+        return ret;
+    }
+
+    mutex_lock(&armoury->lock);
+    ret = armoury_fan_default_save(armoury, fan);
+    if (!ret)
+        ret = universal_armoury_fan_curve_write(armoury, fan, &curve);
+    mutex_unlock(&armoury->lock);
+    if (ret) {
+        dev_err(dev, "Failed to set %s fan curve: %d\n", armoury_fan_names[fan], ret);
+        return ret;
+    }
+
+    return count;
+}
+
+static ssize_t cpu_fan_curve_show(struct device *dev,
+                                  struct device_attribute *attr, char *buf)
+{
+    return armoury_fan_curve_show(dev, buf, ARMOURY_FAN_CPU);
+}
+
+static ssize_t cpu_fan_curve_store(struct device *dev, struct device_attribute *attr,
+                                   const char *buf, size_t count)
+{
+    return armoury_fan_curve_store(dev, buf, count, ARMOURY_FAN_CPU);
+}
+
+static ssize_t gpu_fan_curve_show(struct device *dev,
+                                  struct device_attribute *attr, char *buf)
+{
+    return armoury_fan_curve_show(dev, buf, ARMOURY_FAN_GPU);
+}
+
+static ssize_t gpu_fan_curve_store(struct device *dev, struct device_attribute *attr,
+                                   const char *buf, size_t count)
+{
+    return armoury_fan_curve_store(dev, buf, count, ARMOURY_FAN_GPU);
+}
+
+/* Put back the boot curves, one firmware call per fan the driver changed */
+static ssize_t fan_curve_reset_store(struct device *dev, struct device_attribute *attr,
+                                     const char *buf, size_t count)
+{
+    struct acpi_device *adev = to_acpi_device(dev);
+    struct universal_armoury *armoury = adev->driver_data;
+    int i, err, ret = 0;
+
+    if (!armoury)
+        return -ENODEV;
+    universal_armoury_ensure_probed(armoury);
+    if (!armoury->fan_curves)
+        return -ENODEV;
+
+    mutex_lock(&armoury->lock);
+    for (i = 0; i < ARMOURY_FAN_COUNT; i++) {
+        /* Not saved yet means not uploaded yet: firmware still has it */
+        if (!(armoury->fan_curves & armoury->fan_default_saved & BIT(i)))
+            continue;
+        err = universal_armoury_fan_curve_write(armoury, i, &armoury->fan_default[i]);
+        if (err) {
+            dev_err(dev, "Failed to reset %s fan curve: %d\n", armoury_fan_names[i], err);
+            ret = ret ?: err;
+        }
+    }
+    mutex_unlock(&armoury->lock);
+
+    if (ret)
+        return ret;
+    return count;
+}
+
+static DEVICE_ATTR_RW(cpu_fan_curve);
+static DEVICE_ATTR_RW(gpu_fan_curve);
+static DEVICE_ATTR_WO(fan_curve_reset);
+
+/* Common show path for the power limits, read from firmware every time */
+static ssize_t armoury_power_show(struct device *dev, char *buf, enum armoury_power_id id)
+{
+    struct acpi_device *adev = to_acpi_device(dev);
+    struct universal_armoury *armoury = adev->driver_data;
+    u32 value;
+    int ret;
+
+    if (!armoury)
+        return -ENODEV;
+    universal_armoury_ensure_probed(armoury);
+    if (!(armoury->power_limits & BIT(id)))
+        return -ENODEV;
+
+    mutex_lock(&armoury->lock);
+    ret = universal_armoury_power_read(armoury, id, &value);
+    mutex_unlock(&armoury->lock);
+    if (ret)
+        return ret;
+
+    return scnprintf(buf, PAGE_SIZE, "%u\n", value);
+}
+
+static ssize_t armoury_power_store(struct device *dev, const char *buf, size_t count,
+                                   enum armoury_power_id id)
+{
+    struct acpi_device *adev = to_acpi_device(dev);
+    struct universal_armoury *armoury = adev->driver_data;
+    const struct armoury_value_range *range;
+    int value, ret;
+
+    if (!armoury)
+        return -ENODEV;
+    universal_armoury_ensure_probed(armoury);
+    if (!(armoury->power_limits & BIT(id)))
+        return -ENODEV;
+
+    ret = kstrtoint(buf, 10, &value);
+    if (ret) {
+        dev_err(dev, "Invalid input for %s: %s\n", armoury_power_names[id], buf);
+        return ret;
+    }
+
+    range = &armoury->desc->power->ranges[id];
+    if (value < range->min || value > range->max) {
+        dev_err(dev, "%s value must be %d..%d, got: %d\n", armoury_power_names[id],
+                range->min, range->max, value);
+        return -EINVAL;
+    }
+
+    mutex_lock(&armoury->lock);
+    ret = universal_armoury_power_write(armoury, id, value);
+    mutex_unlock(&armoury->lock);
+    if (ret) {
+        dev_err(dev, "Failed to set %s: %d\n", armoury_power_names[id], ret);
+        return ret;
+    }
+
+    return count;
+}
+
+/* Bounds accepted by the store path */
+static ssize_t armoury_power_range_show(struct device *dev, char *buf,
+                                        enum armoury_power_id id, bool max)
+{
+    struct acpi_device *adev = to_acpi_device(dev);
+    struct universal_armoury *armoury = adev->driver_data;
+    const struct armoury_value_range *range;
+
+    if (!armoury)
+        return -ENODEV;
+    universal_armoury_ensure_probed(armoury);
+    if (!(armoury->power_limits & BIT(id)))
+        return -ENODEV;
+
+    range = &armoury->desc->power->ranges[id];
+    return scnprintf(buf, PAGE_SIZE, "%d\n", max ? range->max : range->min);
+}
+
+/* <name>, <name>_min and <name>_max for one power limit */
+#define ARMOURY_POWER_ATTRS(_name, _id)                                         \
+    static ssize_t _name##_show(struct device *dev,                             \
+                                struct device_attribute *attr, char *buf)       \
+    {                                                                           \
+        return armoury_power_show(dev, buf, _id);                               \
+    }                                                                           \
+    static ssize_t _name##_store(struct device *dev, struct device_attribute *attr, \
+                                 const char *buf, size_t count)                 \
+    {                                                                           \
+        return armoury_power_store(dev, buf, count, _id);                       \
+    }                                                                           \
+    static ssize_t _name##_min_show(struct device *dev,                         \
+                                    struct device_attribute *attr, char *buf)   \
+    {                                                                           \
+        return armoury_power_range_show(dev, buf, _id, false);                  \
+    }                                                                           \
+    static ssize_t _name##_max_show(struct device *dev,                         \
+                                    struct device_attribute *attr, char *buf)   \
+    {                                                                           \
+        return armoury_power_range_show(dev, buf, _id, true);                   \
+    }                                                                           \
+    static DEVICE_ATTR_RW(_name);                                               \
+    static DEVICE_ATTR_RO(_name##_min);                                         \
+    static DEVICE_ATTR_RO(_name##_max)
+
+ARMOURY_POWER_ATTRS(ppt_pl1_spl, ARMOURY_POWER_PL1_SPL);
+ARMOURY_POWER_ATTRS(ppt_pl2_sppt, ARMOURY_POWER_PL2_SPPT);
+ARMOURY_POWER_ATTRS(ppt_fppt, ARMOURY_POWER_FPPT);
+ARMOURY_POWER_ATTRS(nv_dynamic_boost, ARMOURY_POWER_DYN_BOOST);
+
+/* Vendor information attributes */
+static ssize_t vendor_show(struct device *dev,
+                         struct device_attribute *attr, char *buf)
+{
+    struct acpi_device *adev = to_acpi_device(dev);
+    struct universal_armoury *armoury = adev->driver_data;
+    if (!armoury || !armoury->vendor_name[0])
+        return scnprintf(buf, PAGE_SIZE, "Unknown\n");
+    return scnprintf(buf, PAGE_SIZE, "%s\n", armoury->vendor_name);
+}
+
+static ssize_t product_show(struct device *dev,
+                          struct device_attribute *attr, char *buf)
+{
+    struct acpi_device *adev = to_acpi_device(dev);
+    struct universal_armoury *armoury = adev->driver_data;
+    if (!armoury || !armoury->product_name[0])
+        return scnprintf(buf, PAGE_SIZE, "Unknown\n");
+    return scnprintf(buf, PAGE_SIZE, "%s\n", armoury->product_name);
+}
+
+/* Index used for this device by /dev/armoury and netlink events */
+static ssize_t instance_show(struct device *dev,
+                             struct device_attribute *attr, char *buf)
+{
+    struct acpi_device *adev = to_acpi_device(dev);
+    struct universal_armoury *armoury = adev->driver_data;
+    if (!armoury)
+        return -ENODEV;
+    return scnprintf(buf, PAGE_SIZE, "%u\n", armoury->index);
+}
+
+static ssize_t supported_features_show(struct device *dev,
+                                     struct device_attribute *attr, char *buf)
+{
+    struct acpi_device *adev = to_acpi_device(dev);
+    struct universal_armoury *armoury = adev->driver_data;
+    if (!armoury)
+        return scnprintf(buf, PAGE_SIZE, "gpu_mux:0 dgpu_disable:0 egpu_enable:0\n");
+    universal_armoury_ensure_probed(armoury);
+    return scnprintf(buf, PAGE_SIZE, "gpu_mux:%d dgpu_disable:%d egpu_enable:%d\n",
+                   armoury->gpu_mux_supported,
+                   armoury->dgpu_disable_supported,
+                   armoury->egpu_supported);
+}
+
+static ssize_t cache_stats_show(struct device *dev,
+                                struct device_attribute *attr, char *buf)
+{
+    struct acpi_device *adev = to_acpi_device(dev);
+    struct universal_armoury *armoury = adev->driver_data;
+    if (!armoury)
+        return -ENODEV;
+    return scnprintf(buf, PAGE_SIZE, "hits:%ld misses:%ld dgpu_asleep:%ld\n",
+                   atomic_long_read(&armoury->cache_hits),
+                   atomic_long_read(&armoury->cache_misses),
+                   atomic_long_read(&armoury->dgpu_reads_avoided));
+}
+
+/* Re-read every state now, waking the dGPU if it has to */
+static ssize_t refresh_store(struct device *dev, struct device_attribute *attr,
+                             const char *buf, size_t count)
+{
+    struct acpi_device *adev = to_acpi_device(dev);
+    struct universal_armoury *armoury = adev->driver_data;
+    unsigned long changed;
+    int i;
+
+    if (!armoury)
+        return -ENODEV;
+    universal_armoury_ensure_probed(armoury);
+
+    mutex_lock(&armoury->lock);
+    universal_armoury_refresh_mask(armoury, 0, &changed, ARMOURY_SRC_FIRMWARE);
+    mutex_unlock(&armoury->lock);
+
+    for (i = 0; i < ARMOURY_STATE_COUNT; i++) {
+        if (changed & BIT(i))
+            sysfs_notify(&adev->dev.kobj, NULL, armoury_state_attr_names[i]);
+    }
+
+    return count;
+}
+
+static ssize_t eval_stats_show(struct device *dev,
+                               struct device_attribute *attr, char *buf)
+{
+    struct acpi_device *adev = to_acpi_device(dev);
+    struct universal_armoury *armoury = adev->driver_data;
+    if (!armoury)
+        return -ENODEV;
+    return scnprintf(buf, PAGE_SIZE, "calls:%ld allocs:%ld\n",
+                   atomic_long_read(&armoury->eval_calls),
+                   atomic_long_read(&armoury->eval_allocs));
+}
+
+static ssize_t switch_status_show(struct device *dev,
+                                  struct device_attribute *attr, char *buf)
+{
+    struct acpi_device *adev = to_acpi_device(dev);
+    struct universal_armoury *armoury = adev->driver_data;
+    const char *state;
+    u64 queued, done;
+    int err;
+
+    if (!armoury)
+        return -ENODEV;
+
+    mutex_lock(&armoury->lock);
+    queued = armoury->switch_gen_queued;
+    done = armoury->switch_gen_done;
+    err = armoury->switch_err;
+    mutex_unlock(&armoury->lock);
+
+    if (!queued)
+        state = "idle";
+    else if (done != queued)
+        state = "pending";
+    else if (err)
+        state = "error";
+    else
+        state = "done";
+
+    return scnprintf(buf, PAGE_SIZE, "%s generation:%llu completed:%llu errno:%d\n",
+                   state, queued, done, err);
+}
+
+static ssize_t coalesce_stats_show(struct device *dev,
+                                   struct device_attribute *attr, char *buf)
+{
+    struct acpi_device *adev = to_acpi_device(dev);
+    struct universal_armoury *armoury = adev->driver_data;
+    long coalesced, short_circuited;
+
+    if (!armoury)
+        return -ENODEV;
+
+    coalesced = atomic_long_read(&armoury->writes_coalesced);
+    short_circuited = atomic_long_read(&armoury->writes_short_circuited);
+    return scnprintf(buf, PAGE_SIZE, "saved:%ld coalesced:%ld short_circuited:%ld\n",
+                   coalesced + short_circuited, coalesced, short_circuited);
+}
+
+/* Resume path cost and the result of the last restore */
+static ssize_t resume_stats_show(struct device *dev,
+                                 struct device_attribute *attr, char *buf)
+{
+    struct acpi_device *adev = to_acpi_device(dev);
+    struct universal_armoury *armoury = adev->driver_data;
+    ssize_t len;
+
+    if (!armoury)
+        return -ENODEV;
+
+    mutex_lock(&armoury->lock);
+    len = scnprintf(buf, PAGE_SIZE,
+                    "resumes:%llu restored:%llu failed:%llu resume_ns:%llu restore_ns:%llu restore_calls:%lu\n",
+                    armoury->resumes, armoury->restores, armoury->restore_failures,
+                    armoury->last_resume_ns, armoury->last_restore_ns,
+                    armoury->last_restore_calls);
+    mutex_unlock(&armoury->lock);
+
+    return len;
+}
+
+/* States and values the governor applies on battery, "name:value ..." */
+static ssize_t governor_policy_show(struct device *dev,
+                                    struct device_attribute *attr, char *buf)
+{
+    struct acpi_device *adev = to_acpi_device(dev);
+    struct universal_armoury *armoury = adev->driver_data;
+    ssize_t len = 0;
+    int i;
+
+    if (!armoury)
+        return -ENODEV;
+    universal_armoury_ensure_probed(armoury);
+
+    mutex_lock(&armoury->lock);
+    for (i = 0; i < ARMOURY_STATE_COUNT; i++) {
+        if (armoury->gov_policy & BIT(i))
+            len += scnprintf(buf + len, PAGE_SIZE - len, "%s%s:%d", len ? " " : "",
+                             armoury_state_attr_names[i], armoury->gov_target[i]);
+    }
+    mutex_unlock(&armoury->lock);
+
+    if (!len)
+        len = scnprintf(buf, PAGE_SIZE, "none");
+    len += scnprintf(buf + len, PAGE_SIZE - len, "\n");
+    return len;
+}
+
+/* Parse "name:value" pairs of supported states, or "none" */
+static int armoury_governor_parse(struct universal_armoury *armoury, const char *buf,
+                                  size_t count, unsigned long *policy, int *target)
+{
+    const struct armoury_value_range *range;
+    char str[64], *cur, *tok, *val;
+    int i, value;
+
+    if (count >= sizeof(str))
+        return -EINVAL;
+    memcpy(str, buf, count);
+    str[count] = '\0';
+
+    *policy = 0;
+    cur = strim(str);
+    if (!strcmp(cur, "none"))
+        return 0;
+
+    while ((tok = strsep(&cur, " \t"))) {
+        if (!*tok)
+            continue;
+        val = strchr(tok, ':');
+        if (!val)
+            return -EINVAL;
+        *val++ = '\0';
+
+        for (i = 0; i < ARMOURY_STATE_COUNT; i++) {
+            if (!strcmp(tok, armoury_state_attr_names[i]))
+                break;
+        }
+        if (i == ARMOURY_STATE_COUNT || !armoury_state_supported(armoury, i) ||
+            kstrtoint(val, 10, &value))
+            return -EINVAL;
+
+        range = &armoury->desc->ranges[i];
+        if (value < range->min || value > range->max)
+            return -EINVAL;
+        *policy |= BIT(i);
+        target[i] = value;
+    }
+
+    return *policy ? 0 : -EINVAL;
+}
+
+/* Takes effect on the next source change; states already switched are still restored */
+static ssize_t governor_policy_store(struct device *dev, struct device_attribute *attr,
+                                     const char *buf, size_t count)
+{
+    struct acpi_device *adev = to_acpi_device(dev);
+    struct universal_armoury *armoury = adev->driver_data;
+    int target[ARMOURY_STATE_COUNT] = { 0 };
+    unsigned long policy;
+    int ret;
+
+    if (!armoury)
+        return -ENODEV;
+    universal_armoury_ensure_probed(armoury);
+
+    ret = armoury_governor_parse(armoury, buf, count, &policy, target);
+    if (ret) {
+        dev_err(dev, "Invalid governor policy, expected state:value pairs or none\n");
+        return ret;
+    }
+
+    mutex_lock(&armoury->lock);
+    armoury->gov_policy = policy;
+    memcpy(armoury->gov_target, target, sizeof(target));
+    mutex_unlock(&armoury->lock);
+
+    return count;
+}
+
+/* Manual override: while set, power source changes switch nothing */
+static ssize_t governor_lock_show(struct device *dev,
+                                  struct device_attribute *attr, char *buf)
+{
+    struct acpi_device *adev = to_acpi_device(dev);
+    struct universal_armoury *armoury = adev->driver_data;
+
+    if (!armoury)
+        return -ENODEV;
+    return scnprintf(buf, PAGE_SIZE, "%d\n", READ_ONCE(armoury->gov_locked));
+}
+
+static ssize_t governor_lock_store(struct device *dev, struct device_attribute *attr,
+                                   const char *buf, size_t count)
+{
+    struct acpi_device *adev = to_acpi_device(dev);
+    struct universal_armoury *armoury = adev->driver_data;
+    int value, ret;
+
+    if (!armoury)
+        return -ENODEV;
+
+    ret = kstrtoint(buf, 10, &value);
+    if (ret || value < 0 || value > 1) {
+        dev_err(dev, "governor_lock value must be 0..1\n");
+        return -EINVAL;
+    }
+
+    mutex_lock(&armoury->lock);
+    WRITE_ONCE(armoury->gov_locked, value);
+    mutex_unlock(&armoury->lock);
+
+    /* Catch up with a source change missed while locked */
+    if (!value)
+        universal_armoury_governor_kick(armoury);
+
+    return count;
+}
+
+static ssize_t governor_stats_show(struct device *dev,
+                                   struct device_attribute *attr, char *buf)
+{
+    static const char * const sources[] = { "battery", "ac" };
+    struct acpi_device *adev = to_acpi_device(dev);
+    struct universal_armoury *armoury = adev->driver_data;
+    ssize_t len;
+
+    if (!armoury)
         return -ENODEV;
 
-    if (!buf || count == 0)
-        return -EINVAL;
+    mutex_lock(&armoury->lock);
+    len = scnprintf(buf, PAGE_SIZE,
+                    "source:%s locked:%d events:%ld debounced:%ld transitions:%llu writes:%llu failed:%llu skipped:%llu mux_blocked:%llu\n",
+                    armoury->gov_source == ARMOURY_GOV_UNKNOWN ? "unknown" :
+                    sources[armoury->gov_source], armoury->gov_locked,
+                    atomic_long_read(&armoury->gov_events),
+                    atomic_long_read(&armoury->gov_debounced),
+                    armoury->gov_transitions, armoury->gov_writes,
+                    armoury->gov_failures, armoury->gov_skipped,
+                    armoury->gov_mux_blocked);
+    mutex_unlock(&armoury->lock);
+
+    return len;
+}
+
+static DEVICE_ATTR_RO(vendor);
+static DEVICE_ATTR_RO(product);
+static DEVICE_ATTR_RO(instance);
+static DEVICE_ATTR_RO(supported_features);
+static DEVICE_ATTR_RO(cache_stats);
+static DEVICE_ATTR_WO(refresh);
+static DEVICE_ATTR_RO(eval_stats);
+static DEVICE_ATTR_RO(switch_status);
+static DEVICE_ATTR_RO(coalesce_stats);
+static DEVICE_ATTR_RO(resume_stats);
+static DEVICE_ATTR_RW(governor_policy);
+static DEVICE_ATTR_RW(governor_lock);
+static DEVICE_ATTR_RO(governor_stats);
+
+static struct attribute *universal_armoury_attrs[] = {
+    &dev_attr_gpu_mux.attr,
+    &dev_attr_dgpu_disable.attr,
+    &dev_attr_egpu_enable.attr,
+    &dev_attr_vendor.attr,
+    &dev_attr_product.attr,
+    &dev_attr_instance.attr,
+    &dev_attr_supported_features.attr,
+    &dev_attr_cache_stats.attr,
+    &dev_attr_refresh.attr,
+    &dev_attr_eval_stats.attr,
+    &dev_attr_switch_status.attr,
+    &dev_attr_coalesce_stats.attr,
+    &dev_attr_resume_stats.attr,
+    &dev_attr_governor_policy.attr,
+    &dev_attr_governor_lock.attr,
+    &dev_attr_governor_stats.attr,
+    &dev_attr_cpu_fan_curve.attr,
+    &dev_attr_gpu_fan_curve.attr,
+    &dev_attr_fan_curve_reset.attr,
+    &dev_attr_ppt_pl1_spl.attr,
+    &dev_attr_ppt_pl1_spl_min.attr,
+    &dev_attr_ppt_pl1_spl_max.attr,
+    &dev_attr_ppt_pl2_sppt.attr,
+    &dev_attr_ppt_pl2_sppt_min.attr,
+    &dev_attr_ppt_pl2_sppt_max.attr,
+    &dev_attr_ppt_fppt.attr,
+    &dev_attr_ppt_fppt_min.attr,
+    &dev_attr_ppt_fppt_max.attr,
+    &dev_attr_nv_dynamic_boost.attr,
+    &dev_attr_nv_dynamic_boost_min.attr,
+    &dev_attr_nv_dynamic_boost_max.attr,
+    NULL
+};
+
+static struct attribute * const armoury_state_attrs[ARMOURY_STATE_COUNT] = {
+    [ARMOURY_STATE_GPU_MUX] = &dev_attr_gpu_mux.attr,
+    [ARMOURY_STATE_DGPU_DISABLE] = &dev_attr_dgpu_disable.attr,
+    [ARMOURY_STATE_EGPU_ENABLE] = &dev_attr_egpu_enable.attr,
+};
+
+static struct attribute * const armoury_fan_attrs[ARMOURY_FAN_COUNT] = {
+    [ARMOURY_FAN_CPU] = &dev_attr_cpu_fan_curve.attr,
+    [ARMOURY_FAN_GPU] = &dev_attr_gpu_fan_curve.attr,
+};
+
+static struct attribute * const armoury_power_attrs[ARMOURY_POWER_COUNT][3] = {
+    [ARMOURY_POWER_PL1_SPL] = {
+        &dev_attr_ppt_pl1_spl.attr,
+        &dev_attr_ppt_pl1_spl_min.attr,
+        &dev_attr_ppt_pl1_spl_max.attr,
+    },
+    [ARMOURY_POWER_PL2_SPPT] = {
+        &dev_attr_ppt_pl2_sppt.attr,
+        &dev_attr_ppt_pl2_sppt_min.attr,
+        &dev_attr_ppt_pl2_sppt_max.attr,
+    },
+    [ARMOURY_POWER_FPPT] = {
+        &dev_attr_ppt_fppt.attr,
+        &dev_attr_ppt_fppt_min.attr,
+        &dev_attr_ppt_fppt_max.attr,
+    },
+    [ARMOURY_POWER_DYN_BOOST] = {
+        &dev_attr_nv_dynamic_boost.attr,
+        &dev_attr_nv_dynamic_boost_min.attr,
+        &dev_attr_nv_dynamic_boost_max.attr,
+    },
+};
+
+/*
+ * A BIOS setting is shown while it may exist: before probe whenever the
+ * descriptor names it and the settings methods are present, afterwards
+ * only if firmware answered for it.
+ */
+static bool armoury_bios_setting_visible(struct universal_armoury *armoury,
+                                         u32 setting, bool confirmed)
+{
+    if (smp_load_acquire(&armoury->probed))
+        return confirmed;
+    return setting && armoury->bios_get_method.handle && armoury->bios_set_method.handle;
+}
+
+static bool armoury_fan_visible(struct universal_armoury *armoury, enum armoury_fan fan)
+{
+    const struct armoury_fan_curve_desc *fd = armoury->desc->fan_curves;
+
+    return fd && armoury_bios_setting_visible(armoury, fd->settings[fan],
+                                              armoury->fan_curves & BIT(fan));
+}
+
+static bool armoury_power_visible(struct universal_armoury *armoury,
+                                  enum armoury_power_id id)
+{
+    const struct armoury_power_desc *pd = armoury->desc->power;
+
+    return pd && armoury_bios_setting_visible(armoury, pd->settings[id],
+                                              armoury->power_limits & BIT(id));
+}
+
+/* Hide controls this machine does not have, instead of failing with -ENODEV */
+static umode_t universal_armoury_attr_is_visible(struct kobject *kobj,
+                                                 struct attribute *attr, int n)
+{
+    struct universal_armoury *armoury = to_acpi_device(kobj_to_dev(kobj))->driver_data;
+    unsigned int j;
+    int i;
+
+    if (!armoury)
+        return attr->mode;
+
+    for (i = 0; i < ARMOURY_STATE_COUNT; i++) {
+        if (attr == armoury_state_attrs[i])
+            return armoury_state_supported(armoury, i) ? attr->mode : 0;
+    }
+
+    for (i = 0; i < ARMOURY_FAN_COUNT; i++) {
+        if (attr == armoury_fan_attrs[i])
+            return armoury_fan_visible(armoury, i) ? attr->mode : 0;
+    }
+    if (attr == &dev_attr_fan_curve_reset.attr) {
+        for (i = 0; i < ARMOURY_FAN_COUNT; i++) {
+            if (armoury_fan_visible(armoury, i))
+                return attr->mode;
+        }
+        return 0;
+    }
+
+    for (i = 0; i < ARMOURY_POWER_COUNT; i++) {
+        for (j = 0; j < ARRAY_SIZE(armoury_power_attrs[i]); j++) {
+            if (attr == armoury_power_attrs[i][j])
+                return armoury_power_visible(armoury, i) ? attr->mode : 0;
+        }
+    }
+
+    /* Without power_supply notifications there is nothing to govern */
+    if (attr == &dev_attr_governor_policy.attr || attr == &dev_attr_governor_lock.attr ||
+        attr == &dev_attr_governor_stats.attr)
+        return armoury->gov_nb.notifier_call ? attr->mode : 0;
+
+    return attr->mode;
+}
+
+static const struct attribute_group universal_armoury_attr_group = {
+    .attrs = universal_armoury_attrs,
+    .is_visible = universal_armoury_attr_is_visible,
+};
+
+/*
+ * Re-evaluate is_visible once probing is done. This removes and recreates
+ * every file of the group, so it must not run from one of its callbacks.
+ */
+static void universal_armoury_update_visibility(struct universal_armoury *armoury)
+{
+    struct device *dev = &armoury->acpi_dev->dev;
+    int ret;
+
+    ret = sysfs_update_group(&dev->kobj, &universal_armoury_attr_group);
+    if (ret)
+        dev_warn(dev, "Failed to update sysfs attributes: %d\n", ret);
+}
+
+/* Upper latency bound of the bucket holding the 99th percentile call */
+static u64 armoury_method_stats_p99(const struct armoury_method_stats *stats)
+{
+    u64 target = stats->calls - stats->calls / 100;
+    u64 seen = 0;
+    int b;
+
+    for (b = 0; b < ARMOURY_LAT_BUCKETS - 1; b++) {
+        seen += stats->hist[b];
+        if (seen >= target)
+            return min_t(u64, BIT_ULL(b), stats->max_ns);
+    }
+
+    return stats->max_ns;
+}
+
+static int method_stats_show(struct seq_file *m, void *unused)
+{
+    struct universal_armoury *armoury = m->private;
+    struct armoury_method *methods[ARMOURY_MAX_METHODS];
+    const struct armoury_method_stats *stats;
+    int i, b, n;
+
+    mutex_lock(&armoury->lock);
+    n = armoury_method_list(armoury, methods);
+    for (i = 0; i < n; i++) {
+        if (!methods[i]->handle)
+            continue;
+
+        stats = &methods[i]->stats;
+        seq_printf(m, "%s: calls:%llu errors io:%llu proto:%llu nodata:%llu other:%llu\n",
+                   methods[i]->name, stats->calls,
+                   stats->errors[ARMOURY_ERR_IO], stats->errors[ARMOURY_ERR_PROTO],
+                   stats->errors[ARMOURY_ERR_NODATA], stats->errors[ARMOURY_ERR_OTHER]);
+        if (!stats->calls)
+            continue;
+
+        seq_printf(m, "  latency_ns min:%llu avg:%llu p99:%llu max:%llu\n",
+                   stats->min_ns, div64_u64(stats->total_ns, stats->calls),
+                   armoury_method_stats_p99(stats), stats->max_ns);
+        for (b = 0; b < ARMOURY_LAT_BUCKETS; b++) {
+            if (!stats->hist[b])
+                continue;
+            if (b == ARMOURY_LAT_BUCKETS - 1)
+                seq_printf(m, "  [%llu, inf): %llu\n",
+                           BIT_ULL(b - 1), stats->hist[b]);
+            else
+                seq_printf(m, "  [%llu, %llu): %llu\n",
+                           b ? BIT_ULL(b - 1) : 0, BIT_ULL(b), stats->hist[b]);
+        }
+    }
+    mutex_unlock(&armoury->lock);
+
+    return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(method_stats);
+
+/* Capability table from the namespace walk, one line per known pair */
+static int capabilities_show(struct seq_file *m, void *unused)
+{
+    struct universal_armoury *armoury = m->private;
+    const struct armoury_cap_pair *pair;
+    const struct armoury_capability *cap;
+    bool active;
+    int i;
+
+    for (i = 0; i < ARMOURY_NR_CAP_PAIRS; i++) {
+        pair = &universal_armoury_cap_pairs[i];
+        cap = &armoury->caps[i];
+        if (!cap->get_handle && !cap->set_handle)
+            continue;
+
+        seq_printf(m, "%s: get:%s", pair->label, pair->get);
+        if (cap->get_handle)
+            seq_printf(m, "/%u", cap->get_args);
+        else
+            seq_puts(m, "/absent");
+        seq_printf(m, " set:%s", pair->set);
+        if (cap->set_handle)
+            seq_printf(m, "/%u", cap->set_args);
+        else
+            seq_puts(m, "/absent");
+
+        active = pair->id >= 0 && cap->get_handle &&
+                 armoury_state_get_method(armoury, pair->id)->handle == cap->get_handle;
+        seq_printf(m, " active:%d\n", active);
+    }
+
+    return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(capabilities);
+
+/* Capability cache records of all probed devices, ready to feed back */
+static int capcache_show(struct seq_file *m, void *unused)
+{
+    struct universal_armoury *armoury;
+    unsigned long mask;
+    unsigned int flags;
+    int i;
+
+    mutex_lock(&universal_armoury_devs_lock);
+    list_for_each_entry(armoury, &universal_armoury_devices, node) {
+        if (!smp_load_acquire(&armoury->probed))
+            continue;
+
+        mask = 0;
+        for (i = 0; i < ARMOURY_STATE_COUNT; i++) {
+            if (armoury_state_supported(armoury, i))
+                mask |= BIT(i);
+        }
+        mutex_lock(&armoury->lock);
+        flags = armoury->bulk_read_broken ? ARMOURY_CAPCACHE_NO_BULK : 0;
+        flags |= ARMOURY_CAPCACHE_BIOS;
+        mask |= armoury->fan_curves << ARMOURY_CAPCACHE_FAN_SHIFT |
+                armoury->power_limits << ARMOURY_CAPCACHE_POWER_SHIFT;
+        mutex_unlock(&armoury->lock);
+
+        seq_printf(m, "%s|%s|%s|%s|0x%lx|%u\n", armoury->vendor_name,
+                   armoury->product_name, armoury->bios_version,
+                   dev_name(&armoury->acpi_dev->dev), mask, flags);
+    }
+    mutex_unlock(&universal_armoury_devs_lock);
+
+    return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(capcache);
+
+static void universal_armoury_debugfs_init(struct universal_armoury *armoury)
+{
+    armoury->debugfs_dir = debugfs_create_dir(dev_name(&armoury->acpi_dev->dev),
+                                              universal_armoury_debugfs_root);
+    debugfs_create_file("method_stats", 0444, armoury->debugfs_dir, armoury,
+                        &method_stats_fops);
+    debugfs_create_file("capabilities", 0444, armoury->debugfs_dir, armoury,
+                        &capabilities_fops);
+}
+
+/* /dev/armoury: whole-device snapshots and batched sets in one syscall */
+static_assert(ARMOURY_SNAP_GPU_MUX == ARMOURY_STATE_GPU_MUX);
+static_assert(ARMOURY_SNAP_DGPU_DISABLE == ARMOURY_STATE_DGPU_DISABLE);
+static_assert(ARMOURY_SNAP_EGPU_ENABLE == ARMOURY_STATE_EGPU_ENABLE);
+static_assert(ARMOURY_SNAP_NR_STATES == ARMOURY_STATE_COUNT);
+
+static void universal_armoury_release(struct kref *kref)
+{
+    complete(&container_of(kref, struct universal_armoury, users)->released);
+}
+
+/*
+ * Resolve an ABI instance index and hold the device until
+ * universal_armoury_put(); remove() waits for that before tearing it down.
+ */
+static struct universal_armoury *universal_armoury_get(u32 index)
+{
+    struct universal_armoury *armoury;
+
+    mutex_lock(&universal_armoury_devs_lock);
+    list_for_each_entry(armoury, &universal_armoury_devices, node) {
+        if (armoury->index == index) {
+            kref_get(&armoury->users);
+            mutex_unlock(&universal_armoury_devs_lock);
+            return armoury;
+        }
+    }
+    mutex_unlock(&universal_armoury_devs_lock);
+    return NULL;
+}
+
+static void universal_armoury_put(struct universal_armoury *armoury)
+{
+    kref_put(&armoury->users, universal_armoury_release);
+}
 
-    ret = kstrtoint(buf, 10, &value);
-    if (ret) {
-        dev_err(dev, "Invalid input for gpu_mux: %s\n", buf);
-        return ret;
-    }
+/*
+ * Copy the readable states without armoury->lock. Returns false, leaving
+ * snap->valid clear, if any of them has to come from firmware.
+ */
+static bool universal_armoury_snapshot_peek(struct universal_armoury *armoury,
+                                            struct armoury_snapshot *snap,
+                                            unsigned long readable)
+{
+    unsigned int seq;
+    bool fresh;
+    int i;
 
-    if (value < 0 || value > 1) {
-        dev_err(dev, "gpu_mux value must be 0 or 1, got: %d\n", value);
-        return -EINVAL;
-    }
+    do {
+        seq = read_seqcount_begin(&armoury->cache_seq);
+        fresh = true;
+        for (i = 0; i < ARMOURY_STATE_COUNT && fresh; i++) {
+            if (!(readable & BIT(i)))
+                continue;
+            fresh = armoury_cache_fresh(armoury, i);
+            snap->values[i] = *armoury_state_ptr(armoury, i);
+            snap->updated_ns[i] = armoury->cache[i].updated_ns;
+        }
+        snap->generation = armoury->state_gen;
+    } while (read_seqcount_retry(&armoury->cache_seq, seq));
 
-    ret = universal_armoury_acpi_evaluate_method(armoury->acpi_dev,
-                                               armoury->set_gpu_mux_method,
-                                               value, NULL);
-    if (ret)
-        return ret;
+    if (!fresh) {
+        memset(snap->values, 0, sizeof(snap->values));
+        memset(snap->updated_ns, 0, sizeof(snap->updated_ns));
+        return false;
+    }
 
-    armoury->gpu_mux_state = value;
-    return count;
+    snap->valid = readable;
+    return true;
 }
 
-/* dGPU disable control */
-static ssize_t dgpu_disable_show(struct device *dev,
-                                struct device_attribute *attr, char *buf)
+/*
+ * Fill a snapshot. A fully cached one is copied without the lock; otherwise
+ * stale states are refreshed together under one lock hold, in a single
+ * firmware call when the vendor has a bulk reader.
+ */
+static void universal_armoury_snapshot(struct universal_armoury *armoury,
+                                       struct armoury_snapshot *snap)
 {
-    struct acpi_device *adev = to_acpi_device(dev);
-    struct universal_armoury *armoury = adev->driver_data;
-    u32 result;
-    int ret;
+    unsigned long readable = 0, stale = 0, skipped = 0, changed;
+    int i;
 
-    if (!armoury || !armoury->dgpu_disable_supported || !armoury->get_dgpu_disable_method)
-        return -ENODEV;
+    /* Support flags and methods are fixed once probed */
+    for (i = 0; i < ARMOURY_STATE_COUNT; i++) {
+        if (!armoury_state_supported(armoury, i))
+            continue;
+        snap->supported |= BIT(i);
+        if (armoury_state_get_method(armoury, i)->handle)
+            readable |= BIT(i);
+    }
 
-    ret = universal_armoury_acpi_evaluate_method(armoury->acpi_dev,
-                                               armoury->get_dgpu_disable_method,
-                                               0, &result);
-    if (ret)
-        return ret;
+    if (readable && !(snap->flags & ARMOURY_SNAPSHOT_FRESH) &&
+        universal_armoury_snapshot_peek(armoury, snap, readable)) {
+        atomic_long_inc(&armoury->cache_hits);
+        snap->timestamp_ns = ktime_get_ns();
+        goto names;
+    }
 
-    armoury->dgpu_disable_state = result;
-    return scnprintf(buf, PAGE_SIZE, "%d\n", result);
+    mutex_lock(&armoury->lock);
+    for (i = 0; i < ARMOURY_STATE_COUNT; i++) {
+        if ((readable & BIT(i)) &&
+            ((snap->flags & ARMOURY_SNAPSHOT_FRESH) || !armoury_cache_fresh(armoury, i)))
+            stale |= BIT(i);
+    }
+
+    /* An explicit fresh snapshot is allowed to wake the dGPU */
+    if (snap->flags & ARMOURY_SNAPSHOT_FRESH)
+        universal_armoury_refresh_mask(armoury, 0, &changed, ARMOURY_SRC_FIRMWARE);
+    else if (stale)
+        skipped = universal_armoury_refresh_all(armoury, &changed, ARMOURY_SRC_FIRMWARE);
+    else if (readable)
+        atomic_long_inc(&armoury->cache_hits);
+
+    for (i = 0; i < ARMOURY_STATE_COUNT; i++) {
+        if (!(readable & BIT(i)))
+            continue;
+        if (!armoury->cache[i].known &&
+            !((skipped & BIT(i)) && armoury->cache[i].seen))
+            continue;
+        snap->valid |= BIT(i);
+        snap->values[i] = *armoury_state_ptr(armoury, i);
+        snap->updated_ns[i] = armoury->cache[i].updated_ns;
+    }
+    snap->generation = armoury->state_gen;
+    snap->timestamp_ns = ktime_get_ns();
+    mutex_unlock(&armoury->lock);
+
+names:
+    strscpy(snap->vendor_name, armoury->vendor_name, sizeof(snap->vendor_name));
+    strscpy(snap->product_name, armoury->product_name, sizeof(snap->product_name));
 }
 
-static ssize_t dgpu_disable_store(struct device *dev,
-                                 struct device_attribute *attr,
-                                 const char *buf, size_t count)
+/*
+ * Apply several states under one lock hold. All values are validated before
+ * any firmware call. Setters run one by one and, if one fails, the states
+ * already written are put back to what firmware held before.
+ */
+static int universal_armoury_set_batch(struct universal_armoury *armoury,
+                                       struct armoury_set *req)
 {
-    struct acpi_device *adev = to_acpi_device(dev);
-    struct universal_armoury *armoury = adev->driver_data;
-    int value, ret;
+    struct armoury_state_snapshot want = { }, prev = { };
+    unsigned long changed = 0, done = 0;
+    int i, ret, err;
 
-    if (!armoury || !armoury->dgpu_disable_supported || !armoury->set_dgpu_disable_method)
-        return -ENODEV;
+    for (i = 0; i < ARMOURY_STATE_COUNT; i++) {
+        const struct armoury_value_range *range = &armoury->desc->ranges[i];
 
-    if (!buf || count == 0)
-        return -EINVAL;
+        if (!(req->mask & BIT(i)))
+            continue;
+        if (!armoury_state_supported(armoury, i) ||
+            !armoury_state_set_method(armoury, i)->handle)
+            return -ENODEV;
+        if (req->values[i] < range->min || req->values[i] > range->max)
+            return -EINVAL;
+        want.values[i] = req->values[i];
+        want.valid |= BIT(i);
+    }
 
-    ret = kstrtoint(buf, 10, &value);
-    if (ret) {
-        dev_err(dev, "Invalid input for dgpu_disable: %s\n", buf);
-        return ret;
+    mutex_lock(&armoury->lock);
+    /* Skip states firmware already holds, remember the rest for rollback */
+    for (i = 0; i < ARMOURY_STATE_COUNT; i++) {
+        if (!(want.valid & BIT(i)))
+            continue;
+        if (armoury_state_matches(armoury, i, want.values[i])) {
+            want.valid &= ~BIT(i);
+            atomic_long_inc(&armoury->writes_short_circuited);
+            continue;
+        }
+        if (!armoury->cache[i].known && armoury_state_get_method(armoury, i)->handle)
+            universal_armoury_read_state(armoury, i, &changed, ARMOURY_SRC_FIRMWARE);
+        if (armoury->cache[i].known) {
+            prev.values[i] = *armoury_state_ptr(armoury, i);
+            prev.valid |= BIT(i);
+        }
     }
 
-    if (value < 0 || value > 1) {
-        dev_err(dev, "dgpu_disable value must be 0 or 1, got: %d\n", value);
-        return -EINVAL;
+    ret = 0;
+    for (i = 0; i < ARMOURY_STATE_COUNT && !ret; i++) {
+        if (!(want.valid & BIT(i)))
+            continue;
+        ret = __universal_armoury_set_state(armoury, i, want.values[i], ARMOURY_SRC_USER);
+        if (!ret)
+            done |= BIT(i);
     }
 
-    ret = universal_armoury_acpi_evaluate_method(armoury->acpi_dev,
-                                               armoury->set_dgpu_disable_method,
-                                               value, NULL);
-    if (ret)
-        return ret;
+    if (ret) {
+        for (i = 0; i < ARMOURY_STATE_COUNT; i++) {
+            if (!(done & BIT(i)))
+                continue;
+            err = (prev.valid & BIT(i)) ?
+                  __universal_armoury_set_state(armoury, i, prev.values[i],
+                                                ARMOURY_SRC_USER) : -ENODATA;
+            if (err)
+                dev_warn(&armoury->acpi_dev->dev, "Failed to roll back %s: %d\n",
+                         armoury_state_attr_names[i], err);
+        }
+        done = 0;
+    }
 
-    armoury->dgpu_disable_state = value;
-    return count;
+    req->applied = done;
+    req->generation = armoury->state_gen;
+    mutex_unlock(&armoury->lock);
+
+    return ret;
 }
 
-/* eGPU enable control */
-static ssize_t egpu_enable_show(struct device *dev,
-                               struct device_attribute *attr, char *buf)
+static long universal_armoury_ioctl(struct file *file, unsigned int cmd,
+                                    unsigned long arg)
 {
-    struct acpi_device *adev = to_acpi_device(dev);
-    struct universal_armoury *armoury = adev->driver_data;
-    u32 result;
-    int ret;
+    void __user *argp = (void __user *)arg;
+    struct universal_armoury *armoury;
+    union {
+        struct armoury_version version;
+        struct armoury_snapshot snap;
+        struct armoury_set set;
+    } u;
+    long ret = 0;
+    int i;
 
-    if (!armoury || !armoury->egpu_supported || !armoury->get_egpu_enable_method)
-        return -ENODEV;
+    switch (cmd) {
+    case ARMOURY_IOC_VERSION:
+        memset(&u.version, 0, sizeof(u.version));
+        u.version.abi_version = ARMOURY_ABI_VERSION;
+        u.version.nr_states = ARMOURY_STATE_COUNT;
+        mutex_lock(&universal_armoury_devs_lock);
+        list_for_each_entry(armoury, &universal_armoury_devices, node)
+            u.version.nr_devices++;
+        mutex_unlock(&universal_armoury_devs_lock);
+        if (copy_to_user(argp, &u.version, sizeof(u.version)))
+            return -EFAULT;
+        return 0;
 
-    ret = universal_armoury_acpi_evaluate_method(armoury->acpi_dev,
-                                               armoury->get_egpu_enable_method,
-                                               0, &result);
-    if (ret)
-        return ret;
+    case ARMOURY_IOC_SNAPSHOT:
+        if (copy_from_user(&u.snap, argp, sizeof(u.snap)))
+            return -EFAULT;
+        if (u.snap.flags & ~ARMOURY_SNAPSHOT_FRESH)
+            return -EINVAL;
+        /* Forced firmware reads wake the dGPU, as privileged as refresh */
+        if ((u.snap.flags & ARMOURY_SNAPSHOT_FRESH) &&
+            !(file->f_mode & FMODE_WRITE) && !capable(CAP_SYS_ADMIN))
+            return -EPERM;
+        memset(&u.snap.supported, 0, sizeof(u.snap) - offsetof(struct armoury_snapshot, supported));
 
-    armoury->egpu_state = result;
-    return scnprintf(buf, PAGE_SIZE, "%d\n", result);
-}
+        armoury = universal_armoury_get(u.snap.index);
+        if (!armoury)
+            return -ENODEV;
+        universal_armoury_ensure_probed(armoury);
+        universal_armoury_snapshot(armoury, &u.snap);
+        universal_armoury_put(armoury);
 
-static ssize_t egpu_enable_store(struct device *dev,
-                                struct device_attribute *attr,
-                                const char *buf, size_t count)
-{
-    struct acpi_device *adev = to_acpi_device(dev);
-    struct universal_armoury *armoury = adev->driver_data;
-    int value, ret;
+        if (copy_to_user(argp, &u.snap, sizeof(u.snap)))
+            return -EFAULT;
+        return 0;
 
-    if (!armoury || !armoury->egpu_supported || !armoury->set_egpu_enable_method)
-        return -ENODEV;
+    case ARMOURY_IOC_SET:
+        if (!(file->f_mode & FMODE_WRITE))
+            return -EBADF;
+        if (copy_from_user(&u.set, argp, sizeof(u.set)))
+            return -EFAULT;
+        if (u.set.flags || (u.set.mask & ~(BIT(ARMOURY_STATE_COUNT) - 1)))
+            return -EINVAL;
 
-    if (!buf || count == 0)
-        return -EINVAL;
+        armoury = universal_armoury_get(u.set.index);
+        if (!armoury)
+            return -ENODEV;
+        universal_armoury_ensure_probed(armoury);
+        /* Order the batch after writes to this device that were already accepted */
+        for (i = 0; i < ARMOURY_STATE_COUNT; i++) {
+            if (u.set.mask & BIT(i))
+                flush_delayed_work(&armoury->pending[i].work);
+        }
+        flush_work(&armoury->switch_work);
+        ret = universal_armoury_set_batch(armoury, &u.set);
+        universal_armoury_put(armoury);
+        if (ret)
+            return ret;
 
-    ret = kstrtoint(buf, 10, &value);
-    if (ret) {
-        dev_err(dev, "Invalid input for egpu_enable: %s\n", buf);
-        return ret;
-    }
+        if (copy_to_user(argp, &u.set, sizeof(u.set)))
+            return -EFAULT;
+        return 0;
 
-    if (value < 0 || value > 1) {
-        dev_err(dev, "egpu_enable value must be 0 or 1, got: %d\n", value);
-        return -EINVAL;
+    default:
+        return -ENOTTY;
     }
+}
 
-    ret = universal_armoury_acpi_evaluate_method(armoury->acpi_dev,
-                                               armoury->set_egpu_enable_method,
-                                               value, NULL);
-    if (ret)
-        return ret;
+static const struct file_operations universal_armoury_fops = {
+    .owner = THIS_MODULE,
+    .unlocked_ioctl = universal_armoury_ioctl,
+    .compat_ioctl = compat_ptr_ioctl,
+};
 
-    armoury->egpu_state = value;
-    return count;
-}
+static struct miscdevice universal_armoury_miscdev = {
+    .minor = MISC_DYNAMIC_MINOR,
+    .name = "armoury",
+    .fops = &universal_armoury_fops,
+    .mode = 0644,
+};
 
-/* Device attributes */
-static DEVICE_ATTR_RW(gpu_mux);
-static DEVICE_ATTR_RW(dgpu_disable);
-static DEVICE_ATTR_RW(egpu_enable);
+/*
+ * States firmware may revert across suspend. The MUX selection only takes
+ * effect on reboot and firmware keeps it in NVRAM, so it is not rewritten.
+ */
+#define ARMOURY_RESTORE_STATES  (BIT(ARMOURY_STATE_DGPU_DISABLE) | BIT(ARMOURY_STATE_EGPU_ENABLE))
 
-/* Vendor information attributes */
-static ssize_t vendor_show(struct device *dev,
-                         struct device_attribute *attr, char *buf)
+/*
+ * Bring firmware back to the states recorded at suspend. Runs from the
+ * workqueue once tasks are thawed, so it stays off the resume path. One
+ * bulk read where the vendor allows, then only the setters that differ.
+ */
+static void universal_armoury_resume_work(struct work_struct *work)
 {
-    struct acpi_device *adev = to_acpi_device(dev);
-    struct universal_armoury *armoury = adev->driver_data;
-    if (!armoury || !armoury->vendor_name[0])
-        return scnprintf(buf, PAGE_SIZE, "Unknown\n");
-    return scnprintf(buf, PAGE_SIZE, "%s\n", armoury->vendor_name);
-}
+    struct universal_armoury *armoury = container_of(work, struct universal_armoury,
+                                                     resume_work);
+    unsigned long covered = 0, changed = 0, calls;
+    int i, ret;
 
-static ssize_t product_show(struct device *dev,
-                          struct device_attribute *attr, char *buf)
-{
-    struct acpi_device *adev = to_acpi_device(dev);
-    struct universal_armoury *armoury = adev->driver_data;
-    if (!armoury || !armoury->product_name[0])
-        return scnprintf(buf, PAGE_SIZE, "Unknown\n");
-    return scnprintf(buf, PAGE_SIZE, "%s\n", armoury->product_name);
+    mutex_lock(&armoury->lock);
+    calls = atomic_long_read(&armoury->eval_calls);
+
+    universal_armoury_bulk_refresh(armoury, &covered, &changed, ARMOURY_SRC_RESUME);
+    for (i = 0; i < ARMOURY_STATE_COUNT; i++) {
+        if (!(armoury->resume_desired_mask & BIT(i)))
+            continue;
+        if (!(covered & BIT(i)))
+            universal_armoury_read_state(armoury, i, &changed, ARMOURY_SRC_RESUME);
+        if (armoury->cache[i].known &&
+            *armoury_state_ptr(armoury, i) == armoury->resume_desired[i])
+            continue;
+
+        ret = __universal_armoury_set_state(armoury, i, armoury->resume_desired[i],
+                                            ARMOURY_SRC_RESUME);
+        if (ret) {
+            armoury->restore_failures++;
+            dev_warn(&armoury->acpi_dev->dev, "Failed to restore %s after resume: %d\n",
+                     armoury_state_attr_names[i], ret);
+            continue;
+        }
+        armoury->restores++;
+        changed &= ~BIT(i);
+    }
+    armoury->resume_desired_mask = 0;
+    armoury->last_restore_calls = atomic_long_read(&armoury->eval_calls) - calls;
+    armoury->last_restore_ns = ktime_get_ns() - armoury->resume_start_ns;
+    mutex_unlock(&armoury->lock);
+
+    for (i = 0; i < ARMOURY_STATE_COUNT; i++) {
+        if (changed & BIT(i))
+            sysfs_notify(&armoury->acpi_dev->dev.kobj, NULL, armoury_state_attr_names[i]);
+    }
 }
 
-static ssize_t supported_features_show(struct device *dev,
-                                     struct device_attribute *attr, char *buf)
+/*
+ * Firmware-initiated change (hotkey MUX toggle, eGPU dock, ...). Event codes
+ * are not consistent across vendors, so re-read every supported state and
+ * wake pollers only on the attributes whose value actually changed.
+ */
+static void universal_armoury_notify(struct acpi_device *adev, u32 event)
 {
-    struct acpi_device *adev = to_acpi_device(dev);
     struct universal_armoury *armoury = adev->driver_data;
-    if (!armoury)
-        return scnprintf(buf, PAGE_SIZE, "gpu_mux:0 dgpu_disable:0 egpu_enable:0\n");
-    return scnprintf(buf, PAGE_SIZE, "gpu_mux:%d dgpu_disable:%d egpu_enable:%d\n",
-                   armoury->gpu_mux_supported,
-                   armoury->dgpu_disable_supported,
-                   armoury->egpu_supported);
-}
-
-static DEVICE_ATTR_RO(vendor);
-static DEVICE_ATTR_RO(product);
-static DEVICE_ATTR_RO(supported_features);
-
-static struct attribute *universal_armoury_attrs[] = {
-    &dev_attr_gpu_mux.attr,
-    &dev_attr_dgpu_disable.attr,
-    &dev_attr_egpu_enable.attr,
-    &dev_attr_vendor.attr,
-    &dev_attr_product.attr,
-    &dev_attr_supported_features.attr,
-    NULL
-};
+    unsigned long changed;
+    int i;
 
-static const struct attribute_group universal_armoury_attr_group = {
-    .attrs = universal_armoury_attrs,
-};
+    if (!armoury)
+        return;
 
-/* Probe supported features - Universal version */
-static void universal_armoury_probe_features(struct universal_armoury *armoury)
-{
-    u32 result;
-    const char *vendor_str;
+    dev_dbg(&adev->dev, "ACPI notify event 0x%02x\n", event);
 
-    switch (armoury->vendor) {
-    case VENDOR_ASUS:
-        vendor_str = "ASUS";
-        break;
-    case VENDOR_MSI:
-        vendor_str = "MSI";
-        break;
-    case VENDOR_DELL_ALIENWARE:
-        vendor_str = "Dell/Alienware";
-        break;
-    case VENDOR_LENOVO:
-        vendor_str = "Lenovo";
-        break;
-    case VENDOR_HP:
-        vendor_str = "HP";
-        break;
-    case VENDOR_ACER:
-        vendor_str = "Acer";
-        break;
-    case VENDOR_GENERIC:
-        vendor_str = "Generic Gaming Laptop";
-        break;
-    default:
-        vendor_str = "Unknown";
-        break;
+    /* The first probe reads every state and publishes the result itself */
+    if (!smp_load_acquire(&armoury->probed)) {
+        universal_armoury_probe_features(armoury);
+        return;
     }
 
-    dev_info(&armoury->acpi_dev->dev, "Detected %s laptop: %s %s\n",
-             vendor_str, armoury->vendor_name, armoury->product_name);
-
-    /* Test GPU MUX support */
-    if (armoury->get_gpu_mux_method &&
-        !universal_armoury_acpi_evaluate_method(armoury->acpi_dev,
-                                               armoury->get_gpu_mux_method,
-                                               0, &result)) {
-        armoury->gpu_mux_supported = true;
-        armoury->gpu_mux_state = result;
-        dev_info(&armoury->acpi_dev->dev, "GPU MUX control supported\n");
-    }
-
-    /* Test dGPU disable support */
-    if (armoury->get_dgpu_disable_method &&
-        !universal_armoury_acpi_evaluate_method(armoury->acpi_dev,
-                                               armoury->get_dgpu_disable_method,
-                                               0, &result)) {
-        armoury->dgpu_disable_supported = true;
-        armoury->dgpu_disable_state = result;
-        dev_info(&armoury->acpi_dev->dev, "dGPU disable control supported\n");
-    }
-
-    /* Test eGPU support */
-    if (armoury->get_egpu_enable_method &&
-        !universal_armoury_acpi_evaluate_method(armoury->acpi_dev,
-                                               armoury->get_egpu_enable_method,
-                                               0, &result)) {
-        armoury->egpu_supported = true;
-        armoury->egpu_state = result;
-        dev_info(&armoury->acpi_dev->dev, "eGPU control supported\n");
-    }
+    mutex_lock(&armoury->lock);
+    universal_armoury_refresh_all(armoury, &changed, ARMOURY_SRC_FIRMWARE);
+    mutex_unlock(&armoury->lock);
 
-    if (!armoury->gpu_mux_supported && !armoury->dgpu_disable_supported && !armoury->egpu_supported) {
-        /* Try alternative/generic ACPI methods */
-        const char *alt_methods[] = {"GMUX", "_GPU", "DGPU", "SGPU", "MXDS", "MXDM", NULL};
-        int i;
-        
-        dev_warn(&armoury->acpi_dev->dev, "No supported features found. Trying alternative ACPI methods...\n");
-        
-        for (i = 0; alt_methods[i]; i++) {
-            if (!universal_armoury_acpi_evaluate_method(armoury->acpi_dev,
-                                                       alt_methods[i], 0, &result)) {
-                dev_info(&armoury->acpi_dev->dev, "Found working ACPI method: %s\n", alt_methods[i]);
-                if (strstr(alt_methods[i], "MUX") || strstr(alt_methods[i], "MXD")) {
-                    armoury->gpu_mux_supported = true;
-                    armoury->get_gpu_mux_method = alt_methods[i];
-                } else if (strstr(alt_methods[i], "GPU")) {
-                    armoury->dgpu_disable_supported = true;
-                    armoury->get_dgpu_disable_method = alt_methods[i];
-                }
-                break;
-            }
-        }
+    universal_armoury_profile_refresh(armoury);
+    if (!changed)
+        return;
+
+    for (i = 0; i < ARMOURY_STATE_COUNT; i++) {
+        if (changed & BIT(i))
+            sysfs_notify(&adev->dev.kobj, NULL, armoury_state_attr_names[i]);
     }
+    kobject_uevent(&adev->dev.kobj, KOBJ_CHANGE);
 }
 
 static int universal_armoury_add(struct acpi_device *adev)
 {
+    const struct armoury_vendor_desc *desc;
     struct universal_armoury *armoury;
-    int ret;
+    struct pci_dev *dgpu;
+    u64 start = ktime_get_ns();
+    int i, ret;
+
+    /* Detect laptop vendor */
+    desc = detect_laptop_vendor();
+    if (!desc)
+        desc = &armoury_vendor_unknown;
+
+    /* Generic IDs match many nodes, only bind where the methods live */
+    if (!universal_armoury_node_has_methods(adev, desc)) {
+        dev_dbg(&adev->dev, "No %s ACPI methods under this node, not binding\n",
+                desc->name);
+        return -ENODEV;
+    }
+
+    if (desc == &armoury_vendor_unknown) {
+        /* Check if this is a supported system */
+        dev_warn(&adev->dev, "System not in compatibility list, but trying anyway...\n");
+    }
 
     armoury = devm_kzalloc(&adev->dev, sizeof(*armoury), GFP_KERNEL);
     if (!armoury)
         return -ENOMEM;
 
     armoury->acpi_dev = adev;
-    adev->driver_data = armoury;
-    universal_armoury_dev = armoury;
+    mutex_init(&armoury->lock);
+    seqcount_mutex_init(&armoury->cache_seq, &armoury->lock);
+    kref_init(&armoury->users);
+    init_completion(&armoury->released);
+    INIT_LIST_HEAD(&armoury->switch_inflight);
+    INIT_LIST_HEAD(&armoury->switch_reqs);
+    INIT_WORK(&armoury->switch_work, universal_armoury_switch_work);
+    INIT_WORK(&armoury->probe_work, universal_armoury_probe_work);
+    INIT_WORK(&armoury->resume_work, universal_armoury_resume_work);
+    INIT_DELAYED_WORK(&armoury->gov_work, universal_armoury_governor_work);
+    armoury->gov_source = ARMOURY_GOV_UNKNOWN;
+    for (i = 0; i < ARMOURY_STATE_COUNT; i++) {
+        armoury->pending[i].armoury = armoury;
+        armoury->pending[i].id = i;
+        INIT_DELAYED_WORK(&armoury->pending[i].work, universal_armoury_coalesce_work);
+    }
 
-    /* Detect laptop vendor */
-    armoury->vendor = detect_laptop_vendor(armoury);
+    armoury->desc = desc;
+    armoury->vendor = desc->vendor;
+    read_laptop_names(armoury);
     set_vendor_acpi_methods(armoury);
+    universal_armoury_scan_methods(armoury);
 
-    /* Check if this is a supported system */
-    if (!dmi_check_system(universal_armoury_quirks)) {
-        dev_warn(&adev->dev, "System not in compatibility list, but trying anyway...\n");
+    ret = ida_alloc(&universal_armoury_ida, GFP_KERNEL);
+    if (ret < 0)
+        return ret;
+    armoury->index = ret;
+
+    armoury->result_buf = kmalloc(ARMOURY_RESULT_BUF_SIZE, GFP_KERNEL);
+    if (!armoury->result_buf) {
+        ret = -ENOMEM;
+        goto err_free_index;
     }
+    armoury->result_buf_len = ARMOURY_RESULT_BUF_SIZE;
+    atomic_long_inc(&armoury->eval_allocs);
 
-    /* Probe available features */
-    universal_armoury_probe_features(armoury);
+    /* Decide features from method presence, firmware is read later */
+    universal_armoury_detect_features(armoury);
+
+    if (armoury_state_supported(armoury, ARMOURY_STATE_DGPU_DISABLE)) {
+        dgpu = universal_armoury_find_dgpu();
+        if (dgpu)
+            dev_info(&adev->dev, "dGPU at %s, its state is not read while it sleeps\n",
+                     pci_name(dgpu));
+        pci_dev_put(dgpu);
+    }
 
     /* Create sysfs attributes */
+    adev->driver_data = armoury;
     ret = sysfs_create_group(&adev->dev.kobj, &universal_armoury_attr_group);
     if (ret) {
         dev_err(&adev->dev, "Failed to create sysfs attributes: %d\n", ret);
-        return ret;
+        adev->driver_data = NULL;
+        goto err_free_buf;
+    }
+
+    universal_armoury_debugfs_init(armoury);
+
+    mutex_lock(&universal_armoury_devs_lock);
+    list_add_tail(&armoury->node, &universal_armoury_devices);
+    mutex_unlock(&universal_armoury_devs_lock);
+
+    /* Before the group is (re)evaluated below, so its attributes show */
+    universal_armoury_governor_register(armoury);
+
+    if (deferred_probe) {
+        queue_work(universal_armoury_wq, &armoury->probe_work);
+    } else {
+        universal_armoury_probe_features(armoury);
+        universal_armoury_update_visibility(armoury);
     }
 
-    dev_info(&adev->dev, "Universal Armoury driver loaded successfully for %s %s\n",
-             armoury->vendor_name, armoury->product_name);
+    dev_info(&adev->dev, "Universal Armoury driver loaded successfully for %s %s (instance %u) in %llu us\n",
+             armoury->vendor_name, armoury->product_name, armoury->index,
+             div_u64(ktime_get_ns() - start, NSEC_PER_USEC));
     return 0;
+
+err_free_buf:
+    kfree(armoury->result_buf);
+err_free_index:
+    ida_free(&universal_armoury_ida, armoury->index);
+    return ret;
 }
 
 static void universal_armoury_remove(struct acpi_device *adev)
 {
+    struct universal_armoury *armoury = adev->driver_data;
+    int i;
+
+    mutex_lock(&universal_armoury_devs_lock);
+    list_del(&armoury->node);
+    mutex_unlock(&universal_armoury_devs_lock);
+    /* Drop the list's reference and wait for ioctls still using the device */
+    universal_armoury_put(armoury);
+    wait_for_completion(&armoury->released);
+
+    universal_armoury_governor_unregister(armoury);
+    /* The probe work updates the group, so it goes before the group does */
+    cancel_work_sync(&armoury->probe_work);
     sysfs_remove_group(&adev->dev.kobj, &universal_armoury_attr_group);
-    universal_armoury_dev = NULL;
+    debugfs_remove_recursive(armoury->debugfs_dir);
+    /* No sysfs reader is left to finish probing and register it again */
+    universal_armoury_profile_unregister(armoury);
+    cancel_work_sync(&armoury->resume_work);
+    /* No new writes can arrive now, commit parked ones and let queued switches finish */
+    for (i = 0; i < ARMOURY_STATE_COUNT; i++)
+        flush_delayed_work(&armoury->pending[i].work);
+    flush_work(&armoury->switch_work);
+    kfree(armoury->result_buf);
+    ida_free(&universal_armoury_ida, armoury->index);
     dev_info(&adev->dev, "Universal Armoury driver unloaded\n");
 }
 
+/*
+ * Remember the states to restore. Writes still parked for coalescing are
+ * left out: their work item commits them after resume. The workqueue is
+ * already frozen here, so nothing on it is flushed.
+ */
+static int universal_armoury_suspend(struct device *dev)
+{
+    struct universal_armoury *armoury = to_acpi_device(dev)->driver_data;
+    int i;
+
+    if (!armoury)
+        return 0;
+
+    cancel_work_sync(&armoury->resume_work);
+
+    mutex_lock(&armoury->lock);
+    /*
+     * A restore queued at the last resume that never ran leaves its targets
+     * in resume_desired_mask, while the invalidated cache knows nothing.
+     * Keep them and let only states known now override.
+     */
+    for (i = 0; i < ARMOURY_STATE_COUNT; i++) {
+        if (!(ARMOURY_RESTORE_STATES & BIT(i)) || !armoury_state_supported(armoury, i) ||
+            !armoury_state_set_method(armoury, i)->handle)
+            continue;
+        /* The parked write is committed after resume and supersedes it */
+        if (armoury->pending[i].pending) {
+            armoury->resume_desired_mask &= ~BIT(i);
+            continue;
+        }
+        if (!armoury->cache[i].known)
+            continue;
+        armoury->resume_desired[i] = *armoury_state_ptr(armoury, i);
+        armoury->resume_desired_mask |= BIT(i);
+    }
+    mutex_unlock(&armoury->lock);
+
+    return 0;
+}
+
+static int universal_armoury_resume(struct device *dev)
+{
+    struct universal_armoury *armoury = to_acpi_device(dev)->driver_data;
+    u64 start = ktime_get_ns();
+
+    if (!armoury)
+        return 0;
+
+    /* Firmware may have changed states while we were asleep */
+    universal_armoury_cache_invalidate(armoury);
+
+    mutex_lock(&armoury->lock);
+    armoury->resumes++;
+    armoury->resume_start_ns = start;
+    if (armoury->resume_desired_mask)
+        queue_work(universal_armoury_wq, &armoury->resume_work);
+    armoury->last_resume_ns = ktime_get_ns() - start;
+    mutex_unlock(&armoury->lock);
+
+    return 0;
+}
+
+static DEFINE_SIMPLE_DEV_PM_OPS(universal_armoury_pm_ops, universal_armoury_suspend,
+                                universal_armoury_resume);
+
 static struct acpi_driver universal_armoury_driver = {
     .name = DRIVER_NAME,
     .class = DRIVER_NAME,
@@ -744,7 +4292,11 @@ static struct acpi_driver universal_armoury_driver = {
     .ops = {
         .add = universal_armoury_add,
         .remove = universal_armoury_remove,
+        .notify = universal_armoury_notify,
     },
+    .drv.pm = pm_sleep_ptr(&universal_armoury_pm_ops),
+    /* Keep firmware probing off the boot-time ACPI scan */
+    .drv.probe_type = PROBE_PREFER_ASYNCHRONOUS,
 };
 
 static int __init universal_armoury_init(void)
@@ -754,18 +4306,51 @@ static int __init universal_armoury_init(void)
     pr_info("Universal Laptop Armoury driver v%s loading\n", DRIVER_VERSION);
     pr_info("Supports: ASUS, MSI, Dell/Alienware, Lenovo, HP, Acer and generic gaming laptops\n");
 
+    universal_armoury_wq = alloc_ordered_workqueue("universal-armoury", WQ_FREEZABLE);
+    if (!universal_armoury_wq)
+        return -ENOMEM;
+
+    /* Devices publish events from probe on, so the family comes first */
+    ret = genl_register_family(&universal_armoury_genl_family);
+    if (ret) {
+        pr_err("Failed to register generic netlink family: %d\n", ret);
+        destroy_workqueue(universal_armoury_wq);
+        return ret;
+    }
+
+    universal_armoury_debugfs_root = debugfs_create_dir(DRIVER_NAME, NULL);
+    debugfs_create_file("capcache", 0444, universal_armoury_debugfs_root, NULL,
+                        &capcache_fops);
+
     ret = acpi_bus_register_driver(&universal_armoury_driver);
     if (ret) {
         pr_err("Failed to register ACPI driver: %d\n", ret);
-        return ret;
+        goto err_debugfs;
+    }
+
+    ret = misc_register(&universal_armoury_miscdev);
+    if (ret) {
+        pr_err("Failed to register /dev/%s: %d\n", universal_armoury_miscdev.name, ret);
+        acpi_bus_unregister_driver(&universal_armoury_driver);
+        goto err_debugfs;
     }
 
     return 0;
+
+err_debugfs:
+    debugfs_remove_recursive(universal_armoury_debugfs_root);
+    genl_unregister_family(&universal_armoury_genl_family);
+    destroy_workqueue(universal_armoury_wq);
+    return ret;
 }
 
 static void __exit universal_armoury_exit(void)
 {
+    misc_deregister(&universal_armoury_miscdev);
     acpi_bus_unregister_driver(&universal_armoury_driver);
+    debugfs_remove_recursive(universal_armoury_debugfs_root);
+    genl_unregister_family(&universal_armoury_genl_family);
+    destroy_workqueue(universal_armoury_wq);
     pr_info("Universal Laptop Armoury driver unloaded\n");
 }
 
@@ -789,3 +4374,8 @@ MODULE_ALIAS("acpi*:HPQ0001:*");  /* HP */
 MODULE_ALIAS("acpi*:ACR0001:*");  /* Acer */
 MODULE_ALIAS("acpi*:PNP0C02:*");  /* Generic */
 
+/* Built into this file so the tests reach the static functions */
+#if IS_ENABLED(CONFIG_UNIVERSAL_ARMOURY_KUNIT_TEST)
+#include "asus-armoury-test.c"
+#endif
+
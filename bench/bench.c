@@ -0,0 +1,323 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Micro-benchmark of the Universal Armoury driver against mock firmware
+ *
+ * Binds asus-armoury.c to the mock ACPI device of one vendor and drives
+ * its sysfs handlers, the snapshot ioctl and platform_profile the way
+ * userspace would. Each case reports the cost of one call on a single
+ * thread (ns, allocations and firmware evaluations per call) and the
+ * aggregate throughput of several threads calling it at once.
+ *
+ * Copyright (C) 2025
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <linux/acpi.h>
+
+#include "../asus-armoury-uapi.h"
+#include "mock_acpi.h"
+
+struct bench_case {
+    const char *name;
+    const char *mode;
+    const char *ttl_ms;         /* cache_ttl_ms during the case */
+    int (*op)(const struct bench_case *c, unsigned long i);
+    const char *attr;           /* sysfs attribute, for show/store cases */
+    __u32 flags;                /* snapshot flags */
+};
+
+static struct acpi_device bench_adev;
+static unsigned long bench_iters = 100000;
+static int bench_threads = 4;
+
+static int bench_show(const struct bench_case *c, unsigned long i)
+{
+    struct device_attribute *attr = kstub_find_attr(&bench_adev.dev, c->attr);
+    char buf[PAGE_SIZE];
+    ssize_t ret;
+
+    if (!attr || !attr->show)
+        return -ENODEV;
+    ret = attr->show(&bench_adev.dev, attr, buf);
+    return ret < 0 ? ret : 0;
+}
+
+/* Alternate the value so every call is a real firmware write */
+static int bench_store(const struct bench_case *c, unsigned long i)
+{
+    struct device_attribute *attr = kstub_find_attr(&bench_adev.dev, c->attr);
+    ssize_t ret;
+
+    if (!attr || !attr->store)
+        return -ENODEV;
+    ret = attr->store(&bench_adev.dev, attr, i & 1 ? "1\n" : "0\n", 2);
+    return ret < 0 ? ret : 0;
+}
+
+/* Alternate two limits in range so every call is a real firmware write */
+static int bench_store_watts(const struct bench_case *c, unsigned long i)
+{
+    struct device_attribute *attr = kstub_find_attr(&bench_adev.dev, c->attr);
+    ssize_t ret;
+
+    if (!attr || !attr->store)
+        return -ENODEV;
+    ret = attr->store(&bench_adev.dev, attr, i & 1 ? "60\n" : "45\n", 3);
+    return ret < 0 ? ret : 0;
+}
+
+/* Alternate two valid curves so every call uploads a new one */
+static int bench_store_curve(const struct bench_case *c, unsigned long i)
+{
+    static const char * const curves[] = {
+        "30:0 40:10 50:20 60:35 70:50 80:65 90:80 100:100\n",
+        "35:5 45:15 55:25 65:40 75:55 85:70 95:85 105:100\n",
+    };
+    struct device_attribute *attr = kstub_find_attr(&bench_adev.dev, c->attr);
+    const char *buf = curves[i & 1];
+    ssize_t ret;
+
+    if (!attr || !attr->store)
+        return -ENODEV;
+    ret = attr->store(&bench_adev.dev, attr, buf, strlen(buf));
+    return ret < 0 ? ret : 0;
+}
+
+static int bench_snapshot(const struct bench_case *c, unsigned long i)
+{
+    const struct file_operations *fops = kstub_misc_fops();
+    /* Fresh snapshots are refused on a read-only descriptor */
+    struct file file = { .f_mode = c->flags ? FMODE_READ | FMODE_WRITE : FMODE_READ };
+    struct armoury_snapshot snap = { .index = 0, .flags = c->flags };
+
+    if (!fops)
+        return -ENODEV;
+    return fops->unlocked_ioctl(&file, ARMOURY_IOC_SNAPSHOT, (unsigned long)&snap);
+}
+
+static int bench_profile_get(const struct bench_case *c, unsigned long i)
+{
+    enum platform_profile_option profile;
+
+    return kstub_profile_get(&profile);
+}
+
+static int bench_profile_set(const struct bench_case *c, unsigned long i)
+{
+    return kstub_profile_set(i & 1 ? PLATFORM_PROFILE_PERFORMANCE :
+                                     PLATFORM_PROFILE_BALANCED);
+}
+
+static const struct bench_case bench_cases[] = {
+    { "gpu_mux_show", "cached", "60000", bench_show, "gpu_mux" },
+    { "gpu_mux_show", "firmware", "0", bench_show, "gpu_mux" },
+    { "gpu_mux_store", "firmware", "60000", bench_store, "gpu_mux" },
+    { "dgpu_disable_show", "cached", "60000", bench_show, "dgpu_disable" },
+    { "dgpu_disable_show", "firmware", "0", bench_show, "dgpu_disable" },
+    { "dgpu_disable_store", "firmware", "60000", bench_store, "dgpu_disable" },
+    { "egpu_enable_show", "cached", "60000", bench_show, "egpu_enable" },
+    { "egpu_enable_show", "firmware", "0", bench_show, "egpu_enable" },
+    { "egpu_enable_store", "firmware", "60000", bench_store, "egpu_enable" },
+    { "supported_features", "-", "60000", bench_show, "supported_features" },
+    { "ioctl_snapshot", "cached", "60000", bench_snapshot },
+    { "ioctl_snapshot", "fresh", "60000", bench_snapshot, NULL, ARMOURY_SNAPSHOT_FRESH },
+    { "platform_profile_get", "cached", "60000", bench_profile_get },
+    { "platform_profile_set", "firmware", "60000", bench_profile_set },
+    { "cpu_fan_curve_show", "firmware", "60000", bench_show, "cpu_fan_curve" },
+    { "cpu_fan_curve_store", "firmware", "60000", bench_store_curve, "cpu_fan_curve" },
+    { "fan_curve_reset", "firmware", "60000", bench_store, "fan_curve_reset" },
+    { "ppt_pl1_spl_show", "firmware", "60000", bench_show, "ppt_pl1_spl" },
+    { "ppt_pl1_spl_store", "firmware", "60000", bench_store_watts, "ppt_pl1_spl" },
+    { "ppt_pl1_spl_max", "-", "60000", bench_show, "ppt_pl1_spl_max" },
+};
+
+struct bench_thread {
+    pthread_t thread;
+    const struct bench_case *c;
+    pthread_barrier_t *start;
+    unsigned long errors;
+};
+
+static void *bench_thread_fn(void *arg)
+{
+    struct bench_thread *t = arg;
+    unsigned long i;
+
+    pthread_barrier_wait(t->start);
+    for (i = 0; i < bench_iters; i++) {
+        if (t->c->op(t->c, i))
+            t->errors++;
+    }
+    return NULL;
+}
+
+/* Aggregate calls per second of bench_threads threads */
+static double bench_parallel(const struct bench_case *c, unsigned long *errors)
+{
+    struct bench_thread *threads = calloc(bench_threads, sizeof(*threads));
+    pthread_barrier_t start;
+    u64 t0;
+    int i;
+
+    if (!threads)
+        return 0;
+
+    pthread_barrier_init(&start, NULL, bench_threads + 1);
+    for (i = 0; i < bench_threads; i++) {
+        threads[i].c = c;
+        threads[i].start = &start;
+        pthread_create(&threads[i].thread, NULL, bench_thread_fn, &threads[i]);
+    }
+    t0 = ktime_get_ns();
+    pthread_barrier_wait(&start);
+    for (i = 0; i < bench_threads; i++) {
+        pthread_join(threads[i].thread, NULL);
+        *errors += threads[i].errors;
+    }
+    t0 = ktime_get_ns() - t0;
+    pthread_barrier_destroy(&start);
+    free(threads);
+
+    return (double)bench_iters * bench_threads * 1e9 / (t0 ? t0 : 1);
+}
+
+static void bench_run(const struct bench_case *c)
+{
+    unsigned long i, errors = 0;
+    u64 t0, allocs, calls;
+    double ops;
+    int ret;
+
+    kstub_param_set("cache_ttl_ms", c->ttl_ms);
+    ret = c->op(c, 0);
+    if (ret == -ENODEV || ret == -EOPNOTSUPP) {
+        printf("%-22s %-9s %12s\n", c->name, c->mode, "unsupported");
+        return;
+    }
+    for (i = 1; i < 1000; i++)
+        c->op(c, i);
+
+    allocs = kstub_allocs();
+    calls = mock_acpi_calls();
+    t0 = ktime_get_ns();
+    for (i = 0; i < bench_iters; i++) {
+        if (c->op(c, i))
+            errors++;
+    }
+    t0 = ktime_get_ns() - t0;
+    allocs = kstub_allocs() - allocs;
+    calls = mock_acpi_calls() - calls;
+
+    ops = bench_parallel(c, &errors);
+
+    printf("%-22s %-9s %10.1f %10.3f %10.3f %8lu %14.0f\n", c->name, c->mode,
+           (double)t0 / bench_iters, (double)allocs / bench_iters,
+           (double)calls / bench_iters, errors, ops);
+}
+
+static void bench_usage(const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s [-V vendor] [-n iterations] [-t threads] [-l latency_ns]\n"
+            "          [-f fail_every] [-m method] [-p] [-e] [-v]\n"
+            "  -V  mock machine: %s (default asus)\n"
+            "  -n  calls per thread and case (default %lu)\n"
+            "  -t  threads for the throughput column (default %d)\n"
+            "  -l  firmware latency per method call in ns (default 0)\n"
+            "  -f  fail every Nth firmware call (default 0, never)\n"
+            "  -m  apply -l/-f to this ACPI method only (e.g. DGPU)\n"
+            "  -p  evaluate methods by pathname instead of the cached handle\n"
+            "  -e  pretend netlink listeners are subscribed\n"
+            "  -v  print driver log messages\n",
+            prog, mock_acpi_vendor_names(), bench_iters, bench_threads);
+}
+
+int main(int argc, char **argv)
+{
+    const char *vendor = "asus", *method = NULL;
+    unsigned long latency = 0, fail_every = 0;
+    bool pathname = false;
+    size_t i;
+    int opt, ret;
+
+    while ((opt = getopt(argc, argv, "V:n:t:l:f:m:pevh")) != -1) {
+        switch (opt) {
+        case 'V':
+            vendor = optarg;
+            break;
+        case 'n':
+            bench_iters = strtoul(optarg, NULL, 0);
+            break;
+        case 't':
+            bench_threads = atoi(optarg);
+            break;
+        case 'l':
+            latency = strtoul(optarg, NULL, 0);
+            break;
+        case 'f':
+            fail_every = strtoul(optarg, NULL, 0);
+            break;
+        case 'm':
+            method = optarg;
+            break;
+        case 'p':
+            pathname = true;
+            break;
+        case 'e':
+            kstub_genl_listeners = true;
+            break;
+        case 'v':
+            kstub_verbose = 1;
+            break;
+        default:
+            bench_usage(argv[0]);
+            return opt == 'h' ? 0 : 2;
+        }
+    }
+    if (!bench_iters || bench_threads < 1) {
+        bench_usage(argv[0]);
+        return 2;
+    }
+
+    if (mock_acpi_init(vendor)) {
+        fprintf(stderr, "unknown vendor %s, expected one of: %s\n", vendor,
+                mock_acpi_vendor_names());
+        return 2;
+    }
+    if (mock_acpi_set_latency(method, latency) || mock_acpi_set_failure(method, fail_every)) {
+        fprintf(stderr, "no method %s on the %s machine\n", method, vendor);
+        return 2;
+    }
+    mock_acpi_set_pathname(pathname);
+
+    ret = kstub_module_init();
+    if (ret) {
+        fprintf(stderr, "module init failed: %d\n", ret);
+        return 1;
+    }
+
+    bench_adev.handle = mock_acpi_device();
+    bench_adev.dev.kobj.name = "ATK4001:00";
+    ret = kstub_acpi_bind(&bench_adev);
+    if (ret) {
+        fprintf(stderr, "driver did not bind to the %s machine: %d\n", vendor, ret);
+        kstub_module_exit();
+        return 1;
+    }
+
+    printf("vendor %s, %lu calls per case, %d threads, latency %lu ns, fail every %lu, %s\n\n",
+           vendor, bench_iters, bench_threads, latency, fail_every,
+           pathname ? "pathname lookup" : "cached handles");
+    printf("%-22s %-9s %10s %10s %10s %8s %14s\n", "case", "mode", "ns/op",
+           "allocs/op", "fwcalls/op", "errors", "ops/s");
+    for (i = 0; i < ARRAY_SIZE(bench_cases); i++)
+        bench_run(&bench_cases[i]);
+
+    kstub_acpi_unbind(&bench_adev);
+    kstub_module_exit();
+
+    return 0;
+}
@@ -0,0 +1,784 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Userspace stand-ins for the kernel interfaces asus-armoury.c uses
+ *
+ * Locking, atomics, allocation and work items keep their kernel semantics
+ * because the benchmark measures them. Interfaces that only matter on a
+ * real system (debugfs, tracepoints, PCI) are inert. The headers under
+ * linux/ and net/ just include this file.
+ */
+
+#ifndef _BENCH_KSTUB_H
+#define _BENCH_KSTUB_H
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/types.h>
+
+/* Types */
+typedef uint8_t u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef unsigned long long u64;
+typedef int8_t s8;
+typedef int16_t s16;
+typedef int32_t s32;
+typedef long long s64;
+typedef u8 __u8;
+typedef u16 __u16;
+typedef u32 __u32;
+typedef u64 __u64;
+typedef s32 __s32;
+typedef s64 __s64;
+typedef unsigned int gfp_t;
+typedef unsigned short umode_t;
+typedef unsigned int fmode_t;
+
+#define GFP_KERNEL                     0U
+#define PAGE_SIZE                      4096UL
+
+/* Build environment */
+#define KERNEL_VERSION(a, b, c)        (((a) << 16) + ((b) << 8) + (c))
+#define LINUX_VERSION_CODE             KERNEL_VERSION(6, 15, 0)
+/* IS_ENABLED/IS_REACHABLE(CONFIG_FOO) are true when KSTUB_CONFIG_FOO is defined to 1 */
+#define IS_ENABLED(option)             KSTUB_##option
+#define IS_REACHABLE(option)           KSTUB_##option
+#define KSTUB_CONFIG_ACPI_PLATFORM_PROFILE 1
+
+#define __init
+#define __exit
+#define __user
+#define __maybe_unused                 __attribute__((unused))
+#define fallthrough                    __attribute__((fallthrough))
+#define likely(x)                      __builtin_expect(!!(x), 1)
+#define unlikely(x)                    __builtin_expect(!!(x), 0)
+#undef static_assert
+#define static_assert(expr, ...)       _Static_assert(expr, #expr)
+
+#define ARRAY_SIZE(a)                  (sizeof(a) / sizeof((a)[0]))
+#define container_of(ptr, type, member) \
+    ((type *)((char *)(ptr) - offsetof(type, member)))
+#define min(a, b)                      ((a) < (b) ? (a) : (b))
+#define max(a, b)                      ((a) > (b) ? (a) : (b))
+#define min_t(t, a, b)                 ((t)(a) < (t)(b) ? (t)(a) : (t)(b))
+#define max_t(t, a, b)                 ((t)(a) > (t)(b) ? (t)(a) : (t)(b))
+#define clamp(v, lo, hi)               min(max(v, lo), hi)
+
+#define IS_ERR_VALUE(x)                ((unsigned long)(x) >= (unsigned long)-4095)
+#define IS_ERR(p)                      IS_ERR_VALUE(p)
+#define PTR_ERR(p)                     ((long)(p))
+#define ERR_PTR(e)                     ((void *)(long)(e))
+#define IS_ERR_OR_NULL(p)              (!(p) || IS_ERR(p))
+
+/* Modules and parameters; kstub_param_set() writes them by name */
+struct kstub_param {
+    const char *name;
+    const char *type;
+    void *arg;
+};
+
+#define module_param(n, t, perm)                                        \
+    static const struct kstub_param __kstub_param_##n                   \
+    __attribute__((used, section("kstub_param"), aligned(sizeof(void *)))) = \
+        { #n, #t, &n }
+
+/* Parameters with their own setter, reached through kstub_param_set() too */
+struct kernel_param;
+
+struct kernel_param_ops {
+    int (*set)(const char *val, const struct kernel_param *kp);
+    int (*get)(char *buffer, const struct kernel_param *kp);
+};
+
+struct kernel_param {
+    const char *name;
+    const struct kernel_param_ops *ops;
+    void *arg;
+};
+
+#define module_param_cb(n, o, a, perm)                                  \
+    static const struct kernel_param __kstub_kp_##n = { #n, o, a };     \
+    static const struct kstub_param __kstub_param_##n                   \
+    __attribute__((used, section("kstub_param"), aligned(sizeof(void *)))) = \
+        { #n, "cb", (void *)&__kstub_kp_##n }
+
+int param_set_bool(const char *val, const struct kernel_param *kp);
+int param_get_bool(char *buffer, const struct kernel_param *kp);
+
+#define MODULE_PARM_DESC(n, d)
+#define MODULE_AUTHOR(a)
+#define MODULE_DESCRIPTION(d)
+#define MODULE_LICENSE(l)
+#define MODULE_VERSION(v)
+#define MODULE_ALIAS(a)
+#define MODULE_DEVICE_TABLE(t, n)
+#define THIS_MODULE                    NULL
+#define module_init(fn)                int kstub_module_init(void) { return fn(); }
+#define module_exit(fn)                void kstub_module_exit(void) { fn(); }
+
+int kstub_module_init(void);
+void kstub_module_exit(void);
+int kstub_param_set(const char *name, const char *val);
+
+/* Logging, quiet unless kstub_verbose is set */
+extern int kstub_verbose;
+int printk(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+#define pr_info(fmt, ...)              printk(fmt, ##__VA_ARGS__)
+#define pr_warn(fmt, ...)              printk(fmt, ##__VA_ARGS__)
+#define pr_err(fmt, ...)               printk(fmt, ##__VA_ARGS__)
+#define dev_info(d, fmt, ...)          ((void)(d), printk(fmt, ##__VA_ARGS__))
+#define dev_warn(d, fmt, ...)          ((void)(d), printk(fmt, ##__VA_ARGS__))
+#define dev_err(d, fmt, ...)           ((void)(d), printk(fmt, ##__VA_ARGS__))
+#define dev_dbg(d, fmt, ...)           do { if (0) printk(fmt, ##__VA_ARGS__); } while (0)
+
+/* Strings and parsing */
+int scnprintf(char *buf, size_t size, const char *fmt, ...)
+    __attribute__((format(printf, 3, 4)));
+ssize_t strscpy(char *dst, const char *src, size_t size);
+char *strim(char *s);
+char *skip_spaces(const char *s);
+int sscanf(const char *str, const char *fmt, ...);
+int kstrtoint(const char *s, unsigned int base, int *res);
+int kstrtouint(const char *s, unsigned int base, unsigned int *res);
+int kstrtoul(const char *s, unsigned int base, unsigned long *res);
+
+/* Allocation, counted so the benchmark can report allocations per call */
+void *kmalloc(size_t size, gfp_t flags);
+void *kzalloc(size_t size, gfp_t flags);
+void kfree(const void *p);
+char *kmemdup_nul(const char *s, size_t len, gfp_t flags);
+u64 kstub_allocs(void);
+
+/* Bits and arithmetic */
+#define BIT(n)                         (1UL << (n))
+#define BIT_ULL(n)                     (1ULL << (n))
+#define GENMASK(h, l)                  (((~0UL) << (l)) & (~0UL >> (63 - (h))))
+
+static inline int fls64(u64 x)
+{
+    return x ? 64 - __builtin_clzll(x) : 0;
+}
+
+static inline void set_bit(long nr, volatile unsigned long *addr)
+{
+    __atomic_fetch_or(&addr[nr / 64], 1UL << (nr % 64), __ATOMIC_RELAXED);
+}
+
+static inline u64 div_u64(u64 dividend, u32 divisor)
+{
+    return dividend / divisor;
+}
+
+static inline u64 div64_u64(u64 dividend, u64 divisor)
+{
+    return dividend / divisor;
+}
+
+/* Time; one jiffy is a millisecond */
+#define HZ                             1000
+#define NSEC_PER_USEC                  1000L
+#define NSEC_PER_MSEC                  1000000L
+u64 ktime_get_ns(void);
+#define jiffies                        ((unsigned long)(ktime_get_ns() / NSEC_PER_MSEC))
+#define msecs_to_jiffies(ms)           ((unsigned long)(ms))
+#define time_after(a, b)               ((long)((b) - (a)) < 0)
+#define time_before(a, b)              time_after(b, a)
+
+/* Memory ordering */
+#define READ_ONCE(x)                   (*(const volatile __typeof__(x) *)&(x))
+#define WRITE_ONCE(x, v)               (*(volatile __typeof__(x) *)&(x) = (v))
+#define smp_load_acquire(p)            __atomic_load_n(p, __ATOMIC_ACQUIRE)
+#define smp_store_release(p, v)        __atomic_store_n(p, v, __ATOMIC_RELEASE)
+
+typedef struct {
+    long counter;
+} atomic_long_t;
+
+static inline long atomic_long_read(const atomic_long_t *v)
+{
+    return __atomic_load_n(&v->counter, __ATOMIC_RELAXED);
+}
+
+static inline void atomic_long_set(atomic_long_t *v, long i)
+{
+    __atomic_store_n(&v->counter, i, __ATOMIC_RELAXED);
+}
+
+static inline void atomic_long_add(long i, atomic_long_t *v)
+{
+    __atomic_fetch_add(&v->counter, i, __ATOMIC_RELAXED);
+}
+
+static inline void atomic_long_inc(atomic_long_t *v)
+{
+    atomic_long_add(1, v);
+}
+
+/* Locking */
+struct mutex {
+    pthread_mutex_t m;
+};
+
+#define DEFINE_MUTEX(n)                struct mutex n = { PTHREAD_MUTEX_INITIALIZER }
+#define lockdep_assert_held(l)         ((void)(l))
+
+static inline void mutex_init(struct mutex *lock)
+{
+    pthread_mutex_init(&lock->m, NULL);
+}
+
+static inline void mutex_lock(struct mutex *lock)
+{
+    pthread_mutex_lock(&lock->m);
+}
+
+static inline void mutex_unlock(struct mutex *lock)
+{
+    pthread_mutex_unlock(&lock->m);
+}
+
+static inline void cpu_relax(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#else
+    __asm__ __volatile__("" ::: "memory");
+#endif
+}
+
+typedef struct {
+    unsigned int sequence;
+    struct mutex *lock;
+} seqcount_mutex_t;
+
+static inline void seqcount_mutex_init(seqcount_mutex_t *s, struct mutex *lock)
+{
+    s->sequence = 0;
+    s->lock = lock;
+}
+
+static inline unsigned int read_seqcount_begin(const seqcount_mutex_t *s)
+{
+    unsigned int seq;
+
+    while ((seq = __atomic_load_n(&s->sequence, __ATOMIC_ACQUIRE)) & 1)
+        cpu_relax();
+    return seq;
+}
+
+static inline int read_seqcount_retry(const seqcount_mutex_t *s, unsigned int start)
+{
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(&s->sequence, __ATOMIC_RELAXED) != start;
+}
+
+static inline void write_seqcount_begin(seqcount_mutex_t *s)
+{
+    __atomic_store_n(&s->sequence, s->sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static inline void write_seqcount_end(seqcount_mutex_t *s)
+{
+    __atomic_store_n(&s->sequence, s->sequence + 1, __ATOMIC_RELEASE);
+}
+
+/* Reference counts and completions */
+struct kref {
+    int refcount;
+};
+
+static inline void kref_init(struct kref *kref)
+{
+    __atomic_store_n(&kref->refcount, 1, __ATOMIC_RELAXED);
+}
+
+static inline void kref_get(struct kref *kref)
+{
+    __atomic_add_fetch(&kref->refcount, 1, __ATOMIC_RELAXED);
+}
+
+static inline int kref_put(struct kref *kref, void (*release)(struct kref *kref))
+{
+    if (__atomic_sub_fetch(&kref->refcount, 1, __ATOMIC_ACQ_REL))
+        return 0;
+    release(kref);
+    return 1;
+}
+
+struct completion {
+    pthread_mutex_t m;
+    pthread_cond_t c;
+    bool done;
+};
+
+#define DECLARE_COMPLETION_ONSTACK(n)                                   \
+    struct completion n = { PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, false }
+
+static inline void init_completion(struct completion *x)
+{
+    pthread_mutex_init(&x->m, NULL);
+    pthread_cond_init(&x->c, NULL);
+    x->done = false;
+}
+
+static inline void complete_all(struct completion *x)
+{
+    pthread_mutex_lock(&x->m);
+    x->done = true;
+    pthread_cond_broadcast(&x->c);
+    pthread_mutex_unlock(&x->m);
+}
+
+static inline void complete(struct completion *x)
+{
+    complete_all(x);
+}
+
+static inline void wait_for_completion(struct completion *x)
+{
+    pthread_mutex_lock(&x->m);
+    while (!x->done)
+        pthread_cond_wait(&x->c, &x->m);
+    pthread_mutex_unlock(&x->m);
+}
+
+/* Lists */
+struct list_head {
+    struct list_head *next, *prev;
+};
+
+#define LIST_HEAD(n)                   struct list_head n = { &(n), &(n) }
+#define list_entry(p, type, member)    container_of(p, type, member)
+#define list_for_each_entry(pos, head, member)                          \
+    for (pos = list_entry((head)->next, __typeof__(*pos), member);      \
+         &pos->member != (head);                                        \
+         pos = list_entry(pos->member.next, __typeof__(*pos), member))
+#define list_for_each_entry_reverse(pos, head, member)                  \
+    for (pos = list_entry((head)->prev, __typeof__(*pos), member);      \
+         &pos->member != (head);                                        \
+         pos = list_entry(pos->member.prev, __typeof__(*pos), member))
+#define list_first_entry_or_null(head, type, member)                    \
+    ((head)->next != (head) ? list_entry((head)->next, type, member) : NULL)
+
+static inline void INIT_LIST_HEAD(struct list_head *head)
+{
+    head->next = head->prev = head;
+}
+
+static inline void list_add(struct list_head *n, struct list_head *head)
+{
+    n->prev = head;
+    n->next = head->next;
+    head->next->prev = n;
+    head->next = n;
+}
+
+static inline void list_add_tail(struct list_head *n, struct list_head *head)
+{
+    n->prev = head->prev;
+    n->next = head;
+    head->prev->next = n;
+    head->prev = n;
+}
+
+static inline void list_del(struct list_head *n)
+{
+    n->prev->next = n->next;
+    n->next->prev = n->prev;
+    n->next = n->prev = NULL;
+}
+
+/* IDs */
+struct ida {
+    unsigned long bits;
+};
+
+#define DEFINE_IDA(n)                  struct ida n = { 0 }
+int ida_alloc(struct ida *ida, gfp_t flags);
+void ida_free(struct ida *ida, unsigned int id);
+
+/* Work items, run by one thread per workqueue */
+struct work_struct;
+struct workqueue_struct;
+typedef void (*work_func_t)(struct work_struct *work);
+
+struct work_struct {
+    work_func_t func;
+    struct workqueue_struct *wq;
+    struct work_struct *next;
+    u64 due_ns;
+    bool pending;
+};
+
+struct delayed_work {
+    struct work_struct work;
+};
+
+#define WQ_FREEZABLE                   (1U << 2)
+#define INIT_WORK(w, f)                kstub_init_work(w, f)
+#define INIT_DELAYED_WORK(w, f)        kstub_init_work(&(w)->work, f)
+#define to_delayed_work(w)             container_of(w, struct delayed_work, work)
+
+void kstub_init_work(struct work_struct *work, work_func_t func);
+struct workqueue_struct *alloc_ordered_workqueue(const char *fmt, unsigned int flags, ...);
+void destroy_workqueue(struct workqueue_struct *wq);
+bool queue_work(struct workqueue_struct *wq, struct work_struct *work);
+bool mod_delayed_work(struct workqueue_struct *wq, struct delayed_work *dwork,
+                      unsigned long delay);
+bool cancel_work_sync(struct work_struct *work);
+bool cancel_delayed_work_sync(struct delayed_work *dwork);
+bool flush_work(struct work_struct *work);
+bool flush_delayed_work(struct delayed_work *dwork);
+void flush_workqueue(struct workqueue_struct *wq);
+
+/* Notifier chains, never called by the mock */
+struct notifier_block;
+typedef int (*notifier_fn_t)(struct notifier_block *nb, unsigned long action, void *data);
+
+struct notifier_block {
+    notifier_fn_t notifier_call;
+    struct notifier_block *next;
+    int priority;
+};
+
+#define NOTIFY_DONE                    0x0000
+#define NOTIFY_OK                      0x0001
+
+/* Devices and sysfs */
+struct kobject {
+    const char *name;
+};
+
+struct device_driver {
+    const char *name;
+    int probe_type;
+    const struct dev_pm_ops *pm;
+};
+
+struct kstub_devres;
+
+struct device {
+    struct kobject kobj;
+    struct device_driver *driver;
+    void *driver_data;
+    struct kstub_devres *devres;
+};
+
+#define PROBE_PREFER_ASYNCHRONOUS      1
+
+static inline const char *dev_name(const struct device *dev)
+{
+    return dev->kobj.name;
+}
+
+static inline void *dev_get_drvdata(const struct device *dev)
+{
+    return dev->driver_data;
+}
+
+void *devm_kzalloc(struct device *dev, size_t size, gfp_t flags);
+
+struct attribute {
+    const char *name;
+    umode_t mode;
+};
+
+struct device_attribute {
+    struct attribute attr;
+    ssize_t (*show)(struct device *dev, struct device_attribute *attr, char *buf);
+    ssize_t (*store)(struct device *dev, struct device_attribute *attr,
+                     const char *buf, size_t count);
+};
+
+#define __ATTR(n, m, s, st)            { .attr = { .name = #n, .mode = m }, .show = s, .store = st }
+#define DEVICE_ATTR_RW(n)              struct device_attribute dev_attr_##n = __ATTR(n, 0644, n##_show, n##_store)
+#define DEVICE_ATTR_RO(n)              struct device_attribute dev_attr_##n = __ATTR(n, 0444, n##_show, NULL)
+#define DEVICE_ATTR_WO(n)              struct device_attribute dev_attr_##n = __ATTR(n, 0200, NULL, n##_store)
+#define DEVICE_ATTR(n, m, s, st)       struct device_attribute dev_attr_##n = __ATTR(n, m, s, st)
+#define kobj_to_dev(k)                 container_of(k, struct device, kobj)
+
+struct attribute_group {
+    const char *name;
+    struct attribute **attrs;
+    umode_t (*is_visible)(struct kobject *kobj, struct attribute *attr, int n);
+};
+
+int sysfs_create_group(struct kobject *kobj, const struct attribute_group *grp);
+void sysfs_remove_group(struct kobject *kobj, const struct attribute_group *grp);
+int sysfs_update_group(struct kobject *kobj, const struct attribute_group *grp);
+void sysfs_notify(struct kobject *kobj, const char *dir, const char *attr);
+
+enum kobject_action {
+    KOBJ_ADD,
+    KOBJ_REMOVE,
+    KOBJ_CHANGE,
+};
+
+int kobject_uevent(struct kobject *kobj, enum kobject_action action);
+
+/* Power management */
+struct dev_pm_ops {
+    int (*suspend)(struct device *dev);
+    int (*resume)(struct device *dev);
+};
+
+#define DEFINE_SIMPLE_DEV_PM_OPS(n, s, r) \
+    const struct dev_pm_ops n = { .suspend = s, .resume = r }
+#define pm_sleep_ptr(p)                (p)
+
+/* PCI; the mock machine has no discrete GPU */
+struct pci_bus;
+
+struct pci_dev {
+    struct device dev;
+    struct pci_bus *bus;
+    unsigned short vendor;
+};
+
+#define PCI_BASE_CLASS_DISPLAY         0x03
+#define PCI_VENDOR_ID_ATI              0x1002
+#define PCI_VENDOR_ID_AMD              0x1022
+#define PCI_VENDOR_ID_NVIDIA           0x10de
+
+static inline struct pci_dev *pci_get_base_class(unsigned int class, struct pci_dev *from)
+{
+    return NULL;
+}
+
+static inline bool pci_is_root_bus(struct pci_bus *bus)
+{
+    return true;
+}
+
+static inline bool pci_is_thunderbolt_attached(struct pci_dev *pdev)
+{
+    return false;
+}
+
+static inline bool pci_pr3_present(struct pci_dev *pdev)
+{
+    return false;
+}
+
+static inline const char *pci_name(const struct pci_dev *pdev)
+{
+    return dev_name(&pdev->dev);
+}
+
+static inline void pci_dev_put(struct pci_dev *pdev)
+{
+}
+
+static inline bool pm_runtime_suspended(struct device *dev)
+{
+    return false;
+}
+
+/* Files, ioctls, misc devices */
+struct inode {
+    void *i_private;
+};
+
+struct file {
+    fmode_t f_mode;
+    void *private_data;
+};
+
+#define FMODE_READ                     0x1
+#define FMODE_WRITE                    0x2
+
+/* The benchmark runs unprivileged */
+#define CAP_SYS_ADMIN                  21
+
+static inline bool capable(int cap)
+{
+    return false;
+}
+
+struct file_operations {
+    void *owner;
+    int (*open)(struct inode *inode, struct file *file);
+    int (*release)(struct inode *inode, struct file *file);
+    long (*unlocked_ioctl)(struct file *file, unsigned int cmd, unsigned long arg);
+    long (*compat_ioctl)(struct file *file, unsigned int cmd, unsigned long arg);
+};
+
+#define _IOC(d, t, n, sz)              (((d##U) << 30) | ((t) << 8) | (n) | ((sz) << 16))
+#define _IO(t, n)                      _IOC(0, (t), (n), 0)
+#define _IOR(t, n, ty)                 _IOC(2, (t), (n), sizeof(ty))
+#define _IOW(t, n, ty)                 _IOC(1, (t), (n), sizeof(ty))
+#define _IOWR(t, n, ty)                _IOC(3, (t), (n), sizeof(ty))
+
+static inline unsigned long copy_to_user(void __user *to, const void *from, unsigned long n)
+{
+    memcpy(to, from, n);
+    return 0;
+}
+
+static inline unsigned long copy_from_user(void *to, const void __user *from, unsigned long n)
+{
+    memcpy(to, from, n);
+    return 0;
+}
+
+long compat_ptr_ioctl(struct file *file, unsigned int cmd, unsigned long arg);
+
+#define MISC_DYNAMIC_MINOR             255
+
+struct miscdevice {
+    int minor;
+    const char *name;
+    const struct file_operations *fops;
+    umode_t mode;
+};
+
+int misc_register(struct miscdevice *misc);
+void misc_deregister(struct miscdevice *misc);
+
+/* debugfs behaves as if CONFIG_DEBUG_FS were off */
+struct dentry;
+
+struct seq_file {
+    void *private;
+};
+
+int seq_printf(struct seq_file *m, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+void seq_puts(struct seq_file *m, const char *s);
+int single_open(struct file *file, int (*show)(struct seq_file *, void *), void *data);
+
+#define DEFINE_SHOW_ATTRIBUTE(n)                                        \
+    static int n##_open(struct inode *inode, struct file *file)         \
+    {                                                                   \
+        return single_open(file, n##_show, inode->i_private);           \
+    }                                                                   \
+    static const struct file_operations n##_fops = { .open = n##_open }
+
+static inline struct dentry *debugfs_create_dir(const char *name, struct dentry *parent)
+{
+    return ERR_PTR(-ENODEV);
+}
+
+static inline struct dentry *debugfs_create_file(const char *name, umode_t mode,
+                                                 struct dentry *parent, void *data,
+                                                 const struct file_operations *fops)
+{
+    return ERR_PTR(-ENODEV);
+}
+
+static inline void debugfs_remove_recursive(struct dentry *dentry)
+{
+}
+
+/* Firmware files; none are installed */
+struct firmware {
+    size_t size;
+    const u8 *data;
+};
+
+static inline int firmware_request_nowarn(const struct firmware **fw, const char *name,
+                                          struct device *dev)
+{
+    return -ENOENT;
+}
+
+static inline void release_firmware(const struct firmware *fw)
+{
+}
+
+/* Generic netlink; kstub_genl_listeners decides whether events are built */
+struct sk_buff;
+struct net {
+    int unused;
+};
+
+extern struct net init_net;
+extern bool kstub_genl_listeners;
+
+struct genl_multicast_group {
+    const char *name;
+};
+
+struct genl_family {
+    const char *name;
+    unsigned int version;
+    unsigned int maxattr;
+    void *module;
+    const struct genl_multicast_group *mcgrps;
+    unsigned int n_mcgrps;
+};
+
+#define NLMSG_GOODSIZE                 3776
+
+static inline int genl_register_family(struct genl_family *family)
+{
+    return 0;
+}
+
+static inline int genl_unregister_family(const struct genl_family *family)
+{
+    return 0;
+}
+
+static inline int genl_has_listeners(const struct genl_family *family, struct net *net,
+                                     unsigned int group)
+{
+    return kstub_genl_listeners;
+}
+
+struct sk_buff *genlmsg_new(size_t payload, gfp_t flags);
+void *genlmsg_put(struct sk_buff *skb, u32 portid, u32 seq,
+                  const struct genl_family *family, int flags, u8 cmd);
+void genlmsg_end(struct sk_buff *skb, void *hdr);
+int genlmsg_multicast(const struct genl_family *family, struct sk_buff *skb,
+                      u32 portid, unsigned int group, gfp_t flags);
+void nlmsg_free(struct sk_buff *skb);
+int nla_put_u32(struct sk_buff *skb, int type, u32 value);
+int nla_put_s32(struct sk_buff *skb, int type, s32 value);
+int nla_put_u64_64bit(struct sk_buff *skb, int type, u64 value, int padattr);
+
+/* platform_profile */
+enum platform_profile_option {
+    PLATFORM_PROFILE_LOW_POWER,
+    PLATFORM_PROFILE_COOL,
+    PLATFORM_PROFILE_QUIET,
+    PLATFORM_PROFILE_BALANCED,
+    PLATFORM_PROFILE_BALANCED_PERFORMANCE,
+    PLATFORM_PROFILE_PERFORMANCE,
+    PLATFORM_PROFILE_CUSTOM,
+    PLATFORM_PROFILE_LAST,
+};
+
+struct platform_profile_ops {
+    int (*probe)(void *drvdata, unsigned long *choices);
+    int (*profile_get)(struct device *dev, enum platform_profile_option *profile);
+    int (*profile_set)(struct device *dev, enum platform_profile_option profile);
+};
+
+struct device *platform_profile_register(struct device *dev, const char *name,
+                                        void *drvdata,
+                                        const struct platform_profile_ops *ops);
+void platform_profile_remove(struct device *dev);
+void platform_profile_notify(struct device *dev);
+
+/*
+ * Harness side: bind the mock ACPI device and reach what the driver
+ * registered, as the driver core and userspace would.
+ */
+struct acpi_device;
+
+int kstub_acpi_bind(struct acpi_device *adev);
+void kstub_acpi_unbind(struct acpi_device *adev);
+void kstub_acpi_notify(struct acpi_device *adev, u32 event);
+struct device_attribute *kstub_find_attr(struct device *dev, const char *name);
+const struct file_operations *kstub_misc_fops(void);
+int kstub_profile_get(enum platform_profile_option *profile);
+int kstub_profile_set(enum platform_profile_option profile);
+u64 kstub_notifications(void);
+
+#endif /* _BENCH_KSTUB_H */
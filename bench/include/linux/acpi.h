@@ -0,0 +1,122 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * ACPICA and ACPI bus interfaces, implemented by mock_acpi.c
+ */
+
+#ifndef _BENCH_LINUX_ACPI_H
+#define _BENCH_LINUX_ACPI_H
+
+#include "../kstub.h"
+
+typedef void *acpi_handle;
+typedef u32 acpi_status;
+typedef u64 acpi_size;
+typedef char *acpi_string;
+typedef u32 acpi_object_type;
+
+#define ACPI_TYPE_ANY                  0
+#define ACPI_TYPE_INTEGER              1
+#define ACPI_TYPE_STRING               2
+#define ACPI_TYPE_BUFFER               3
+#define ACPI_TYPE_PACKAGE              4
+#define ACPI_TYPE_METHOD               8
+
+#define AE_OK                          0x0000
+#define AE_ERROR                       0x0001
+#define AE_NOT_FOUND                   0x0005
+#define AE_BUFFER_OVERFLOW             0x000B
+#define AE_BAD_PARAMETER               0x1001
+#define ACPI_SUCCESS(s)                ((s) == AE_OK)
+#define ACPI_FAILURE(s)                ((s) != AE_OK)
+
+#define ACPI_NAMESEG_SIZE              4
+#define ACPI_FULL_PATHNAME             0
+#define ACPI_SINGLE_NAME               1
+
+union acpi_object {
+    acpi_object_type type;
+    struct {
+        acpi_object_type type;
+        u64 value;
+    } integer;
+    struct {
+        acpi_object_type type;
+        u32 length;
+        char *pointer;
+    } string;
+    struct {
+        acpi_object_type type;
+        u32 length;
+        u8 *pointer;
+    } buffer;
+    struct {
+        acpi_object_type type;
+        u32 count;
+        union acpi_object *elements;
+    } package;
+};
+
+struct acpi_object_list {
+    u32 count;
+    union acpi_object *pointer;
+};
+
+struct acpi_buffer {
+    acpi_size length;
+    void *pointer;
+};
+
+struct acpi_device_info {
+    u32 info_size;
+    u32 name;
+    acpi_object_type type;
+    u8 param_count;
+};
+
+typedef acpi_status (*acpi_walk_callback)(acpi_handle handle, u32 level,
+                                          void *context, void **retval);
+
+acpi_status acpi_evaluate_object(acpi_handle handle, acpi_string pathname,
+                                 struct acpi_object_list *params,
+                                 struct acpi_buffer *buffer);
+acpi_status acpi_get_handle(acpi_handle parent, const char *pathname, acpi_handle *ret);
+acpi_status acpi_get_name(acpi_handle handle, u32 name_type, struct acpi_buffer *buffer);
+acpi_status acpi_get_object_info(acpi_handle handle, struct acpi_device_info **info);
+acpi_status acpi_walk_namespace(acpi_object_type type, acpi_handle start, u32 max_depth,
+                                acpi_walk_callback pre, acpi_walk_callback post,
+                                void *context, void **retval);
+const char *acpi_format_exception(acpi_status status);
+
+/* Bus side: one mock device, bound by kstub_acpi_bind() */
+struct acpi_device_id {
+    const char id[16];
+    unsigned long driver_data;
+};
+
+struct acpi_device {
+    acpi_handle handle;
+    struct device dev;
+    void *driver_data;
+};
+
+#define to_acpi_device(d)              container_of(d, struct acpi_device, dev)
+
+struct acpi_device_ops {
+    int (*add)(struct acpi_device *device);
+    void (*remove)(struct acpi_device *device);
+    void (*notify)(struct acpi_device *device, u32 event);
+};
+
+struct acpi_driver {
+    char name[80];
+    char class[80];
+    const struct acpi_device_id *ids;
+    unsigned int flags;
+    struct acpi_device_ops ops;
+    struct device_driver drv;
+};
+
+int acpi_bus_register_driver(struct acpi_driver *driver);
+void acpi_bus_unregister_driver(struct acpi_driver *driver);
+
+#endif /* _BENCH_LINUX_ACPI_H */
@@ -0,0 +1,5 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _BENCH_LINUX_DEBUGFS_H
+#define _BENCH_LINUX_DEBUGFS_H
+#include "../kstub.h"
+#endif
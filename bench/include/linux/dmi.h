@@ -0,0 +1,41 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * DMI matching against the strings of the mock machine (mock_acpi.c)
+ */
+
+#ifndef _BENCH_LINUX_DMI_H
+#define _BENCH_LINUX_DMI_H
+
+#include "../kstub.h"
+
+enum dmi_field {
+    DMI_NONE,
+    DMI_BIOS_VENDOR,
+    DMI_BIOS_VERSION,
+    DMI_BIOS_DATE,
+    DMI_SYS_VENDOR,
+    DMI_PRODUCT_NAME,
+    DMI_PRODUCT_VERSION,
+    DMI_BOARD_NAME,
+    DMI_STRING_MAX,
+};
+
+struct dmi_strmatch {
+    unsigned char slot:7;
+    unsigned char exact_match:1;
+    char substr[79];
+};
+
+struct dmi_system_id {
+    int (*callback)(const struct dmi_system_id *id);
+    const char *ident;
+    struct dmi_strmatch matches[4];
+    void *driver_data;
+};
+
+#define DMI_MATCH(a, b)                { .slot = a, .substr = b }
+
+const char *dmi_get_system_info(int field);
+const struct dmi_system_id *dmi_first_match(const struct dmi_system_id *list);
+
+#endif /* _BENCH_LINUX_DMI_H */
@@ -0,0 +1,21 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Tracepoints are compiled out, as on a kernel with none enabled
+ */
+
+#ifndef _BENCH_LINUX_TRACEPOINT_H
+#define _BENCH_LINUX_TRACEPOINT_H
+
+#include "../kstub.h"
+
+#define TP_PROTO(...)                  __VA_ARGS__
+#define TP_ARGS(...)                   __VA_ARGS__
+#define TRACE_EVENT(name, proto, args, tstruct, assign, print)          \
+    static inline void trace_##name(proto) { }                          \
+    static inline bool trace_##name##_enabled(void) { return false; }
+#define DECLARE_EVENT_CLASS(name, proto, args, tstruct, assign, print)
+#define DEFINE_EVENT(template, name, proto, args)                       \
+    static inline void trace_##name(proto) { }                          \
+    static inline bool trace_##name##_enabled(void) { return false; }
+
+#endif /* _BENCH_LINUX_TRACEPOINT_H */
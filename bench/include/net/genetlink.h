@@ -0,0 +1,5 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _BENCH_NET_GENETLINK_H
+#define _BENCH_NET_GENETLINK_H
+#include "../kstub.h"
+#endif
@@ -0,0 +1,2 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/* Tracepoints compile to nothing, see linux/tracepoint.h */
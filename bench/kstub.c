@@ -0,0 +1,816 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Userspace runtime behind include/kstub.h
+ *
+ * Copyright (C) 2025
+ */
+
+#include <ctype.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <linux/acpi.h>
+
+int kstub_verbose;
+bool kstub_genl_listeners;
+struct net init_net;
+
+static atomic_long_t kstub_alloc_count;
+static atomic_long_t kstub_notify_count;
+
+int printk(const char *fmt, ...)
+{
+    va_list ap;
+    int n;
+
+    if (!kstub_verbose)
+        return 0;
+
+    va_start(ap, fmt);
+    n = vfprintf(stderr, fmt, ap);
+    va_end(ap);
+    return n;
+}
+
+u64 ktime_get_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u64)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* Allocation */
+
+void *kmalloc(size_t size, gfp_t flags)
+{
+    atomic_long_inc(&kstub_alloc_count);
+    return malloc(size);
+}
+
+void *kzalloc(size_t size, gfp_t flags)
+{
+    atomic_long_inc(&kstub_alloc_count);
+    return calloc(1, size);
+}
+
+void kfree(const void *p)
+{
+    free((void *)p);
+}
+
+char *kmemdup_nul(const char *s, size_t len, gfp_t flags)
+{
+    char *p = kmalloc(len + 1, flags);
+
+    if (p) {
+        memcpy(p, s, len);
+        p[len] = '\0';
+    }
+    return p;
+}
+
+u64 kstub_allocs(void)
+{
+    return atomic_long_read(&kstub_alloc_count);
+}
+
+/* Managed resources, released when the device is unbound */
+struct kstub_devres {
+    struct kstub_devres *next;
+    max_align_t data[];
+};
+
+void *devm_kzalloc(struct device *dev, size_t size, gfp_t flags)
+{
+    struct kstub_devres *res = kzalloc(sizeof(*res) + size, flags);
+
+    if (!res)
+        return NULL;
+    res->next = dev->devres;
+    dev->devres = res;
+    return res->data;
+}
+
+static void kstub_devres_release_all(struct device *dev)
+{
+    struct kstub_devres *res, *next;
+
+    for (res = dev->devres; res; res = next) {
+        next = res->next;
+        kfree(res);
+    }
+    dev->devres = NULL;
+}
+
+/* Strings and parsing, with the kernel's return conventions */
+
+int scnprintf(char *buf, size_t size, const char *fmt, ...)
+{
+    va_list ap;
+    int n;
+
+    if (!size)
+        return 0;
+
+    va_start(ap, fmt);
+    n = vsnprintf(buf, size, fmt, ap);
+    va_end(ap);
+    if (n < 0)
+        return 0;
+    return (size_t)n < size ? n : (int)size - 1;
+}
+
+ssize_t strscpy(char *dst, const char *src, size_t size)
+{
+    size_t len;
+
+    if (!size)
+        return -E2BIG;
+
+    len = strnlen(src, size);
+    if (len == size) {
+        memcpy(dst, src, size - 1);
+        dst[size - 1] = '\0';
+        return -E2BIG;
+    }
+    memcpy(dst, src, len + 1);
+    return len;
+}
+
+char *strim(char *s)
+{
+    size_t len = strlen(s);
+
+    while (len && isspace((unsigned char)s[len - 1]))
+        s[--len] = '\0';
+    while (isspace((unsigned char)*s))
+        s++;
+    return s;
+}
+
+char *skip_spaces(const char *s)
+{
+    while (isspace((unsigned char)*s))
+        s++;
+    return (char *)s;
+}
+
+/* One optional trailing newline, no leading blanks, as _parse_integer() */
+static int kstub_parse(const char *s, unsigned int base, bool is_signed,
+                       long long *sval, unsigned long long *uval)
+{
+    char *end;
+
+    if (!*s || isspace((unsigned char)*s) || (!is_signed && *s == '-'))
+        return -EINVAL;
+
+    errno = 0;
+    if (is_signed)
+        *sval = strtoll(s, &end, base);
+    else
+        *uval = strtoull(s, &end, base);
+    if (end == s)
+        return -EINVAL;
+    if (*end == '\n')
+        end++;
+    if (*end)
+        return -EINVAL;
+    return errno == ERANGE ? -ERANGE : 0;
+}
+
+int kstrtoint(const char *s, unsigned int base, int *res)
+{
+    long long v;
+    int ret = kstub_parse(s, base, true, &v, NULL);
+
+    if (ret)
+        return ret;
+    if (v < INT_MIN || v > INT_MAX)
+        return -ERANGE;
+    *res = v;
+    return 0;
+}
+
+int kstrtouint(const char *s, unsigned int base, unsigned int *res)
+{
+    unsigned long long v;
+    int ret = kstub_parse(s, base, false, NULL, &v);
+
+    if (ret)
+        return ret;
+    if (v > UINT_MAX)
+        return -ERANGE;
+    *res = v;
+    return 0;
+}
+
+int kstrtoul(const char *s, unsigned int base, unsigned long *res)
+{
+    unsigned long long v;
+    int ret = kstub_parse(s, base, false, NULL, &v);
+
+    if (ret)
+        return ret;
+    if (v > ULONG_MAX)
+        return -ERANGE;
+    *res = v;
+    return 0;
+}
+
+/* Module parameters, collected by module_param() into one section */
+extern const struct kstub_param __start_kstub_param[] __attribute__((weak));
+extern const struct kstub_param __stop_kstub_param[] __attribute__((weak));
+
+int param_set_bool(const char *val, const struct kernel_param *kp)
+{
+    if (strchr("1yY", val[0]))
+        *(bool *)kp->arg = true;
+    else if (strchr("0nN", val[0]))
+        *(bool *)kp->arg = false;
+    else
+        return -EINVAL;
+    return 0;
+}
+
+int param_get_bool(char *buffer, const struct kernel_param *kp)
+{
+    return sprintf(buffer, "%c\n", *(bool *)kp->arg ? 'Y' : 'N');
+}
+
+int kstub_param_set(const char *name, const char *val)
+{
+    const struct kstub_param *p;
+    const struct kernel_param *kp;
+
+    for (p = __start_kstub_param; p < __stop_kstub_param; p++) {
+        if (strcmp(p->name, name))
+            continue;
+        if (!strcmp(p->type, "cb")) {
+            kp = p->arg;
+            return kp->ops->set(val, kp);
+        }
+        if (!strcmp(p->type, "uint"))
+            return kstrtouint(val, 0, p->arg);
+        if (!strcmp(p->type, "int"))
+            return kstrtoint(val, 0, p->arg);
+        if (!strcmp(p->type, "bool")) {
+            struct kernel_param bp = { .arg = p->arg };
+
+            return param_set_bool(val, &bp);
+        }
+        if (!strcmp(p->type, "charp")) {
+            *(char **)p->arg = strdup(val);
+            return 0;
+        }
+        return -EINVAL;
+    }
+
+    return -ENOENT;
+}
+
+/* IDs */
+static pthread_mutex_t kstub_ida_lock = PTHREAD_MUTEX_INITIALIZER;
+
+int ida_alloc(struct ida *ida, gfp_t flags)
+{
+    int id;
+
+    pthread_mutex_lock(&kstub_ida_lock);
+    for (id = 0; id < (int)(8 * sizeof(ida->bits)); id++) {
+        if (!(ida->bits & BIT(id))) {
+            ida->bits |= BIT(id);
+            break;
+        }
+    }
+    pthread_mutex_unlock(&kstub_ida_lock);
+
+    return id < (int)(8 * sizeof(ida->bits)) ? id : -ENOSPC;
+}
+
+void ida_free(struct ida *ida, unsigned int id)
+{
+    pthread_mutex_lock(&kstub_ida_lock);
+    ida->bits &= ~BIT(id);
+    pthread_mutex_unlock(&kstub_ida_lock);
+}
+
+/*
+ * Workqueues: one thread each, running ready items in queue order, which
+ * matches an ordered workqueue. Delayed items become ready at due_ns.
+ */
+struct workqueue_struct {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;        /* queue changed or an item finished */
+    pthread_t thread;
+    struct work_struct *head;
+    struct work_struct *running;
+    bool stop;
+};
+
+void kstub_init_work(struct work_struct *work, work_func_t func)
+{
+    memset(work, 0, sizeof(*work));
+    work->func = func;
+}
+
+static void wq_enqueue(struct workqueue_struct *wq, struct work_struct *work)
+{
+    struct work_struct **p = &wq->head;
+
+    while (*p)
+        p = &(*p)->next;
+    *p = work;
+    work->next = NULL;
+    work->wq = wq;
+    work->pending = true;
+}
+
+static void wq_unlink(struct workqueue_struct *wq, struct work_struct *work)
+{
+    struct work_struct **p;
+
+    for (p = &wq->head; *p; p = &(*p)->next) {
+        if (*p == work) {
+            *p = work->next;
+            break;
+        }
+    }
+    work->next = NULL;
+    work->pending = false;
+}
+
+/* First item due by @now; *wake gets the earliest later due time, or 0 */
+static struct work_struct *wq_first_ready(struct workqueue_struct *wq, u64 now, u64 *wake)
+{
+    struct work_struct *work;
+
+    *wake = 0;
+    for (work = wq->head; work; work = work->next) {
+        if (work->due_ns <= now)
+            return work;
+        if (!*wake || work->due_ns < *wake)
+            *wake = work->due_ns;
+    }
+    return NULL;
+}
+
+static void *wq_worker(void *arg)
+{
+    struct workqueue_struct *wq = arg;
+    struct work_struct *work;
+    struct timespec ts;
+    u64 wake;
+
+    pthread_mutex_lock(&wq->lock);
+    for (;;) {
+        work = wq_first_ready(wq, ktime_get_ns(), &wake);
+        if (work) {
+            wq_unlink(wq, work);
+            wq->running = work;
+            pthread_mutex_unlock(&wq->lock);
+            work->func(work);
+            pthread_mutex_lock(&wq->lock);
+            wq->running = NULL;
+            pthread_cond_broadcast(&wq->cond);
+            continue;
+        }
+        if (wq->stop)
+            break;
+        if (wake) {
+            ts.tv_sec = wake / 1000000000ULL;
+            ts.tv_nsec = wake % 1000000000ULL;
+            pthread_cond_timedwait(&wq->cond, &wq->lock, &ts);
+        } else {
+            pthread_cond_wait(&wq->cond, &wq->lock);
+        }
+    }
+    pthread_mutex_unlock(&wq->lock);
+
+    return NULL;
+}
+
+struct workqueue_struct *alloc_ordered_workqueue(const char *fmt, unsigned int flags, ...)
+{
+    struct workqueue_struct *wq = kzalloc(sizeof(*wq), GFP_KERNEL);
+    pthread_condattr_t attr;
+
+    if (!wq)
+        return NULL;
+
+    pthread_mutex_init(&wq->lock, NULL);
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&wq->cond, &attr);
+    pthread_condattr_destroy(&attr);
+    if (pthread_create(&wq->thread, NULL, wq_worker, wq)) {
+        kfree(wq);
+        return NULL;
+    }
+
+    return wq;
+}
+
+void destroy_workqueue(struct workqueue_struct *wq)
+{
+    flush_workqueue(wq);
+    pthread_mutex_lock(&wq->lock);
+    wq->stop = true;
+    pthread_cond_broadcast(&wq->cond);
+    pthread_mutex_unlock(&wq->lock);
+    pthread_join(wq->thread, NULL);
+    pthread_cond_destroy(&wq->cond);
+    pthread_mutex_destroy(&wq->lock);
+    kfree(wq);
+}
+
+bool queue_work(struct workqueue_struct *wq, struct work_struct *work)
+{
+    bool queued = false;
+
+    pthread_mutex_lock(&wq->lock);
+    if (!work->pending) {
+        work->due_ns = 0;
+        wq_enqueue(wq, work);
+        pthread_cond_broadcast(&wq->cond);
+        queued = true;
+    }
+    pthread_mutex_unlock(&wq->lock);
+
+    return queued;
+}
+
+bool mod_delayed_work(struct workqueue_struct *wq, struct delayed_work *dwork,
+                      unsigned long delay)
+{
+    struct work_struct *work = &dwork->work;
+    bool was_pending;
+
+    pthread_mutex_lock(&wq->lock);
+    was_pending = work->pending;
+    if (!was_pending)
+        wq_enqueue(wq, work);
+    work->due_ns = ktime_get_ns() + (u64)delay * NSEC_PER_MSEC;
+    pthread_cond_broadcast(&wq->cond);
+    pthread_mutex_unlock(&wq->lock);
+
+    return was_pending;
+}
+
+bool cancel_work_sync(struct work_struct *work)
+{
+    struct workqueue_struct *wq = work->wq;
+    bool was_pending;
+
+    if (!wq)
+        return false;
+
+    pthread_mutex_lock(&wq->lock);
+    was_pending = work->pending;
+    if (was_pending)
+        wq_unlink(wq, work);
+    while (wq->running == work)
+        pthread_cond_wait(&wq->cond, &wq->lock);
+    pthread_mutex_unlock(&wq->lock);
+
+    return was_pending;
+}
+
+bool cancel_delayed_work_sync(struct delayed_work *dwork)
+{
+    return cancel_work_sync(&dwork->work);
+}
+
+bool flush_work(struct work_struct *work)
+{
+    struct workqueue_struct *wq = work->wq;
+    bool was_pending;
+
+    if (!wq)
+        return false;
+
+    pthread_mutex_lock(&wq->lock);
+    was_pending = work->pending;
+    if (was_pending) {
+        work->due_ns = 0;
+        pthread_cond_broadcast(&wq->cond);
+    }
+    while (work->pending || wq->running == work)
+        pthread_cond_wait(&wq->cond, &wq->lock);
+    pthread_mutex_unlock(&wq->lock);
+
+    return was_pending;
+}
+
+bool flush_delayed_work(struct delayed_work *dwork)
+{
+    return flush_work(&dwork->work);
+}
+
+/* Waits for items ready now; delayed ones still ticking are left alone */
+void flush_workqueue(struct workqueue_struct *wq)
+{
+    u64 now = ktime_get_ns(), wake;
+
+    pthread_mutex_lock(&wq->lock);
+    while (wq->running || wq_first_ready(wq, now, &wake))
+        pthread_cond_wait(&wq->cond, &wq->lock);
+    pthread_mutex_unlock(&wq->lock);
+}
+
+/* sysfs: groups are remembered per kobject so the harness can find handlers */
+#define KSTUB_MAX_GROUPS               8
+
+static struct {
+    struct kobject *kobj;
+    const struct attribute_group *grp;
+} kstub_groups[KSTUB_MAX_GROUPS];
+
+int sysfs_create_group(struct kobject *kobj, const struct attribute_group *grp)
+{
+    int i;
+
+    for (i = 0; i < KSTUB_MAX_GROUPS; i++) {
+        if (!kstub_groups[i].kobj) {
+            kstub_groups[i].kobj = kobj;
+            kstub_groups[i].grp = grp;
+            return 0;
+        }
+    }
+    return -ENOMEM;
+}
+
+void sysfs_remove_group(struct kobject *kobj, const struct attribute_group *grp)
+{
+    int i;
+
+    for (i = 0; i < KSTUB_MAX_GROUPS; i++) {
+        if (kstub_groups[i].kobj == kobj && kstub_groups[i].grp == grp)
+            kstub_groups[i].kobj = NULL;
+    }
+}
+
+/* is_visible is asked on every lookup, so there is nothing to redo */
+int sysfs_update_group(struct kobject *kobj, const struct attribute_group *grp)
+{
+    int i;
+
+    for (i = 0; i < KSTUB_MAX_GROUPS; i++) {
+        if (kstub_groups[i].kobj == kobj && kstub_groups[i].grp == grp)
+            return 0;
+    }
+    return -ENOENT;
+}
+
+void sysfs_notify(struct kobject *kobj, const char *dir, const char *attr)
+{
+    atomic_long_inc(&kstub_notify_count);
+}
+
+int kobject_uevent(struct kobject *kobj, enum kobject_action action)
+{
+    atomic_long_inc(&kstub_notify_count);
+    return 0;
+}
+
+/* Attributes hidden by is_visible are not found, as they would not exist */
+struct device_attribute *kstub_find_attr(struct device *dev, const char *name)
+{
+    const struct attribute_group *grp;
+    struct attribute *attr;
+    int i, n;
+
+    for (i = 0; i < KSTUB_MAX_GROUPS; i++) {
+        if (kstub_groups[i].kobj != &dev->kobj)
+            continue;
+        grp = kstub_groups[i].grp;
+        for (n = 0; (attr = grp->attrs[n]); n++) {
+            if (strcmp(attr->name, name))
+                continue;
+            if (grp->is_visible && !grp->is_visible(&dev->kobj, attr, n))
+                return NULL;
+            return container_of(attr, struct device_attribute, attr);
+        }
+    }
+    return NULL;
+}
+
+u64 kstub_notifications(void)
+{
+    return atomic_long_read(&kstub_notify_count);
+}
+
+/* Misc device */
+static struct miscdevice *kstub_misc;
+
+int misc_register(struct miscdevice *misc)
+{
+    kstub_misc = misc;
+    return 0;
+}
+
+void misc_deregister(struct miscdevice *misc)
+{
+    kstub_misc = NULL;
+}
+
+const struct file_operations *kstub_misc_fops(void)
+{
+    return kstub_misc ? kstub_misc->fops : NULL;
+}
+
+long compat_ptr_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
+{
+    return -ENOTTY;
+}
+
+/* seq_file, only reachable through debugfs which is off */
+int seq_printf(struct seq_file *m, const char *fmt, ...)
+{
+    return 0;
+}
+
+void seq_puts(struct seq_file *m, const char *s)
+{
+}
+
+int single_open(struct file *file, int (*show)(struct seq_file *, void *), void *data)
+{
+    return -ENODEV;
+}
+
+/* Generic netlink messages are built and dropped */
+struct sk_buff {
+    size_t len;
+    size_t size;
+    unsigned char data[];
+};
+
+struct sk_buff *genlmsg_new(size_t payload, gfp_t flags)
+{
+    struct sk_buff *skb = kmalloc(sizeof(*skb) + payload, flags);
+
+    if (skb) {
+        skb->len = 0;
+        skb->size = payload;
+    }
+    return skb;
+}
+
+void *genlmsg_put(struct sk_buff *skb, u32 portid, u32 seq,
+                  const struct genl_family *family, int flags, u8 cmd)
+{
+    skb->data[0] = cmd;
+    skb->len = 4;
+    return skb->data;
+}
+
+void genlmsg_end(struct sk_buff *skb, void *hdr)
+{
+}
+
+int genlmsg_multicast(const struct genl_family *family, struct sk_buff *skb,
+                      u32 portid, unsigned int group, gfp_t flags)
+{
+    kfree(skb);
+    return 0;
+}
+
+void nlmsg_free(struct sk_buff *skb)
+{
+    kfree(skb);
+}
+
+static int kstub_nla_put(struct sk_buff *skb, int type, const void *data, size_t len)
+{
+    size_t need = 4 + ((len + 3) & ~3UL);
+
+    if (skb->len + need > skb->size)
+        return -EMSGSIZE;
+    memcpy(skb->data + skb->len, &type, sizeof(type));
+    memcpy(skb->data + skb->len + 4, data, len);
+    skb->len += need;
+    return 0;
+}
+
+int nla_put_u32(struct sk_buff *skb, int type, u32 value)
+{
+    return kstub_nla_put(skb, type, &value, sizeof(value));
+}
+
+int nla_put_s32(struct sk_buff *skb, int type, s32 value)
+{
+    return kstub_nla_put(skb, type, &value, sizeof(value));
+}
+
+int nla_put_u64_64bit(struct sk_buff *skb, int type, u64 value, int padattr)
+{
+    return kstub_nla_put(skb, type, &value, sizeof(value));
+}
+
+/* platform_profile: one class device, driven through kstub_profile_*() */
+struct kstub_profile {
+    struct device dev;
+    const struct platform_profile_ops *ops;
+    unsigned long choices;
+};
+
+static struct kstub_profile *kstub_profile;
+
+struct device *platform_profile_register(struct device *dev, const char *name,
+                                        void *drvdata,
+                                        const struct platform_profile_ops *ops)
+{
+    struct kstub_profile *pp = kzalloc(sizeof(*pp), GFP_KERNEL);
+    int ret;
+
+    if (!pp)
+        return ERR_PTR(-ENOMEM);
+
+    ret = ops->probe(drvdata, &pp->choices);
+    if (ret) {
+        kfree(pp);
+        return ERR_PTR(ret);
+    }
+
+    pp->dev.kobj.name = name;
+    pp->dev.driver_data = drvdata;
+    pp->ops = ops;
+    kstub_profile = pp;
+    return &pp->dev;
+}
+
+void platform_profile_remove(struct device *dev)
+{
+    struct kstub_profile *pp = container_of(dev, struct kstub_profile, dev);
+
+    if (kstub_profile == pp)
+        kstub_profile = NULL;
+    kfree(pp);
+}
+
+void platform_profile_notify(struct device *dev)
+{
+    atomic_long_inc(&kstub_notify_count);
+}
+
+int kstub_profile_get(enum platform_profile_option *profile)
+{
+    if (!kstub_profile)
+        return -ENODEV;
+    return kstub_profile->ops->profile_get(&kstub_profile->dev, profile);
+}
+
+int kstub_profile_set(enum platform_profile_option profile)
+{
+    if (!kstub_profile)
+        return -ENODEV;
+    if (!(kstub_profile->choices & BIT(profile)))
+        return -EOPNOTSUPP;
+    return kstub_profile->ops->profile_set(&kstub_profile->dev, profile);
+}
+
+/* ACPI bus: a single registered driver bound to devices on request */
+static struct acpi_driver *kstub_acpi_driver;
+
+int acpi_bus_register_driver(struct acpi_driver *driver)
+{
+    kstub_acpi_driver = driver;
+    return 0;
+}
+
+void acpi_bus_unregister_driver(struct acpi_driver *driver)
+{
+    kstub_acpi_driver = NULL;
+}
+
+int kstub_acpi_bind(struct acpi_device *adev)
+{
+    int ret;
+
+    if (!kstub_acpi_driver)
+        return -ENODEV;
+
+    adev->dev.driver = &kstub_acpi_driver->drv;
+    ret = kstub_acpi_driver->ops.add(adev);
+    if (ret) {
+        kstub_devres_release_all(&adev->dev);
+        adev->dev.driver = NULL;
+    }
+    return ret;
+}
+
+void kstub_acpi_unbind(struct acpi_device *adev)
+{
+    kstub_acpi_driver->ops.remove(adev);
+    kstub_profile = NULL;
+    kstub_devres_release_all(&adev->dev);
+    adev->dev.driver = NULL;
+}
+
+void kstub_acpi_notify(struct acpi_device *adev, u32 event)
+{
+    kstub_acpi_driver->ops.notify(adev, event);
+}
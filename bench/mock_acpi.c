@@ -0,0 +1,561 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Mock ACPI namespace and DMI tables for the userspace benchmark
+ *
+ * Copyright (C) 2025
+ */
+
+#include <stdio.h>
+
+#include <linux/acpi.h>
+#include <linux/dmi.h>
+
+#include "mock_acpi.h"
+
+#define MOCK_MAX_METHODS               8
+
+/* GBMD/SBMD selectors the ASUS firmware answers */
+#define MOCK_BIOS_THERMAL_POLICY       0x00120075
+#define MOCK_BIOS_FAN_CURVE_CPU        0x00110024
+#define MOCK_BIOS_FAN_CURVE_GPU        0x00110025
+#define MOCK_BIOS_PPT_PL1_SPL          0x001200A3
+#define MOCK_BIOS_PPT_PL2_SPPT         0x001200A0
+#define MOCK_BIOS_PPT_FPPT             0x001200C1
+#define MOCK_BIOS_NV_DYN_BOOST         0x001200C0
+#define MOCK_BIOS_PRESENCE             BIT(16)
+
+/* Fan curves: 8 temperatures then 8 duties, as GBMD returns them */
+#define MOCK_FAN_CURVE_LEN             16
+#define MOCK_NR_FANS                   2
+
+enum mock_kind {
+    MOCK_GET,                   /* returns reg */
+    MOCK_SET,                   /* reg = arg0 */
+    MOCK_BIOS_GET,              /* DSTS-style status of selector arg0 */
+    MOCK_BIOS_SET,              /* selector arg0 = arg1.. */
+};
+
+struct mock_method {
+    char name[ACPI_NAMESEG_SIZE + 1];
+    enum mock_kind kind;
+    enum mock_reg reg;
+    u8 nargs;                   /* arguments required */
+    u64 latency_ns;
+    u32 fail_every;
+    u64 calls;
+};
+
+struct mock_vendor {
+    const char *name;
+    const char *sys_vendor;
+    const char *product_name;
+    const char *bios_version;
+    struct mock_method methods[MOCK_MAX_METHODS];
+};
+
+#define MOCK_GET(_name, _reg)          { _name, MOCK_GET, _reg, 1 }
+#define MOCK_SET(_name, _reg)          { _name, MOCK_SET, _reg, 1 }
+
+static const struct mock_vendor mock_vendors[] = {
+    {
+        "asus", "ASUSTeK COMPUTER INC.", "ROG Zephyrus G14 GA402RJ", "GA402RJ.318",
+        {
+            { "GBMD", MOCK_BIOS_GET, 0, 1 },
+            { "SBMD", MOCK_BIOS_SET, 0, 2 },
+            MOCK_GET("MXDS", MOCK_REG_GPU_MUX),
+            MOCK_SET("MXDM", MOCK_REG_GPU_MUX),
+            MOCK_GET("DGPU", MOCK_REG_DGPU_DISABLE),
+            MOCK_SET("SDGP", MOCK_REG_DGPU_DISABLE),
+            MOCK_GET("EGPU", MOCK_REG_EGPU_ENABLE),
+            MOCK_SET("SEGP", MOCK_REG_EGPU_ENABLE),
+        },
+    },
+    {
+        "msi", "Micro-Star International Co., Ltd.", "Raider GE78HX 13VH", "E17S1IMS.10B",
+        {
+            MOCK_GET("GMUX", MOCK_REG_GPU_MUX),
+            MOCK_SET("SMUX", MOCK_REG_GPU_MUX),
+            MOCK_GET("GDIS", MOCK_REG_DGPU_DISABLE),
+            MOCK_SET("SDIS", MOCK_REG_DGPU_DISABLE),
+        },
+    },
+    {
+        "dell", "Alienware", "Alienware m16 R1", "1.14.0",
+        {
+            MOCK_GET("GFXS", MOCK_REG_GPU_MUX),
+            MOCK_SET("SFXS", MOCK_REG_GPU_MUX),
+            MOCK_GET("GDDS", MOCK_REG_DGPU_DISABLE),
+            MOCK_SET("SDDS", MOCK_REG_DGPU_DISABLE),
+        },
+    },
+    {
+        "lenovo", "LENOVO", "82WK Legion Pro 7 16IRX8H", "KWCN38WW",
+        {
+            MOCK_GET("LGPU", MOCK_REG_GPU_MUX),
+            MOCK_SET("SLGP", MOCK_REG_GPU_MUX),
+            MOCK_GET("LDGP", MOCK_REG_DGPU_DISABLE),
+            MOCK_SET("SLDG", MOCK_REG_DGPU_DISABLE),
+        },
+    },
+    {
+        "hp", "HP", "OMEN by HP Laptop 16-wf0xxx", "F.12",
+        {
+            MOCK_GET("GMUX", MOCK_REG_GPU_MUX),
+            MOCK_SET("SMUX", MOCK_REG_GPU_MUX),
+            MOCK_GET("_GPU", MOCK_REG_DGPU_DISABLE),
+            MOCK_SET("SGPU", MOCK_REG_DGPU_DISABLE),
+        },
+    },
+};
+
+/* The device node; its address is the device handle */
+static struct mock_node {
+    const struct mock_vendor *vendor;
+    struct mock_method methods[MOCK_MAX_METHODS];
+    int nr_methods;
+} mock_node;
+
+static int mock_regs[MOCK_NR_REGS];
+static u8 mock_fan_curves[MOCK_NR_FANS][MOCK_FAN_CURVE_LEN];
+
+static const u8 mock_fan_curve_default[MOCK_FAN_CURVE_LEN] = {
+    30, 40, 50, 60, 70, 80, 90, 100,
+    0, 10, 20, 35, 50, 65, 80, 100,
+};
+static u64 mock_total_calls;
+
+/* ACPICA runs one control method at a time under its interpreter lock */
+static pthread_mutex_t mock_interp_lock = PTHREAD_MUTEX_INITIALIZER;
+/* and searches the namespace under ACPI_MTX_NAMESPACE */
+static pthread_mutex_t mock_ns_lock = PTHREAD_MUTEX_INITIALIZER;
+static bool mock_by_pathname;
+
+int mock_acpi_init(const char *vendor)
+{
+    const struct mock_vendor *v = NULL;
+    size_t i;
+
+    for (i = 0; i < ARRAY_SIZE(mock_vendors); i++) {
+        if (!strcmp(mock_vendors[i].name, vendor))
+            v = &mock_vendors[i];
+    }
+    if (!v)
+        return -ENOENT;
+
+    memset(&mock_node, 0, sizeof(mock_node));
+    memset(mock_regs, 0, sizeof(mock_regs));
+    mock_regs[MOCK_REG_PPT_PL1_SPL] = 45;
+    mock_regs[MOCK_REG_PPT_PL2_SPPT] = 65;
+    mock_regs[MOCK_REG_PPT_FPPT] = 80;
+    mock_regs[MOCK_REG_NV_DYN_BOOST] = 15;
+    for (i = 0; i < MOCK_NR_FANS; i++)
+        memcpy(mock_fan_curves[i], mock_fan_curve_default, MOCK_FAN_CURVE_LEN);
+    mock_node.vendor = v;
+    for (i = 0; i < MOCK_MAX_METHODS && v->methods[i].name[0]; i++)
+        mock_node.methods[i] = v->methods[i];
+    mock_node.nr_methods = i;
+
+    return 0;
+}
+
+const char *mock_acpi_vendor_names(void)
+{
+    return "asus, msi, dell, lenovo, hp";
+}
+
+acpi_handle mock_acpi_device(void)
+{
+    return &mock_node;
+}
+
+static struct mock_method *mock_method_of(acpi_handle handle)
+{
+    struct mock_method *m = handle;
+
+    if (m < mock_node.methods || m >= mock_node.methods + mock_node.nr_methods)
+        return NULL;
+    return m;
+}
+
+int mock_acpi_set_latency(const char *method, u64 ns)
+{
+    int i, n = 0;
+
+    for (i = 0; i < mock_node.nr_methods; i++) {
+        if (!method || !strcmp(mock_node.methods[i].name, method)) {
+            mock_node.methods[i].latency_ns = ns;
+            n++;
+        }
+    }
+    return n ? 0 : -ENOENT;
+}
+
+int mock_acpi_set_failure(const char *method, u32 every)
+{
+    int i, n = 0;
+
+    for (i = 0; i < mock_node.nr_methods; i++) {
+        if (!method || !strcmp(mock_node.methods[i].name, method)) {
+            mock_node.methods[i].fail_every = every;
+            n++;
+        }
+    }
+    return n ? 0 : -ENOENT;
+}
+
+void mock_acpi_set_pathname(bool on)
+{
+    mock_by_pathname = on;
+}
+
+u64 mock_acpi_calls(void)
+{
+    return __atomic_load_n(&mock_total_calls, __ATOMIC_RELAXED);
+}
+
+int mock_acpi_reg(enum mock_reg reg)
+{
+    return __atomic_load_n(&mock_regs[reg], __ATOMIC_RELAXED);
+}
+
+/* AML runs on the CPU, so latency is spent spinning rather than sleeping */
+static void mock_spin(u64 ns)
+{
+    u64 end = ktime_get_ns() + ns;
+
+    while (ktime_get_ns() < end)
+        cpu_relax();
+}
+
+/* Power limit register of @selector, or -1 */
+static int mock_power_reg(u32 selector)
+{
+    switch (selector) {
+    case MOCK_BIOS_PPT_PL1_SPL:
+        return MOCK_REG_PPT_PL1_SPL;
+    case MOCK_BIOS_PPT_PL2_SPPT:
+        return MOCK_REG_PPT_PL2_SPPT;
+    case MOCK_BIOS_PPT_FPPT:
+        return MOCK_REG_PPT_FPPT;
+    case MOCK_BIOS_NV_DYN_BOOST:
+        return MOCK_REG_NV_DYN_BOOST;
+    default:
+        return -1;
+    }
+}
+
+static u64 mock_bios_get(u32 selector)
+{
+    int reg = mock_power_reg(selector);
+
+    if (reg >= 0)
+        return MOCK_BIOS_PRESENCE | mock_regs[reg];
+
+    switch (selector) {
+    case MOCK_BIOS_THERMAL_POLICY:
+        return MOCK_BIOS_PRESENCE | mock_regs[MOCK_REG_THERMAL_POLICY];
+    default:
+        return 0;
+    }
+}
+
+static u8 *mock_fan_curve(u32 selector)
+{
+    switch (selector) {
+    case MOCK_BIOS_FAN_CURVE_CPU:
+        return mock_fan_curves[0];
+    case MOCK_BIOS_FAN_CURVE_GPU:
+        return mock_fan_curves[1];
+    default:
+        return NULL;
+    }
+}
+
+/* A curve comes as four words of four points each, first point in the low byte */
+static u64 mock_bios_set(const u64 *args, u32 nargs)
+{
+    u8 *curve = mock_fan_curve(args[0]);
+    int reg = mock_power_reg(args[0]);
+    u32 i;
+
+    if (curve) {
+        if (nargs != 1 + MOCK_FAN_CURVE_LEN / 4)
+            return 0;
+        for (i = 0; i < MOCK_FAN_CURVE_LEN; i++)
+            curve[i] = args[1 + i / 4] >> (8 * (i % 4));
+        return 1;
+    }
+
+    if (reg >= 0) {
+        if (args[1] > 0xff)
+            return 0;
+        mock_regs[reg] = args[1];
+        return 1;
+    }
+
+    if (args[0] != MOCK_BIOS_THERMAL_POLICY || args[1] > 2)
+        return 0;
+    mock_regs[MOCK_REG_THERMAL_POLICY] = args[1];
+    return 1;
+}
+
+/*
+ * Resolve @pathname relative to @scope the way acpi_evaluate_object() does:
+ * the name is converted to an allocated internal (padded segment) string,
+ * then the scope is searched under the namespace mutex.
+ */
+static struct mock_method *mock_lookup(acpi_handle scope, const char *pathname)
+{
+    struct mock_method *m = NULL;
+    size_t len = strlen(pathname);
+    char *internal;
+    int i;
+
+    if (scope != &mock_node || !len || len > ACPI_NAMESEG_SIZE)
+        return NULL;
+
+    internal = kmalloc(ACPI_NAMESEG_SIZE + 1, GFP_KERNEL);
+    if (!internal)
+        return NULL;
+    memset(internal, '_', ACPI_NAMESEG_SIZE);
+    memcpy(internal, pathname, len);
+    internal[ACPI_NAMESEG_SIZE] = '\0';
+
+    pthread_mutex_lock(&mock_ns_lock);
+    for (i = 0; i < mock_node.nr_methods; i++) {
+        if (!memcmp(mock_node.methods[i].name, internal, ACPI_NAMESEG_SIZE)) {
+            m = &mock_node.methods[i];
+            break;
+        }
+    }
+    pthread_mutex_unlock(&mock_ns_lock);
+    kfree(internal);
+
+    return m;
+}
+
+acpi_status acpi_evaluate_object(acpi_handle handle, acpi_string pathname,
+                                 struct acpi_object_list *params,
+                                 struct acpi_buffer *buffer)
+{
+    struct mock_method *m;
+    union acpi_object *out;
+    u64 args[5] = { 0 }, calls, value = 0;
+    u8 data[MOCK_FAN_CURVE_LEN], *curve;
+    u32 i, len = 0;
+
+    if (pathname) {
+        m = mock_lookup(handle, pathname);
+    } else {
+        m = mock_method_of(handle);
+        /* Pretend the driver passed the device handle and the method name */
+        if (m && mock_by_pathname)
+            m = mock_lookup(&mock_node, m->name);
+    }
+    if (!m)
+        return AE_NOT_FOUND;
+    if (!params || params->count < m->nargs || params->count > ARRAY_SIZE(args))
+        return AE_BAD_PARAMETER;
+    for (i = 0; i < params->count; i++) {
+        if (params->pointer[i].type != ACPI_TYPE_INTEGER)
+            return AE_BAD_PARAMETER;
+        args[i] = params->pointer[i].integer.value;
+    }
+
+    pthread_mutex_lock(&mock_interp_lock);
+    calls = ++m->calls;
+    mock_total_calls++;
+    if (m->latency_ns)
+        mock_spin(m->latency_ns);
+    if (m->fail_every && !(calls % m->fail_every)) {
+        pthread_mutex_unlock(&mock_interp_lock);
+        return AE_ERROR;
+    }
+
+    switch (m->kind) {
+    case MOCK_GET:
+        value = mock_regs[m->reg];
+        break;
+    case MOCK_SET:
+        mock_regs[m->reg] = args[0];
+        break;
+    case MOCK_BIOS_GET:
+        curve = mock_fan_curve(args[0]);
+        if (curve) {
+            memcpy(data, curve, sizeof(data));
+            len = sizeof(data);
+        } else {
+            value = mock_bios_get(args[0]);
+        }
+        break;
+    case MOCK_BIOS_SET:
+        value = mock_bios_set(args, params->count);
+        break;
+    }
+    pthread_mutex_unlock(&mock_interp_lock);
+
+    if (!buffer)
+        return AE_OK;
+    /* ACPICA places buffer contents right after the object */
+    if (buffer->length < sizeof(*out) + len) {
+        buffer->length = sizeof(*out) + len;
+        return AE_BUFFER_OVERFLOW;
+    }
+
+    out = buffer->pointer;
+    if (len) {
+        out->buffer.type = ACPI_TYPE_BUFFER;
+        out->buffer.length = len;
+        out->buffer.pointer = (u8 *)(out + 1);
+        memcpy(out + 1, data, len);
+    } else {
+        out->integer.type = ACPI_TYPE_INTEGER;
+        out->integer.value = value;
+    }
+    buffer->length = sizeof(*out) + len;
+
+    return AE_OK;
+}
+
+acpi_status acpi_get_handle(acpi_handle parent, const char *pathname, acpi_handle *ret)
+{
+    int i;
+
+    if (parent != &mock_node)
+        return AE_NOT_FOUND;
+
+    for (i = 0; i < mock_node.nr_methods; i++) {
+        if (!strcmp(mock_node.methods[i].name, pathname)) {
+            *ret = &mock_node.methods[i];
+            return AE_OK;
+        }
+    }
+    return AE_NOT_FOUND;
+}
+
+acpi_status acpi_get_name(acpi_handle handle, u32 name_type, struct acpi_buffer *buffer)
+{
+    struct mock_method *m = mock_method_of(handle);
+
+    if (!m || name_type != ACPI_SINGLE_NAME)
+        return AE_BAD_PARAMETER;
+    if (buffer->length < sizeof(m->name)) {
+        buffer->length = sizeof(m->name);
+        return AE_BUFFER_OVERFLOW;
+    }
+    memcpy(buffer->pointer, m->name, sizeof(m->name));
+    return AE_OK;
+}
+
+acpi_status acpi_get_object_info(acpi_handle handle, struct acpi_device_info **info)
+{
+    struct mock_method *m = mock_method_of(handle);
+    struct acpi_device_info *di;
+
+    if (!m)
+        return AE_BAD_PARAMETER;
+
+    di = kzalloc(sizeof(*di), GFP_KERNEL);
+    if (!di)
+        return AE_ERROR;
+    di->info_size = sizeof(*di);
+    memcpy(&di->name, m->name, ACPI_NAMESEG_SIZE);
+    di->type = ACPI_TYPE_METHOD;
+    di->param_count = m->nargs;
+    *info = di;
+
+    return AE_OK;
+}
+
+acpi_status acpi_walk_namespace(acpi_object_type type, acpi_handle start, u32 max_depth,
+                                acpi_walk_callback pre, acpi_walk_callback post,
+                                void *context, void **retval)
+{
+    acpi_status status;
+    int i;
+
+    if (start != &mock_node)
+        return AE_BAD_PARAMETER;
+    if (type != ACPI_TYPE_METHOD && type != ACPI_TYPE_ANY)
+        return AE_OK;
+
+    for (i = 0; i < mock_node.nr_methods; i++) {
+        if (pre) {
+            status = pre(&mock_node.methods[i], 1, context, retval);
+            if (ACPI_FAILURE(status))
+                return AE_OK;
+        }
+        if (post)
+            post(&mock_node.methods[i], 1, context, retval);
+    }
+    return AE_OK;
+}
+
+const char *acpi_format_exception(acpi_status status)
+{
+    switch (status) {
+    case AE_OK:
+        return "AE_OK";
+    case AE_ERROR:
+        return "AE_ERROR";
+    case AE_NOT_FOUND:
+        return "AE_NOT_FOUND";
+    case AE_BUFFER_OVERFLOW:
+        return "AE_BUFFER_OVERFLOW";
+    case AE_BAD_PARAMETER:
+        return "AE_BAD_PARAMETER";
+    default:
+        return "AE_UNKNOWN_STATUS";
+    }
+}
+
+/* DMI */
+
+const char *dmi_get_system_info(int field)
+{
+    const struct mock_vendor *v = mock_node.vendor;
+
+    if (!v)
+        return NULL;
+
+    switch (field) {
+    case DMI_SYS_VENDOR:
+        return v->sys_vendor;
+    case DMI_PRODUCT_NAME:
+    case DMI_BOARD_NAME:
+        return v->product_name;
+    case DMI_BIOS_VERSION:
+        return v->bios_version;
+    default:
+        return NULL;
+    }
+}
+
+static bool mock_dmi_matches(const struct dmi_system_id *d)
+{
+    const char *s;
+    int i;
+
+    for (i = 0; i < (int)ARRAY_SIZE(d->matches); i++) {
+        if (d->matches[i].slot == DMI_NONE)
+            break;
+        s = dmi_get_system_info(d->matches[i].slot);
+        if (!s)
+            return false;
+        if (d->matches[i].exact_match ? strcmp(s, d->matches[i].substr) :
+                                        !strstr(s, d->matches[i].substr))
+            return false;
+    }
+    return true;
+}
+
+const struct dmi_system_id *dmi_first_match(const struct dmi_system_id *list)
+{
+    const struct dmi_system_id *d;
+
+    for (d = list; d->matches[0].slot != DMI_NONE; d++) {
+        if (mock_dmi_matches(d))
+            return d;
+    }
+    return NULL;
+}
@@ -0,0 +1,44 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Mock ACPI namespace and DMI tables for the userspace benchmark
+ *
+ * One device node holds the GPU switch methods of the selected vendor. The
+ * methods read and write a small register file and can be given a latency
+ * and a failure rate.
+ */
+
+#ifndef _BENCH_MOCK_ACPI_H
+#define _BENCH_MOCK_ACPI_H
+
+#include <linux/acpi.h>
+
+/* Firmware registers behind the methods */
+enum mock_reg {
+    MOCK_REG_GPU_MUX,
+    MOCK_REG_DGPU_DISABLE,
+    MOCK_REG_EGPU_ENABLE,
+    MOCK_REG_THERMAL_POLICY,
+    MOCK_REG_PPT_PL1_SPL,
+    MOCK_REG_PPT_PL2_SPPT,
+    MOCK_REG_PPT_FPPT,
+    MOCK_REG_NV_DYN_BOOST,
+    MOCK_NR_REGS
+};
+
+/* Load the namespace and DMI strings of @vendor; -ENOENT if unknown */
+int mock_acpi_init(const char *vendor);
+const char *mock_acpi_vendor_names(void);
+acpi_handle mock_acpi_device(void);
+
+/* @method NULL applies to every method */
+int mock_acpi_set_latency(const char *method, u64 ns);
+/* Fail every @every-th evaluation with AE_ERROR, 0 turns it off */
+int mock_acpi_set_failure(const char *method, u32 every);
+
+/* Look every evaluation up by name, as before method handles were cached */
+void mock_acpi_set_pathname(bool on);
+
+u64 mock_acpi_calls(void);
+int mock_acpi_reg(enum mock_reg reg);
+
+#endif /* _BENCH_MOCK_ACPI_H */